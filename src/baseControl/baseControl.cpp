@@ -222,8 +222,8 @@ bool CtrlModule::respond(const Bottle& command, Bottle& reply)
         reply.addString("run");
         reply.addString("idle");
         reply.addString("reset_odometry");
-        reply.addString("set_prefilter 0/1/2/4/8");
-        reply.addString("set_motors_filter 0/1/2/4/8");
+        reply.addString("set_prefilter <cut-off frequency [Hz], 0 = off>");
+        reply.addString("set_motors_filter <cut-off frequency [Hz], 0 = off>");
         reply.addString("set_max_lin_vel <value>");
         reply.addString("set_max_ang_vel <value>");
         reply.addString("set_max_joy_lin_vel <value>");
@@ -231,6 +231,8 @@ bool CtrlModule::respond(const Bottle& command, Bottle& reply)
         reply.addString("change_pid <identif> <kp> <ki> <kd>");
         reply.addString("change_ctrl_mode <type_string>");
         reply.addString("set_debug_mode 0/1");
+        reply.addString("get_timing_stats");
+        reply.addString("reset_timing_stats");
         return true;
     }
     else if (command.get(0).asString() == "set_max_lin_vel")
@@ -270,8 +272,9 @@ bool CtrlModule::respond(const Bottle& command, Bottle& reply)
     {
         if (control_thr)
         {
-            if (command.get(1).asInt()>0) 
-                {control_thr->set_input_filter(command.get(1).asInt()); reply.addString("Prefilter on");}
+            double f = command.get(1).asFloat64();
+            if (f>0)
+                {control_thr->set_input_filter(f); reply.addString("Prefilter on");}
             else
                 {control_thr->set_input_filter(0); reply.addString("Prefilter off");}
         }
@@ -281,17 +284,11 @@ bool CtrlModule::respond(const Bottle& command, Bottle& reply)
     {
         if (control_thr)
         {
-            int f= command.get(1).asInt();
-            if (f==1) 
-                {control_thr->get_motor_handler()->set_motors_filter(MotorControl::HZ_1); reply.addString("Motors filter on");}
-            if (f==2) 
-                {control_thr->get_motor_handler()->set_motors_filter(MotorControl::HZ_2); reply.addString("Motors filter on");}
-            if (f==4) 
-                {control_thr->get_motor_handler()->set_motors_filter(MotorControl::HZ_4); reply.addString("Motors filter on");}
-            if (f==8) 
-                {control_thr->get_motor_handler()->set_motors_filter(MotorControl::HZ_8); reply.addString("Motors filter on");}
+            double f = command.get(1).asFloat64();
+            if (f>0)
+                {control_thr->get_motor_handler()->set_motors_filter(f); reply.addString("Motors filter on");}
             else
-                {control_thr->get_motor_handler()->set_motors_filter(MotorControl::DISABLED); reply.addString("Motors filter off");}
+                {control_thr->get_motor_handler()->set_motors_filter(0); reply.addString("Motors filter off");}
         }
         return true;
     }
@@ -360,6 +357,34 @@ bool CtrlModule::respond(const Bottle& command, Bottle& reply)
         }
         return true;
     }
+    else if (command.get(0).asString()=="get_timing_stats")
+    {
+        if (control_thr)
+        {
+            loop_timing_stats stats = control_thr->get_timing_stats();
+            double exec_time_avg = (stats.cycles > 0) ? stats.exec_time_sum / stats.cycles : 0;
+            Bottle& b_rt = reply.addList();        b_rt.addString("realtime");             b_rt.addInt(control_thr->is_realtime_active() ? 1 : 0);
+            Bottle& b_cycles = reply.addList();    b_cycles.addString("cycles");           b_cycles.addInt((int)stats.cycles);
+            Bottle& b_overruns = reply.addList();  b_overruns.addString("overruns");       b_overruns.addInt((int)stats.overruns);
+            Bottle& b_exec_avg = reply.addList();  b_exec_avg.addString("exec_time_avg");  b_exec_avg.addDouble(exec_time_avg);
+            Bottle& b_exec_max = reply.addList();  b_exec_max.addString("exec_time_max");  b_exec_max.addDouble(stats.exec_time_max);
+            Bottle& b_jitter = reply.addList();    b_jitter.addString("jitter_max");       b_jitter.addDouble(stats.jitter_max);
+            Bottle& b_limits = reply.addList();    b_limits.addString("jitter_bin_limits");
+            for (int i = 0; i < loop_timing_stats::jitter_bins - 1; i++) b_limits.addDouble(loop_timing_stats::jitter_bin_limits[i]);
+            Bottle& b_hist = reply.addList();      b_hist.addString("jitter_histogram");
+            for (int i = 0; i < loop_timing_stats::jitter_bins; i++) b_hist.addInt((int)stats.jitter_histogram[i]);
+        }
+        return true;
+    }
+    else if (command.get(0).asString()=="reset_timing_stats")
+    {
+        if (control_thr)
+        {
+            control_thr->reset_timing_stats();
+            reply.addString("Timing statistics reset.");
+        }
+        return true;
+    }
     reply.addString("Unknown command.");
     return true;
 }
@@ -24,26 +24,43 @@ YARP_LOG_COMPONENT(CER_ODOM, "navigation.baseControl.cerOdometry")
 
 bool CER_Odometry::reset_odometry()
 {
-    ienc->getEncoder(0,&encL_offset);
-    ienc->getEncoder(1,&encR_offset);
+    mutex.wait();
+    double timestamp = 0;
+    if (!read_encoders(enc_offset, timestamp))
+    {
+        mutex.post();
+        yCError(CER_ODOM, "Unable to read the encoders, odometry not reset");
+        return false;
+    }
+    enc.zero();
+    enc_prev.zero();
     odom_x=0;
     odom_y=0;
     encvel_estimator->reset();
+    encw_estimator->reset();
+    mutex.post();
     yCInfo(CER_ODOM,"Odometry reset done");
     return true;
 }
 
 void CER_Odometry::printStats()
 {
+    //the values are copied under the lock and printed without it, not to delay the control thread
     mutex.wait();
+    double e[2] = { enc[0], enc[1] };
+    double ev[2] = { encv[0], encv[1] };
+    double bvl = base_vel_lin, bvt = base_vel_theta;
+    double ovx = odom_vel_x, ovy = odom_vel_y, ovt = odom_vel_theta;
+    double ox = odom_x, oy = odom_y, ot = odom_theta;
+    mutex.post();
+
     //yCInfo (stdout,"Odometry Thread: Curr motor velocities: %+3.3f %+3.3f %+3.3f\n", velA, velB, velC);
     yCInfo(CER_ODOM,"* Odometry Thread:");
-    yCInfo(CER_ODOM, "enc1:%+9.1f enc2:%+9.1f  ", enc[0]*57, enc[1]*57);
-    yCInfo(CER_ODOM, "env1:%+9.3f env2:%+9.3f ", encv[0] * 57, encv[1] * 57);
-    yCInfo(CER_ODOM, "ivlx:%+9.3f ivlx:%+9.3f",base_vel_lin, base_vel_theta);
-    yCInfo(CER_ODOM, "ovlx:%+9.3f ovly:%+9.3f ovlt:%+9.3f", odom_vel_x, odom_vel_y, odom_vel_theta);
-    yCInfo(CER_ODOM, "x: %+5.3f y: %+5.3f t: %+5.3f", odom_x, odom_y, odom_theta);
-    mutex.post();
+    yCInfo(CER_ODOM, "enc1:%+9.1f enc2:%+9.1f  ", e[0]*57, e[1]*57);
+    yCInfo(CER_ODOM, "env1:%+9.3f env2:%+9.3f ", ev[0] * 57, ev[1] * 57);
+    yCInfo(CER_ODOM, "ivlx:%+9.3f ivlx:%+9.3f", bvl, bvt);
+    yCInfo(CER_ODOM, "ovlx:%+9.3f ovly:%+9.3f ovlt:%+9.3f", ovx, ovy, ovt);
+    yCInfo(CER_ODOM, "x: %+5.3f y: %+5.3f t: %+5.3f", ox, oy, ot);
 }
 
 CER_Odometry::~CER_Odometry()
@@ -71,8 +88,14 @@ CER_Odometry::CER_Odometry(PolyDriver* _driver) : OdometryHandler(_driver)
     traveled_angle=0;
     encvel_estimator =new iCub::ctrl::AWLinEstimator(2,1.0);
     encw_estimator = new iCub::ctrl::AWLinEstimator(1, 1.0);
-    enc.resize(2);
-    encv.resize(2);
+    enc_raw.resize(2, 0.0);
+    enc_offset.resize(2, 0.0);
+    enc.resize(2, 0.0);
+    enc_prev.resize(2, 0.0);
+    encv.resize(2, 0.0);
+    encw.resize(1, 0.0);
+    encvel_element.data.resize(2, 0.0);
+    encw_element.data.resize(1, 0.0);
     geom_r = 0;
     geom_L = 0;
 }
@@ -99,6 +122,11 @@ bool CER_Odometry::open(const Property& _options)
         yCError(CER_ODOM, "one or more devices has not been viewed");
         return false;
     }
+    if (!control_board_driver->view(ienc_timed))
+    {
+        yCWarning(CER_ODOM, "IEncodersTimed not available, the encoders will be timestamped on reception");
+        ienc_timed = 0;
+    }
     // open control input ports
     bool ret = true;
     ret &= port_odometry.open((localName+"/odometry:o").c_str());
@@ -146,89 +174,62 @@ void CER_Odometry::compute()
 {
     mutex.wait();
 
-    //read the encoders (deg)
-    ienc->getEncoder(0,&encL);
-    ienc->getEncoder(1,&encR);
-        
-    //read the speeds (deg/s)
-    ienc->getEncoderSpeed(0,&velL);
-    ienc->getEncoderSpeed(1,&velR);
-        
+    //read the encoders of both the wheels (deg), with their acquisition time
+    double timestamp = 0;
+    if (!read_encoders(enc_raw, timestamp))
+    {
+        mutex.post();
+        return;
+    }
+
     //remove the offset and convert in radians
-    enc[0]= (encL - encL_offset) * 0.0174532925; 
-    enc[1]= (encR - encR_offset) * 0.0174532925;
-       
-    //estimate the speeds
-    iCub::ctrl::AWPolyElement el;
-    el.data=enc;
-    el.time=Time::now();
-    encv= encvel_estimator->estimate(el);
-
-    //compute the orientation.
-    odom_theta = (geom_r / geom_L) * (-enc[0] + enc[1]);
-
-    iCub::ctrl::AWPolyElement el2;
-    el2.data = yarp::sig::Vector(1,odom_theta);
-    el2.time = Time::now();
-    yarp::sig::Vector vvv;
-    vvv.resize(1, 0.0);
-    vvv = encw_estimator->estimate(el2);
-
-    //build the kinematics matrix
-    /*yarp::sig::Matrix kin;
-    kin.resize(3,2);
-    kin.zero();
-    kin(0, 0) = cos(odom_theta) / 2;
-    kin(0, 1) = cos(odom_theta) / 2;
-    kin(0, 2) = sin(odom_theta) / 2;
-    kin(1, 0) = sin(odom_theta) / 2;
-    kin(1, 1) = 1 / (2 * geom_L);
-    kin(1, 2) = 1 / (2 * geom_L);
-
-    yarp::sig::Vector odom_cart_vels;  //velocities expressed in the world reference frame
-    yarp::sig::Vector base_cart_vels; //velocities expressed in the base reference frame
-    odom_cart_vels  = kin*encv;
-    base_cart_vels = kin*encv; //@@@
-
-    base_vel_x     = base_cart_vels[1];
-    base_vel_y     = base_cart_vels[0];
-    base_vel_lin   = sqrt(base_vel_x*base_vel_x + base_vel_y*base_vel_y);
-    base_vel_theta = base_cart_vels[2];
-    
-    odom_vel_x      = odom_cart_vels[1];
-    odom_vel_y      = odom_cart_vels[0];
-    odom_vel_theta  = odom_cart_vels[2];
-    */
+    enc[0]= (enc_raw[0] - enc_offset[0]) * DEG2RAD;
+    enc[1]= (enc_raw[1] - enc_offset[1]) * DEG2RAD;
 
+    //compute the orientation, at the previous and at the current cycle.
+    double theta_prev = (geom_r / geom_L) * (-enc_prev[0] + enc_prev[1]);
+    double theta = (geom_r / geom_L) * (-enc[0] + enc[1]);
+
+    //estimate the speeds. The estimators are fed only with new samples, using the time of their acquisition
+    if (timestamp > last_time)
+    {
+        encvel_element.data[0] = enc[0];
+        encvel_element.data[1] = enc[1];
+        encvel_element.time = timestamp;
+        encv = encvel_estimator->estimate(encvel_element);
+
+        encw_element.data[0] = theta;
+        encw_element.time = timestamp;
+        encw = encw_estimator->estimate(encw_element);
+        last_time = timestamp;
+    }
 
     base_vel_x = geom_r / 2 * encv[0] + geom_r / 2 * encv[1]; 
     base_vel_y = 0;
     base_vel_lin = fabs(base_vel_x);
-    base_vel_theta = vvv[0];///-(geom_r / geom_L) * encv[0] + (geom_r / geom_L) * encv[1];
-    //yCDebug() << base_vel_theta << vvv[0];
+    base_vel_theta = encw[0];
 
-    
-    odom_vel_x = base_vel_x * cos(odom_theta);
-    odom_vel_y = base_vel_x * sin(odom_theta);
+    odom_vel_x = base_vel_x * cos(theta);
+    odom_vel_y = base_vel_x * sin(theta);
     odom_vel_lin = base_vel_lin;
     odom_vel_theta = base_vel_theta;
 
-    //the integration step
-    double period=el.time-last_time;
-    odom_x=odom_x + (odom_vel_x * period);
-    odom_y=odom_y + (odom_vel_y * period);
+    //the integration step: the wheels displacements since the previous cycle are integrated along an arc,
+    //so the result does not depend on the period of the thread
+    double ds = geom_r / 2 * ((enc[0] - enc_prev[0]) + (enc[1] - enc_prev[1]));
+    double dtheta = theta - theta_prev;
+    integrate_arc(ds, 0, dtheta, theta_prev);
+    enc_prev[0] = enc[0];
+    enc_prev[1] = enc[1];
 
     //compute traveled distance (odometer)
-    traveled_distance = traveled_distance + fabs(base_vel_lin   * period);
-    traveled_angle    = traveled_angle    + fabs(base_vel_theta * period);
+    traveled_distance = traveled_distance + fabs(ds);
+    traveled_angle    = traveled_angle    + fabs(dtheta) * RAD2DEG;
 
     //convert from radians back to degrees
-    odom_theta       *= RAD2DEG;
+    odom_theta        = theta * RAD2DEG;
     base_vel_theta   *= RAD2DEG;
     odom_vel_theta   *= RAD2DEG;
-    traveled_angle   *= RAD2DEG;
 
     mutex.post();
-    last_time = yarp::os::Time::now();
 }
-
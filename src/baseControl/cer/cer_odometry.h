@@ -48,30 +48,24 @@ using namespace yarp::math;
 class CER_Odometry: public OdometryHandler
 {
 private:
-    //encoder variables
-    double              encL_offset;
-    double              encR_offset;
+    //encoder variables: raw positions (deg), offsets (deg), positions at the current and at the previous cycle (rad)
+    yarp::sig::Vector   enc_raw;
+    yarp::sig::Vector   enc_offset;
+    yarp::sig::Vector   enc;
+    yarp::sig::Vector   enc_prev;
 
-    double              encL;
-    double              encR;
-
-    //measured motor velocity
-    double              velL;
-    double              velR;
-
-    //estimated motor velocity
-    double              velL_est;
-    double              velR_est;
+    //estimated motor velocity (rad/s) and base angular velocity (rad/s)
+    yarp::sig::Vector   encv;
+    yarp::sig::Vector   encw;
     iCub::ctrl::AWLinEstimator      *encvel_estimator;
     iCub::ctrl::AWLinEstimator      *encw_estimator;
+    iCub::ctrl::AWPolyElement       encvel_element;
+    iCub::ctrl::AWPolyElement       encw_element;
 
     //robot geometry
     double              geom_r;
     double              geom_L;
 
-    yarp::sig::Vector enc;
-    yarp::sig::Vector encv;
-
 public:
     /**
     * Constructor
@@ -17,14 +17,25 @@
 */
 
 #include "controlThread.h"
-#include "filters.h"
 #include "cer/cer_odometry.h"
 #include "ikart/ikart_odometry.h"
 #include "cer/cer_motors.h"
 #include "ikart/ikart_motors.h"
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <alloca.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
 YARP_LOG_COMPONENT(CONTROL_THRD, "navigation.baseControl.controlThread")
 
+const double loop_timing_stats::jitter_bin_limits[loop_timing_stats::jitter_bins - 1] = { 50e-6, 100e-6, 200e-6, 500e-6, 1e-3, 2e-3, 5e-3 };
+
 void ControlThread::afterStart(bool s)
 {
     if (s)
@@ -73,6 +84,7 @@ ControlThread::ControlThread (double _period, ResourceFinder &_rf, Property opti
     base_control_type        = BASE_CONTROL_NONE;
 
     input_filter_enabled     = 0;
+    input_filter_order       = 1;
     lin_ang_ratio            = 0.7;
     robot_type               = ROBOT_TYPE_NONE;
 
@@ -93,6 +105,11 @@ ControlThread::ControlThread (double _period, ResourceFinder &_rf, Property opti
     m_odometry_handler       = 0;
     m_motor_handler          = 0;
     m_input_handler          = 0;
+
+    rt_enabled               = false;
+    rt_active                = false;
+    timing_reset_request     = false;
+    timing_prev_valid        = false;
 }
 
 void ControlThread::apply_ratio_limiter (double& linear_speed, double& angular_speed)
@@ -130,19 +147,13 @@ void ControlThread::apply_ratio_limiter (double max, double& linear_speed, doubl
 void ControlThread::apply_acceleration_limiter(double& linear_speed, double& angular_speed, double& desired_direction)
 {
     double period = this->getPeriod();
-    angular_speed = control_filters::ratelim_filter_0(angular_speed, 7, max_angular_acc_pos*period, max_angular_acc_neg * period);
-#if 0
-    linear_speed = control_filters::ratelim_filter_0(linear_speed, 8, max_linear_acc*period);
-    //the following line is not numerically correct because of max_linear_acc, but it prevents jerky motions
-    desired_direction = control_filters::ratelim_filter_0(desired_direction, 9, max_linear_acc*period);
-#else
+    angular_speed = acc_limiter_angular_speed.filter(angular_speed, max_angular_acc_pos*period, max_angular_acc_neg * period);
     double xcomp = linear_speed * sin(desired_direction*DEG2RAD);
     double ycomp = linear_speed * cos(desired_direction*DEG2RAD);
-    xcomp = control_filters::ratelim_filter_0(xcomp, 8, max_linear_acc_pos*period, max_linear_acc_neg * period);
-    ycomp = control_filters::ratelim_filter_0(ycomp, 9, max_linear_acc_pos*period, max_linear_acc_neg * period);
+    xcomp = acc_limiter_xcomp.filter(xcomp, max_linear_acc_pos*period, max_linear_acc_neg * period);
+    ycomp = acc_limiter_ycomp.filter(ycomp, max_linear_acc_pos*period, max_linear_acc_neg * period);
     linear_speed = sqrt(xcomp * xcomp+ ycomp * ycomp);
     desired_direction = atan2(xcomp, ycomp) * RAD2DEG;
-#endif
 
     #if DEBUG_LIMTER
     yCDebug()<<angular_speed<<linear_speed;
@@ -151,30 +162,26 @@ void ControlThread::apply_acceleration_limiter(double& linear_speed, double& ang
 
 void ControlThread::apply_input_filter (double& linear_speed, double& angular_speed, double& desired_direction)
 {
-    if (input_filter_enabled == 8)
-    {
-        angular_speed = control_filters::lp_filter_8Hz(angular_speed, 7);
-        linear_speed = control_filters::lp_filter_8Hz(linear_speed, 8);
-        desired_direction = control_filters::lp_filter_8Hz(desired_direction, 9);
-    }
-    else if (input_filter_enabled == 4)
-    {
-        angular_speed = control_filters::lp_filter_4Hz(angular_speed, 7);
-        linear_speed = control_filters::lp_filter_4Hz(linear_speed, 8);
-        desired_direction = control_filters::lp_filter_4Hz(desired_direction, 9);
-    }
-    else if(input_filter_enabled == 2)
-    {
-        angular_speed = control_filters::lp_filter_2Hz(angular_speed, 7);
-        linear_speed = control_filters::lp_filter_2Hz(linear_speed, 8);
-        desired_direction = control_filters::lp_filter_2Hz(desired_direction, 9);
-    }
-    else if(input_filter_enabled == 1)
-    {
-        angular_speed = control_filters::lp_filter_1Hz(angular_speed, 7);
-        linear_speed = control_filters::lp_filter_1Hz(linear_speed, 8);
-        desired_direction = control_filters::lp_filter_1Hz(desired_direction, 9);
+    //the cut-off frequency may have been changed by set_input_filter()
+    double cutoff_frequency = input_filter_enabled;
+    if (input_filter_linear_speed.get_cutoff_frequency() != cutoff_frequency)
+    {
+        //all the filters are configured even if one of them fails: a failed init() stores the frequency
+        //and disables that filter, so the init is not retried at each cycle
+        double period = this->getPeriod();
+        bool ok = input_filter_angular_speed.init(input_filter_order, cutoff_frequency, period);
+        ok &= input_filter_linear_speed.init(input_filter_order, cutoff_frequency, period);
+        ok &= input_filter_desired_direction.init(input_filter_order, cutoff_frequency, period);
+        if (!ok)
+        {
+            yCError(CONTROL_THRD, "Invalid input filter (order %d, cut-off frequency %.2fHz, period %.3fs). Input filter disabled.", input_filter_order, cutoff_frequency, period);
+        }
     }
+
+    //a disabled filter returns its input, keeping track of the signal for when it is enabled again
+    angular_speed = input_filter_angular_speed.filter(angular_speed);
+    linear_speed = input_filter_linear_speed.filter(linear_speed);
+    desired_direction = input_filter_desired_direction.filter(desired_direction);
 }
 
 void ControlThread::enable_debug(bool b)
@@ -282,8 +289,10 @@ void ControlThread::apply_control_openloop_pid(double& pidout_linear_throttle, d
 
 void ControlThread::run()
 {
+    std::chrono::steady_clock::time_point cycle_start = std::chrono::steady_clock::now();
+
     if (m_odometry_handler) this->m_odometry_handler->compute();
-    if (m_odometry_handler) this->m_odometry_handler->broadcast();
+    if (m_odometry_handler) this->m_odometry_handler->publish();
 
     double pidout_linear_throttle = 0;
     double pidout_angular_throttle = 0;
@@ -373,13 +382,158 @@ void ControlThread::run()
     {
         yCError (CONTROL_THRD,"Unknown control mode!");
         this->m_motor_handler->execute_none();
+    }
+
+    update_timing_stats(cycle_start);
+}
+
+void ControlThread::update_timing_stats(std::chrono::steady_clock::time_point cycle_start)
+{
+    double exec_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - cycle_start).count();
+
+    if (timing_reset_request.exchange(false))
+    {
+        timing_local = loop_timing_stats();
+    }
+
+    timing_local.cycles++;
+    timing_local.exec_time_sum += exec_time;
+    if (exec_time > timing_local.exec_time_max) timing_local.exec_time_max = exec_time;
+    if (exec_time > thread_period) timing_local.overruns++;
+
+    //the jitter is the difference between the measured period (start to start) and the nominal one
+    if (timing_prev_valid)
+    {
+        double jitter = fabs(std::chrono::duration<double>(cycle_start - timing_prev_start).count() - thread_period);
+        if (jitter > timing_local.jitter_max) timing_local.jitter_max = jitter;
+        int bin = 0;
+        while (bin < loop_timing_stats::jitter_bins - 1 && jitter >= loop_timing_stats::jitter_bin_limits[bin]) bin++;
+        timing_local.jitter_histogram[bin]++;
+    }
+    timing_prev_start = cycle_start;
+    timing_prev_valid = true;
+
+    //if a reader is copying the statistics, they will be published at the next cycle
+    if (timing_mutex.try_lock())
+    {
+        timing_shared = timing_local;
+        timing_mutex.unlock();
+    }
+}
+
+loop_timing_stats ControlThread::get_timing_stats()
+{
+    std::lock_guard<std::mutex> lock(timing_mutex);
+    return timing_shared;
 }
+
+bool ControlThread::apply_realtime_settings(yarp::os::Bottle& rt_options)
+{
+    int     priority      = rt_options.check("priority",       Value(80),     "SCHED_FIFO priority of the control thread").asInt();
+    bool    lock_memory   = rt_options.check("lock_memory",    Value(true),   "lock the process memory in RAM").asBool();
+    int     prefault_size = rt_options.check("prefault_stack", Value(262144), "size of the stack of the control thread touched at startup [bytes]").asInt();
+    Bottle* cpu_list      = rt_options.find("cpu_affinity").asList();
+
+#ifdef __linux__
+    bool ok = true;
+
+    //cpu affinity
+    if (cpu_list && cpu_list->size() > 0)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (size_t i = 0; i < cpu_list->size(); i++)
+        {
+            int cpu = cpu_list->get(i).asInt();
+            if (cpu < 0 || cpu >= CPU_SETSIZE)
+            {
+                yCError(CONTROL_THRD, "Invalid cpu %d in 'cpu_affinity' param", cpu);
+                return false;
+            }
+            CPU_SET(cpu, &cpu_set);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (err != 0)
+        {
+            yCError(CONTROL_THRD, "Unable to set the cpu affinity of the control thread: %s", strerror(err));
+            ok = false;
+        }
+    }
+
+    //scheduling policy
+    if (priority < sched_get_priority_min(SCHED_FIFO) || priority > sched_get_priority_max(SCHED_FIFO))
+    {
+        yCError(CONTROL_THRD, "Invalid 'priority' param %d, it must be in the range %d-%d", priority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+        return false;
+    }
+    struct sched_param param;
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0)
+    {
+        yCError(CONTROL_THRD, "Unable to set SCHED_FIFO priority %d for the control thread: %s (CAP_SYS_NICE or a rtprio limit is required)", priority, strerror(err));
+        ok = false;
+    }
+
+    //memory locking, to avoid page faults during the control loop
+    if (lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        yCError(CONTROL_THRD, "Unable to lock the process memory: %s (CAP_IPC_LOCK or a memlock limit is required)", strerror(errno));
+        ok = false;
+    }
+
+    //touch the stack pages that the control loop may use, so that they are already mapped when it runs
+    if (prefault_size > 0)
+    {
+        pthread_attr_t attr;
+        size_t stack_size = 0;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0)
+        {
+            pthread_attr_getstacksize(&attr, &stack_size);
+            pthread_attr_destroy(&attr);
+        }
+        if ((size_t)prefault_size > stack_size / 2)
+        {
+            yCWarning(CONTROL_THRD, "'prefault_stack' param too large, reduced to %d bytes", (int)(stack_size / 2));
+            prefault_size = (int)(stack_size / 2);
+        }
+        long page_size = sysconf(_SC_PAGESIZE);
+        volatile char* stack = static_cast<volatile char*>(alloca(prefault_size));
+        for (int i = 0; i < prefault_size; i += page_size) stack[i] = 0;
+    }
+
+    rt_active = ok;
+    if (rt_active)
+        yCInfo(CONTROL_THRD, "Real time mode active: SCHED_FIFO priority %d", priority);
+    else
+        yCWarning(CONTROL_THRD, "Real time mode requested, but not all the settings were applied. The control thread runs with best effort timing");
+#else
+    yCWarning(CONTROL_THRD, "Real time mode is supported only on Linux. The control thread runs with best effort timing");
+#endif
+    return true;
 }
 
 void ControlThread::printStats()
 {
     yCInfo (CONTROL_THRD, "* Control thread:\n");
     yCInfo (CONTROL_THRD, "Input command: %+5.2f %+5.2f %+5.2f  %+5.2f      ", input_linear_speed, input_angular_speed, input_desired_direction, input_pwm_gain);
+
+    loop_timing_stats stats = get_timing_stats();
+    double exec_time_avg = (stats.cycles > 0) ? stats.exec_time_sum / stats.cycles : 0;
+    yCInfo (CONTROL_THRD, "Loop timing (%s): cycles %lu, overruns %lu, exec time avg %.3f ms max %.3f ms, jitter max %.3f ms",
+            rt_active ? "real time" : "best effort", stats.cycles, stats.overruns, exec_time_avg * 1000.0, stats.exec_time_max * 1000.0, stats.jitter_max * 1000.0);
+
+    string histogram;
+    char   buff[64];
+    for (int i = 0; i < loop_timing_stats::jitter_bins; i++)
+    {
+        if (i < loop_timing_stats::jitter_bins - 1)
+            snprintf(buff, sizeof(buff), "<%.0f:%lu ", loop_timing_stats::jitter_bin_limits[i] * 1e6, stats.jitter_histogram[i]);
+        else
+            snprintf(buff, sizeof(buff), ">=%.0f:%lu", loop_timing_stats::jitter_bin_limits[i - 1] * 1e6, stats.jitter_histogram[i]);
+        histogram += buff;
+    }
+    yCInfo (CONTROL_THRD, "Period jitter histogram [us]: %s", histogram.c_str());
 }
 
 bool ControlThread::set_control_type (string s)
@@ -423,7 +577,8 @@ bool ControlThread::threadInit()
     bool useRos;
     
     control_type          = general_options.check("control_mode",         Value("none"), "type of control for the wheels").asString().c_str();
-    input_filter_enabled  = general_options.check("input_filter_enabled", Value(0),      "input filter frequency (1/2/4/8Hz), 0 = disabled)").asInt();
+    input_filter_enabled  = general_options.check("input_filter_enabled", Value(0),      "input filter cut-off frequency [Hz], 0 = disabled").asDouble();
+    input_filter_order    = general_options.check("input_filter_order",   Value(1),      "order of the input butterworth filter").asInt();
     ratio_limiter_enabled = general_options.check("ratio_limiter_enabled", Value(0),     "1=enabled, 0 = disabled").asInt()==1;
     lin_ang_ratio         = general_options.check("linear_angular_ratio", Value(0.7),    "ratio (<1.0) between the maximum linear speed and the maximum angular speed.").asDouble();
     robot_type_s          = general_options.check("robot_type",           Value("none"), "geometry of the robot").asString();
@@ -601,6 +756,9 @@ bool ControlThread::threadInit()
         //input_handler->rosNode    = rosNode;
     }
     
+    //the filters of the handlers are computed for the actual rate of the thread
+    ctrl_options.put("thread_period", thread_period);
+
     if (m_odometry_handler && m_odometry_handler->open(ctrl_options) == false)
     {
         yCError(CONTROL_THRD) << "Problem occurred while opening odometry handler";
@@ -683,6 +841,17 @@ bool ControlThread::threadInit()
     }
     port_filtered_commands.open((localName + "/filtered_commands:o").c_str());
 
+    //real time mode (optional). threadInit() is executed by the control thread, so the settings apply to it.
+    if (ctrl_options.check("REALTIME"))
+    {
+        yarp::os::Bottle& rt_options = ctrl_options.findGroup("REALTIME");
+        rt_enabled = rt_options.check("enable", Value(false), "enable the real time mode of the control thread").asBool();
+        if (rt_enabled && !apply_realtime_settings(rt_options))
+        {
+            return false;
+        }
+    }
+
     //start the motors
     if (rf.check("no_start"))
     {
@@ -37,10 +37,14 @@
 #include <iCub/ctrl/pids.h>
 #include <string>
 #include <math.h>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 
 #include "odometryHandler.h"
 #include "motors.h"
 #include "input.h"
+#include "filters.h"
 
 using namespace std;
 using namespace yarp::os;
@@ -65,6 +69,22 @@ enum control_type_enum
 
 typedef iCub::ctrl::parallelPID parlPID;
 
+/**
+* Timing statistics of the control loop, accumulated since the thread start (or since the last reset).
+*/
+struct loop_timing_stats
+{
+    static const int    jitter_bins = 8;
+    static const double jitter_bin_limits[jitter_bins - 1]; //upper limits of the histogram bins, expressed in seconds
+
+    unsigned long cycles = 0;
+    unsigned long overruns = 0;       //cycles whose execution time exceeded the thread period
+    double        exec_time_sum = 0;
+    double        exec_time_max = 0;  //worst case execution time [s]
+    double        jitter_max = 0;     //maximum difference between the measured and the nominal period [s]
+    unsigned long jitter_histogram[jitter_bins] = {};
+};
+
 class ControlThread : public yarp::os::PeriodicThread
 {
 private:
@@ -90,7 +110,8 @@ private:
     double               lin_ang_ratio;
     bool                 both_lin_ang_enabled;
     bool                 ratio_limiter_enabled;
-    int                  input_filter_enabled;
+    std::atomic<double>  input_filter_enabled; //cut-off frequency, also written by set_input_filter() from the rpc thread
+    int                  input_filter_order;
     bool                 debug_enabled;
     double               max_angular_vel=0;
     double               max_linear_vel=0;
@@ -99,6 +120,27 @@ private:
     double               max_linear_acc_pos = 0;
     double               max_linear_acc_neg = 0;
 
+    //filters on the input commands. Each one keeps the history of a single signal.
+    control_filters::LowPassFilter<> input_filter_angular_speed;
+    control_filters::LowPassFilter<> input_filter_linear_speed;
+    control_filters::LowPassFilter<> input_filter_desired_direction;
+    control_filters::RateLimiter<>   acc_limiter_angular_speed;
+    control_filters::RateLimiter<>   acc_limiter_xcomp;
+    control_filters::RateLimiter<>   acc_limiter_ycomp;
+
+    //real time mode
+    bool                 rt_enabled;
+    bool                 rt_active;
+
+    //timing statistics. The control thread updates timing_local and copies it to timing_shared
+    //only if the mutex is free, so that it is never blocked by the readers.
+    loop_timing_stats                     timing_local;
+    loop_timing_stats                     timing_shared;
+    std::mutex                            timing_mutex;
+    std::atomic<bool>                     timing_reset_request;
+    std::chrono::steady_clock::time_point timing_prev_start;
+    bool                                  timing_prev_valid;
+
     //ROS node
     yarp::os::Node*     rosNode;
 
@@ -162,17 +204,33 @@ public:
     */
     void printStats();
 
+    /**
+    * Gets the timing statistics of the control loop.
+    * @return a copy of the statistics, updated at most one cycle ago
+    */
+    loop_timing_stats get_timing_stats();
+
+    /**
+    * Clears the timing statistics of the control loop. They are cleared by the control thread at its next cycle.
+    */
+    void reset_timing_stats() { timing_reset_request = true; }
+
+    /**
+    * @return true if the real time settings (scheduling policy, cpu affinity, memory locking) are active
+    */
+    bool is_realtime_active() { return rt_active; }
+
     /**
     * Sets the PID control gains if the current control mode is: velocity_pid, openloop_pid.
     */
     void set_pid (string id, double kp, double ki, double kd);
 
     /**
-    * Sets an low pass filter on input commands.
-    * @param b is a code which specifies the filter type. Can be one of the following: 0 (disabled) or
-    * 1,2,4,8 for a first order low-pass filter with a cut-off frequency of 1,2,4,8Hz.
+    * Sets an low pass filter on input commands. The filter is reconfigured by the control thread at its next cycle.
+    * @param b the cut-off frequency of the butterworth low-pass filter, expressed in Hz (0 = disabled).
+    * It must be lower than half of the thread rate.
     */
-    void set_input_filter    (int b) {input_filter_enabled=b;}
+    void set_input_filter    (double b) {input_filter_enabled=b;}
 
     /**
     * Gets robot max linear velocity.
@@ -194,6 +252,10 @@ protected:
     void apply_input_filter  (double& linear_speed, double& angular_speed, double& desired_direction);
     void apply_control_openloop_pid(double& pidout_linear_throttle, double& pidout_angular_throttle, const double ref_linear_speed, const double ref_angular_speed);
     void apply_control_speed_pid(double& pidout_linear_throttle, double& pidout_angular_throttle, const double ref_linear_speed, const double ref_angular_speed);
+
+    //Real time settings and timing statistics. For internal use only.
+    bool apply_realtime_settings(yarp::os::Bottle& rt_options);
+    void update_timing_stats(std::chrono::steady_clock::time_point cycle_start);
 };
 
 #endif
@@ -17,139 +17,44 @@
 */
 
 #include "filters.h"
-#include "yarp/os/Log.h"
-#include "yarp/os/LogStream.h"
 
-double control_filters::lp_filter_8Hz(double input, int i)
-{
-    //This is a butterworth low pass first order, with a cut off frequency of 2Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input / 2.818993247e+00;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.2905268567   * yv[0][i]);
-    return yv[1][i];
-}
-
-double control_filters::lp_filter_4Hz(double input, int i)
-{
-    //This is a butterworth low pass first order, with a cut off frequency of 4Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input /4.894742855e+00;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.5913983514  * yv[0][i]);
-    return yv[1][i];
-}
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
-double control_filters::lp_filter_2Hz(double input, int i)
+int control_filters::butterworth_sections(int order, double cutoff_frequency, double sample_period, filter_section sections[])
 {
-    //This is a butterworth low pass first order, with a cut off frequency of 2Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input /8.915815088e+00;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.7756795110 * yv[0][i]);
-    return yv[1][i];
-}
+    if (order < 1 || order > max_filter_order) return 0;
+    if (sample_period <= 0 || cutoff_frequency <= 0) return 0;
+    if (cutoff_frequency >= 0.5 / sample_period) return 0;
 
-double control_filters::lp_filter_1Hz(double input, int i)
-{
-    //This is a butterworth low pass first order, with a cut off frequency of 1Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input /1.689454484e+01;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.8816185924 * yv[0][i]);
-    return yv[1][i];
-}
+    //prewarped cut off frequency of the analog prototype (with s = (1-z^-1)/(1+z^-1))
+    double k = tan(M_PI * cutoff_frequency * sample_period);
+    double k2 = k * k;
 
-double control_filters::lp_filter_0_5Hz(double input, int i)
-{
-    //This is a butterworth low pass first order, with a cut off frequency of 0.5Hz
-    //It must be used with a sampling frequency of 50Hz (20ms)
-    static double xv[2][10], yv[2][10];
-    xv[0][i] = xv[1][i]; 
-    xv[1][i] = input /3.282051595e+01;
-    yv[0][i] = yv[1][i]; 
-    yv[1][i] =   (xv[0][i] + xv[1][i]) + (  0.9390625058 * yv[0][i]);
-    return yv[1][i];
-}
-
-double control_filters::ratelim_filter_0(double input, int i, double rate_pos, double rate_neg)
-{
-    //This is a rate limiter filter. 
-    static double prev[10];
-
-//    if (i==9) {yCDebug() << "9>>>" << input << rate_pos << rate_neg << prev[9];} //print lin vel along x axis
-    
-    if (input*prev[i]>=0)
+    //each pair of complex conjugate poles gives a section H(s) = k^2 / (s^2 + a*k*s + k^2)
+    int count = 0;
+    for (int i = 0; i < order / 2; i++)
     {
-        if (input > 0)
-        {
-            if (abs(input) > abs(prev[i]))
-            {
-                if (abs(input - prev[i]) > rate_pos) prev[i] = prev[i] + rate_pos;
-                else     prev[i] = input;
-                return prev[i];
-            }
-            else
-            {
-                if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] - rate_neg;
-                else     prev[i] = input;
-                return prev[i];
-            }
-        }
-        if (input < 0)
-        {
-        
-            if (abs(input) > abs(prev[i]))
-            {
-                if (abs(input - prev[i]) > rate_pos) prev[i] = prev[i] - rate_pos;
-                else     prev[i] = input;
-                return prev[i];
-            }
-            else
-            {
-                if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] + rate_neg;
-                else     prev[i] = input;
-                return prev[i];
-            }
-        }
-        if (input == 0)
-        {
-            if (prev[i]>0)
-            {
-                if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] - rate_neg;
-                else     prev[i] = input;
-                return prev[i];
-            }
-            else
-            {
-                if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] + rate_neg;
-                else     prev[i] = input;
-                return prev[i];
-            }
-        }
+        double a = 2 * sin((2 * i + 1) * M_PI / (2 * order));
+        double d0 = 1 + a * k + k2;
+        filter_section& s = sections[count++];
+        s.b0 = k2 / d0;
+        s.b1 = 2 * k2 / d0;
+        s.b2 = k2 / d0;
+        s.a1 = 2 * (k2 - 1) / d0;
+        s.a2 = (1 - a * k + k2) / d0;
     }
-    else
-    {
-        if (input > 0)
-        {
 
-            if (abs(input - prev[i]) > rate_pos) prev[i] = prev[i] + rate_pos;
-            else     prev[i] = input;
-            return prev[i];
-        }
-        else
-        {
-            if (abs(input - prev[i]) > rate_neg) prev[i] = prev[i] - rate_neg;
-            else     prev[i] = input;
-            return prev[i];
-        }
+    //the real pole of the odd order filters gives a section H(s) = k / (s + k)
+    if (order % 2 == 1)
+    {
+        filter_section& s = sections[count++];
+        s.b0 = k / (1 + k);
+        s.b1 = k / (1 + k);
+        s.b2 = 0;
+        s.a1 = (k - 1) / (1 + k);
+        s.a2 = 0;
     }
+    return count;
 }
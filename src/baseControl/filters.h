@@ -24,25 +24,171 @@
 namespace control_filters
 {
     /**
-    * These functions implement a butterworth low pass first order, with a cut off frequency of 0.5-8Hz.
-    * Coefficients have been computed in order to be used with a sampling frequency of 50Hz (20ms)
-    * @param input the value to be filtered
-    * @param i the joint number (0-9)
-    * @return the filtered value
+    * The maximum order of the butterworth filters.
     */
-    double lp_filter_8Hz    (double input, int i);
-    double lp_filter_4Hz    (double input, int i);
-    double lp_filter_2Hz    (double input, int i);
-    double lp_filter_1Hz    (double input, int i);
-    double lp_filter_0_5Hz  (double input, int i);
+    const int max_filter_order = 8;
 
     /**
-    * This function implements a rate limiter filter.
-    * @param input the value to be filtered
-    * @param i the joint number
-    * @param rate the maximum change rate
-    * @return the filtered value
+    * The coefficients of a second order section of a digital filter:
+    * y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]
+    * A first order section has b2 = a2 = 0.
     */
-    double ratelim_filter_0 (double input, int i, double rate_pos, double rate_neg);
+    struct filter_section
+    {
+        double b0, b1, b2;
+        double a1, a2;
+    };
+
+    /**
+    * Computes the coefficients of a butterworth low pass filter. The analog filter is discretized with the bilinear
+    * transform, prewarping the cut off frequency, so the -3dB point is exactly at cutoff_frequency for any sampling period.
+    * The filter is split in second order sections (plus a first order section if the order is odd), each one with unit gain
+    * at zero frequency.
+    * @param order the filter order (1 - max_filter_order)
+    * @param cutoff_frequency the cut off frequency, expressed in Hz. It must be lower than the Nyquist frequency.
+    * @param sample_period the sampling period, expressed in seconds
+    * @param sections the array which receives the (order+1)/2 sections
+    * @return the number of sections, 0 if the parameters are not valid.
+    */
+    int butterworth_sections(int order, double cutoff_frequency, double sample_period, filter_section sections[]);
+
+    /**
+    * A butterworth low pass filter, of configurable order and cut off frequency.
+    * Each instance keeps its own history, so any number of signals can be filtered independently.
+    * A disabled filter returns its input unchanged.
+    */
+    template <typename T = double>
+    class LowPassFilter
+    {
+    private:
+        filter_section  sections[(max_filter_order + 1) / 2];
+        T               z1[(max_filter_order + 1) / 2];
+        T               z2[(max_filter_order + 1) / 2];
+        int             section_count = 0;
+        int             order = 0;
+        double          cutoff_frequency = 0;
+        double          sample_period = 0;
+        T               output = T(0);
+
+    public:
+        LowPassFilter() {}
+
+        /**
+        * Configures the filter. The current output is kept as initial state, so that the filter can be
+        * reconfigured while the signal is being filtered, without steps in the output.
+        * @param _order the filter order (1 - max_filter_order)
+        * @param _cutoff_frequency the cut off frequency, expressed in Hz. 0 disables the filter.
+        * @param _sample_period the period between two calls to filter(), expressed in seconds
+        * @return false if the parameters are not valid. In this case the filter is disabled.
+        */
+        bool init(int _order, double _cutoff_frequency, double _sample_period)
+        {
+            order = _order;
+            cutoff_frequency = _cutoff_frequency;
+            sample_period = _sample_period;
+            section_count = 0;
+            if (cutoff_frequency <= 0)
+            {
+                return true;
+            }
+            section_count = butterworth_sections(order, cutoff_frequency, sample_period, sections);
+            reset(output);
+            return section_count > 0;
+        }
+
+        /**
+        * Sets the filter history as if the input had been constant and equal to value since ever.
+        * @param value the steady state value
+        */
+        void reset(T value = T(0))
+        {
+            for (int i = 0; i < section_count; i++)
+            {
+                z2[i] = (sections[i].b2 - sections[i].a2) * value;
+                z1[i] = (sections[i].b1 - sections[i].a1) * value + z2[i];
+            }
+            output = value;
+        }
+
+        /**
+        * Filters a new sample.
+        * @param input the value to be filtered
+        * @return the filtered value
+        */
+        T filter(T input)
+        {
+            T value = input;
+            for (int i = 0; i < section_count; i++)
+            {
+                //transposed direct form II
+                const filter_section& s = sections[i];
+                T y = s.b0 * value + z1[i];
+                z1[i] = s.b1 * value - s.a1 * y + z2[i];
+                z2[i] = s.b2 * value - s.a2 * y;
+                value = y;
+            }
+            output = value;
+            return output;
+        }
+
+        bool   is_enabled() const           { return section_count > 0; }
+        int    get_order() const            { return order; }
+        double get_cutoff_frequency() const { return cutoff_frequency; }
+        double get_sample_period() const    { return sample_period; }
+    };
+
+    /**
+    * A rate limiter filter: the output follows the input, but it cannot change by more than a given amount at each sample.
+    * The positive rate is used when the absolute value of the output grows, the negative rate when it decreases.
+    * Each instance keeps its own history, so any number of signals can be limited independently.
+    */
+    template <typename T = double>
+    class RateLimiter
+    {
+    private:
+        T prev = T(0);
+
+    public:
+        RateLimiter() {}
+
+        /**
+        * Sets the current output of the filter.
+        * @param value the new output
+        */
+        void reset(T value = T(0)) { prev = value; }
+
+        /**
+        * Filters a new sample.
+        * @param input the value to be filtered
+        * @param rate_pos the maximum change of the output when its absolute value grows
+        * @param rate_neg the maximum change of the output when its absolute value decreases
+        * @return the filtered value
+        */
+        T filter(T input, T rate_pos, T rate_neg)
+        {
+            //the positive rate applies when the output moves away from zero. When the input has the opposite sign
+            //of the output, the positive rate applies only if the input is positive.
+            bool accelerating;
+            if (input * prev >= 0)
+            {
+                accelerating = (input != 0) && (fabs(input) > fabs(prev));
+            }
+            else
+            {
+                accelerating = (input > 0);
+            }
+
+            T rate = accelerating ? rate_pos : rate_neg;
+            if (fabs(input - prev) > rate)
+            {
+                prev = (input > prev) ? prev + rate : prev - rate;
+            }
+            else
+            {
+                prev = input;
+            }
+            return prev;
+        }
+    };
 }
 #endif
@@ -67,7 +67,6 @@ public:
     void execute_speed(double appl_linear_speed, double appl_desired_direction, double appl_angular_speed);
     void decouple(double appl_linear_speed, double appl_desired_direction, double appl_angular_speed);
     void close();
-    void set_motors_filter(filter_frequency b) {motors_filter_enabled=b;}
     double get_vlin_coeff();
     double get_vang_coeff();
 };
@@ -23,27 +23,42 @@ YARP_LOG_COMPONENT(IKART_ODOM, "navigation.baseControl.ikartOdometry")
 
 bool iKart_Odometry::reset_odometry()
 {
-    ienc->getEncoder(0,&encA_offset);
-    ienc->getEncoder(1,&encB_offset);
-    ienc->getEncoder(2,&encC_offset);
+    mutex.wait();
+    double timestamp = 0;
+    if (!read_encoders(enc_offset, timestamp))
+    {
+        mutex.post();
+        yCError(IKART_ODOM, "Unable to read the encoders, odometry not reset");
+        return false;
+    }
+    enc.zero();
+    enc_prev.zero();
     odom_x=0;
     odom_y=0;
     encvel_estimator->reset();
+    mutex.post();
     yCInfo(IKART_ODOM,"Odometry reset done");
     return true;
 }
 
 void iKart_Odometry::printStats()
 {
+    //the values are copied under the lock and printed without it, not to delay the control thread
     mutex.wait();
+    double e[3] = { enc[0], enc[1], enc[2] };
+    double ev[3] = { encv[0], encv[1], encv[2] };
+    double bvx = base_vel_x, bvy = base_vel_y, bvt = base_vel_theta;
+    double ovx = odom_vel_x, ovy = odom_vel_y;
+    double ox = odom_x, oy = odom_y, ot = odom_theta;
+    mutex.post();
+
     //yCInfo (stdout,"Odometry Thread: Curr motor velocities: %+3.3f %+3.3f %+3.3f\n", velA, velB, velC);
     yCInfo (IKART_ODOM,"* Odometry Thread:");
     yCInfo (IKART_ODOM,"enc1:%+9.1f enc2:%+9.1f enc3:%+9.1f ******** env1:%+9.3f env2:%+9.3f env3:%+9.3f\n",
-    enc[0]*57, enc[1]*57, enc[2]*57, encv[0]*57, encv[1]*57, encv[2]*57);
+    e[0]*57, e[1]*57, e[2]*57, ev[0]*57, ev[1]*57, ev[2]*57);
     
     yCInfo (IKART_ODOM,"ivlx:%+9.3f ivly:%+9.3f                ******** ovlx:%+9.3f ovly:%+9.3f ovlt:%+9.3f ******** x: %+5.3f y: %+5.3f t: %+5.3f\n",
-    base_vel_x, base_vel_y, odom_vel_x, odom_vel_y, base_vel_theta,  odom_x, odom_y,odom_theta );
-    mutex.post();
+    bvx, bvy, ovx, ovy, bvt, ox, oy, ot);
 }
 
 iKart_Odometry::~iKart_Odometry()
@@ -71,8 +86,14 @@ iKart_Odometry::iKart_Odometry(PolyDriver* _driver) : OdometryHandler(_driver)
     geom_L = 0;
     g_angle = 0;
     encvel_estimator =new iCub::ctrl::AWLinEstimator(3,1.0);
-    enc.resize(3);
-    encv.resize(3);
+    enc_raw.resize(3, 0.0);
+    enc_offset.resize(3, 0.0);
+    enc.resize(3, 0.0);
+    enc_prev.resize(3, 0.0);
+    encv.resize(3, 0.0);
+    encvel_element.data.resize(3, 0.0);
+    ikin.resize(3, 3);
+    ikin.zero();
 }
 
 bool iKart_Odometry::open(const Property &_options)
@@ -97,6 +118,11 @@ bool iKart_Odometry::open(const Property &_options)
         yCError(IKART_ODOM,"one or more devices has not been viewed");
         return false;
     }
+    if (!control_board_driver->view(ienc_timed))
+    {
+        yCWarning(IKART_ODOM, "IEncodersTimed not available, the encoders will be timestamped on reception");
+        ienc_timed = 0;
+    }
     // open control input ports
     bool ret= true;
     ret &= port_odometry.open((localName+"/odometry:o").c_str());
@@ -151,43 +177,13 @@ bool iKart_Odometry::open(const Property &_options)
     geom_L = geometry_group.find("geom_L").asDouble();
     g_angle = geometry_group.find("g_angle").asDouble();
     geometry_group.toString();
-    return true;
-}
-
-void iKart_Odometry::compute()
-{
-    mutex.wait();
-
-    //read the encoders (deg)
-    ienc->getEncoder(0,&encA);
-    ienc->getEncoder(1,&encB);
-    ienc->getEncoder(2,&encC);
-        
-    //read the speeds (deg/s)
-    ienc->getEncoderSpeed(0,&velA);
-    ienc->getEncoderSpeed(1,&velB);
-    ienc->getEncoderSpeed(2,&velC);
-        
-    //remove the offset and convert in radians
-    enc[0]= -(encA - encA_offset) * 0.0174532925; 
-    enc[1]= -(encB - encB_offset) * 0.0174532925;
-    enc[2]= -(encC - encC_offset) * 0.0174532925;
-       
-    //estimate the speeds
-    iCub::ctrl::AWPolyElement el;
-    el.data=enc;
-    el.time=Time::now();
-    encv= encvel_estimator->estimate(el);
 
     // -------------------------------------------------------------------------------------
     // The following formulas are adapted from:
     // "A New Odometry System to reduce asymmetric Errors for Omnidirectional Mobile Robots"
     // -------------------------------------------------------------------------------------
 
-    //compute the orientation. odom_theta is expressed in radians
-    odom_theta = geom_r*(enc[0]+enc[1]+enc[2])/(3*geom_L);
-
-    //build the kinematics matrix
+    //build the kinematics matrix. It depends only on the geometry, so it is computed once.
     yarp::sig::Matrix kin;
     kin.resize(3,3);
     kin.zero();
@@ -211,41 +207,53 @@ void iKart_Odometry::compute()
     m_gangle(1,1) = cos (g_angle);
     m_gangle(2,2) = 1;
 
-    yarp::sig::Matrix ikin = luinv(kin);
-    ikin=m_gangle*ikin;
+    ikin = m_gangle*luinv(kin);
+    return true;
+}
+
+void iKart_Odometry::compute()
+{
+    mutex.wait();
+
+    //read the encoders of all the wheels (deg), with their acquisition time
+    double timestamp = 0;
+    if (!read_encoders(enc_raw, timestamp))
+    {
+        mutex.post();
+        return;
+    }
+
+    //remove the offset and convert in radians
+    enc[0]= -(enc_raw[0] - enc_offset[0]) * DEG2RAD;
+    enc[1]= -(enc_raw[1] - enc_offset[1]) * DEG2RAD;
+    enc[2]= -(enc_raw[2] - enc_offset[2]) * DEG2RAD;
 
-    //build the rotation matrix
-    yarp::sig::Matrix m1;
-    m1.resize(3,3);
-    m1.zero();
-    m1(0,0) = cos (odom_theta);
-    m1(0,1) = -sin (odom_theta);
-    m1(1,0) = sin (odom_theta);
-    m1(1,1) = cos (odom_theta);
-    m1(2,2) = 1;
+    //estimate the speeds. The estimator is fed only with new samples, using the time of their acquisition
+    if (timestamp > last_time)
+    {
+        encvel_element.data[0] = enc[0];
+        encvel_element.data[1] = enc[1];
+        encvel_element.data[2] = enc[2];
+        encvel_element.time = timestamp;
+        encv = encvel_estimator->estimate(encvel_element);
+        last_time = timestamp;
+    }
 
-    yarp::sig::Matrix m2;
-    m2.resize(3,3);
-    m2.zero();
-    m2(0,0) = cos (0.0);
-    m2(0,1) = -sin (0.0);
-    m2(1,0) = sin (0.0);
-    m2(1,1) = cos (0.0);
-    m2(2,2) = 1;
+    //compute the orientation, at the previous and at the current cycle. theta is expressed in radians
+    double theta_prev = geom_r*(enc_prev[0]+enc_prev[1]+enc_prev[2])/(3*geom_L);
+    double theta = geom_r*(enc[0]+enc[1]+enc[2])/(3*geom_L);
 
-    yarp::sig::Vector odom_cart_vels;  //velocities expressed in the world reference frame
-    yarp::sig::Vector ikart_cart_vels; //velocities expressed in the ikart reference frame
-    odom_cart_vels  = m1*ikin*encv;
-    ikart_cart_vels = m2*ikin*encv;
+    //velocities expressed in the ikart reference frame, and in the world reference frame
+    double c = cos(theta);
+    double s = sin(theta);
+    base_vel_x     = ikin(0,0)*encv[0] + ikin(0,1)*encv[1] + ikin(0,2)*encv[2];
+    base_vel_y     = ikin(1,0)*encv[0] + ikin(1,1)*encv[1] + ikin(1,2)*encv[2];
+    base_vel_theta = ikin(2,0)*encv[0] + ikin(2,1)*encv[1] + ikin(2,2)*encv[2];
+    base_vel_lin   = sqrt(base_vel_x*base_vel_x + base_vel_y*base_vel_y);
 
-    base_vel_x     = ikart_cart_vels[0];
-    base_vel_y     = ikart_cart_vels[1];
-    base_vel_theta = ikart_cart_vels[2];
-    base_vel_lin   = sqrt(odom_vel_x*odom_vel_x + odom_vel_y*odom_vel_y);
-    
-    odom_vel_x      = odom_cart_vels[0];
-    odom_vel_y      = odom_cart_vels[1];
-    odom_vel_theta  = odom_cart_vels[2];
+    odom_vel_x      = c*base_vel_x - s*base_vel_y;
+    odom_vel_y      = s*base_vel_x + c*base_vel_y;
+    odom_vel_theta  = base_vel_theta;
   
     //these are not currently used
     if (base_vel_lin<0.001)
@@ -258,41 +266,24 @@ void iKart_Odometry::compute()
         odom_vel_theta  = atan2(odom_vel_x,odom_vel_y)*RAD2DEG;
         base_vel_theta = atan2(base_vel_x,base_vel_y)*RAD2DEG;
     }
-    //convert from radians back to degrees
-    odom_theta       *= RAD2DEG;
-    traveled_angle   *= RAD2DEG;
 
-    //the integration step
-    double period=el.time-last_time;
-    odom_x=odom_x + (odom_vel_x * period);
-    odom_y=odom_y + (odom_vel_y * period);
+    //the integration step: the displacement of the base since the previous cycle is integrated along an arc,
+    //so the result does not depend on the period of the thread
+    double denc[3] = { enc[0] - enc_prev[0], enc[1] - enc_prev[1], enc[2] - enc_prev[2] };
+    double dx = ikin(0,0)*denc[0] + ikin(0,1)*denc[1] + ikin(0,2)*denc[2];
+    double dy = ikin(1,0)*denc[0] + ikin(1,1)*denc[1] + ikin(1,2)*denc[2];
+    double dtheta = theta - theta_prev;
+    integrate_arc(dx, dy, dtheta, theta_prev);
+    enc_prev[0] = enc[0];
+    enc_prev[1] = enc[1];
+    enc_prev[2] = enc[2];
 
     //compute traveled distance (odometer)
-    traveled_distance = traveled_distance + fabs(base_vel_lin   * period);
-    traveled_angle    = traveled_angle    + fabs(base_vel_theta * period);
+    traveled_distance = traveled_distance + sqrt(dx*dx + dy*dy);
+    traveled_angle    = traveled_angle    + fabs(dtheta) * RAD2DEG;
 
-    /* [ -(3^(1/2)*r)/3, (3^(1/2)*r)/3,        0]
-        [            r/3,           r/3, -(2*r)/3]
-        [        r/(3*L),       r/(3*L),  r/(3*L)]*/
+    //convert from radians back to degrees
+    odom_theta = theta * RAD2DEG;
 
-    /*odom_x = -1.73205080*geom_r/3 * encA + 1.73205080*geom_r/3 * encB;
-    odom_y = geom_r/3 * encA +  geom_r/3 * encB - (2*geom_r)/3 * encC;*/
-        
-    /*
-    odom_x = geom_r/(3* 0.86602)*
-                (
-                (co3p-co3m)*encA + 
-                (-cos(odom_theta)-co3p)*encB + 
-                (cos(odom_theta)+co3m)*encC
-                );
-    odom_y = geom_r/(3* 0.86602)*
-                (
-                (si3m+si3p)*encA + 
-                (-sin(odom_theta)-si3p)*encB + 
-                (sin(odom_theta)-si3m)*encC
-                );
-    */  
     mutex.post();
-    last_time = yarp::os::Time::now();
 }
-
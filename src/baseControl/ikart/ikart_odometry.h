@@ -47,33 +47,24 @@ using namespace yarp::math;
 class iKart_Odometry: public OdometryHandler
 {
 private:
-    //encoder variables
-    double              encA_offset;
-    double              encB_offset;
-    double              encC_offset;
+    //encoder variables: raw positions (deg), offsets (deg), positions at the current and at the previous cycle (rad)
+    yarp::sig::Vector   enc_raw;
+    yarp::sig::Vector   enc_offset;
+    yarp::sig::Vector   enc;
+    yarp::sig::Vector   enc_prev;
 
-    double              encA;
-    double              encB;
-    double              encC;
-
-    //measured motor velocity
-    double              velA;
-    double              velB;
-    double              velC;
-
-    //estimated motor velocity
-    double              velA_est;
-    double              velB_est;
-    double              velC_est;
+    //estimated motor velocity (rad/s)
+    yarp::sig::Vector   encv;
     iCub::ctrl::AWLinEstimator      *encvel_estimator;
+    iCub::ctrl::AWPolyElement       encvel_element;
 
     //robot geometry
     double              geom_r;
     double              geom_L;
     double              g_angle;
 
-    yarp::sig::Vector enc;
-    yarp::sig::Vector encv;
+    //inverse kinematics: from the wheels velocities to the velocity of the base, in the base reference frame
+    yarp::sig::Matrix   ikin;
 
 public:
     /**
@@ -60,26 +60,16 @@ void MotorControl::execute_speed(double appl_linear_speed, double appl_desired_d
 
 void  MotorControl::apply_motor_filter(int joint)
 {
-    if (motors_filter_enabled == HZ_1)
+    //the cut-off frequency may have been changed by set_motors_filter()
+    control_filters::LowPassFilter<>& filter = motors_filter[joint];
+    if (filter.get_cutoff_frequency() != motors_filter_enabled)
     {
-        F[joint] = control_filters::lp_filter_1Hz(F[joint], joint);
-    }
-    else if (motors_filter_enabled == HZ_2)
-    {
-        F[joint] = control_filters::lp_filter_2Hz(F[joint], joint);
-    }
-    else if (motors_filter_enabled == HZ_4) //default
-    {
-        F[joint] = control_filters::lp_filter_4Hz(F[joint], joint);
-    }
-    else if (motors_filter_enabled == HZ_8)
-    {
-        F[joint] = control_filters::lp_filter_8Hz(F[joint], joint);
-    }
-    else if (motors_filter_enabled == HZ_05)
-    {
-        F[joint] = control_filters::lp_filter_0_5Hz(F[joint], joint);
+        if (!filter.init(motors_filter_order, motors_filter_enabled, thread_period))
+        {
+            yCError(MOTOR_CTRL, "Invalid motors filter (order %d, cut-off frequency %.2fHz, period %.3fs). Filter disabled on joint %d.", motors_filter_order, motors_filter_enabled, thread_period, joint);
+        }
     }
+    F[joint] = filter.filter(F[joint]);
 }
 
 bool MotorControl::open(const Property &_options)
@@ -140,12 +130,10 @@ bool MotorControl::open(const Property &_options)
         return false;
     }
 
-    int f = motors_options.check("motors_filter_enabled", Value(4), "motors filter frequency (1/2/4/8Hz, 0 = disabled)").asInt();
-    motors_filter_enabled = DISABLED;
-    if (f==1) motors_filter_enabled = HZ_1;
-    else if (f==2) motors_filter_enabled = HZ_2;
-    else if (f==4) motors_filter_enabled = HZ_4;
-    else if (f==8) motors_filter_enabled = HZ_8;
+    motors_filter_enabled = motors_options.check("motors_filter_enabled", Value(4), "motors filter cut-off frequency [Hz], 0 = disabled").asDouble();
+    motors_filter_order = motors_options.check("motors_filter_order", Value(1), "order of the motors butterworth filter").asInt();
+    thread_period = ctrl_options.check("thread_period", Value(0.020), "period of the control thread [s]").asDouble();
+    motors_filter.resize(motors_num);
     max_motor_pwm = motors_options.check("max_motor_pwm", Value(0), "max_motor_pwm").asDouble();
     max_motor_vel = motors_options.check("max_motor_vel", Value(0), "max_motor_vel").asDouble();
 
@@ -191,6 +179,10 @@ MotorControl::MotorControl(PolyDriver* _driver)
 
     max_motor_vel = 0;
     max_motor_pwm = 0;
+
+    motors_filter_enabled = 0;
+    motors_filter_order = 1;
+    thread_period = 0.020;
 }
 
 void MotorControl::printStats()
@@ -40,6 +40,8 @@
 #include <yarp/os/Node.h>
 #include <yarp/os/Publisher.h>
 
+#include "filters.h"
+
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -68,11 +70,13 @@ protected:
     double              max_motor_pwm;
     double              max_motor_vel;
 
-public:
-    enum filter_frequency {DISABLED=0, HZ_05=1, HZ_1=2, HZ_2=3, HZ_4=4, HZ_8=5};
+    //low pass filters on the motor commands, one for each motor
+    double              motors_filter_enabled;
+    int                 motors_filter_order;
+    double              thread_period;
+    std::vector<control_filters::LowPassFilter<> > motors_filter;
 
 protected:
-    filter_frequency           motors_filter_enabled;
     string                     localName;
     BufferedPort<Bottle>       port_status;
 
@@ -180,10 +184,12 @@ public:
     virtual void execute_speed(double appl_linear_speed, double appl_desired_direction, double appl_angular_speed) = 0;
     
     /**
-    * Enable/Disable/Sets the frequency of the motor output low pass filter. Filtering is performed by apply_motor_filter()
-    * @param freq the low pass filter frequency (or filter_frequency::DISABLED) to turn off the filter
+    * Enable/Disable/Sets the frequency of the motor output low pass filter. Filtering is performed by apply_motor_filter(),
+    * which reconfigures the filters at the next control cycle.
+    * @param freq the cut-off frequency of the butterworth low pass filter, expressed in Hz (0 to turn off the filter).
+    * It must be lower than half of the control thread rate.
     */
-    virtual void set_motors_filter(filter_frequency freq) {motors_filter_enabled=freq;}
+    virtual void set_motors_filter(double freq) {motors_filter_enabled=freq;}
 
     /**
     * Return the maximum value of joint velocity, as defined in the configuration parameters.
@@ -198,7 +204,7 @@ public:
     virtual double get_max_motor_pwm()   {return max_motor_pwm;}
 
     /**
-    * Apply a low pass filter to motor output. The frequency is defined by motors_filter_enabled variable.
+    * Apply a low pass filter to motor output. The frequency is defined by motors_filter_enabled variable, the filter order by motors_filter_order.
     * @param joint the joint number
     */
     virtual void  apply_motor_filter(int joint);
@@ -30,9 +30,27 @@ OdometryHandler::~OdometryHandler()
     close();
 }
 
-OdometryHandler::OdometryHandler(PolyDriver* _driver)
+void OdometryPublisher::run()
+{
+    while (!isStopping())
+    {
+        handler->snapshot_ready.wait();
+        if (isStopping()) break;
+        handler->broadcast();
+    }
+}
+
+void OdometryPublisher::onStop()
+{
+    handler->snapshot_ready.post();
+}
+
+OdometryHandler::OdometryHandler(PolyDriver* _driver) : snapshot_ready(0), publisher(this)
 {
     control_board_driver = _driver;
+    ienc                 = 0;
+    ienc_timed           = 0;
+    last_time            = -1;
     odom_x               = 0;
     odom_y               = 0;
     odom_z               = 0;
@@ -128,11 +146,22 @@ bool OdometryHandler::open(const Property &options)
             footprint.polygon.points[i].z = 0;
         }
     }
+
+    if (!publisher.start())
+    {
+        yCError(ODOM_HND) << "Unable to start the odometry publisher thread";
+        return false;
+    }
     return true;
 }
 
 void OdometryHandler::close()
 {
+    if (publisher.isRunning())
+    {
+        publisher.stop();
+    }
+
     port_odometry.interrupt();
     port_odometry.close();
     port_odometer.interrupt();
@@ -151,23 +180,55 @@ void OdometryHandler::close()
     }
 }
 
-void OdometryHandler::broadcast()
+void OdometryHandler::publish()
 {
     mutex.wait();
-    timeStamp.update();
+    odometry_snapshot& s = snapshots.write_buffer();
+    s.time              = last_time;
+    s.odom_x            = odom_x;
+    s.odom_y            = odom_y;
+    s.odom_z            = odom_z;
+    s.odom_theta        = odom_theta;
+    s.odom_vel_x        = odom_vel_x;
+    s.odom_vel_y        = odom_vel_y;
+    s.odom_vel_lin      = odom_vel_lin;
+    s.odom_vel_theta    = odom_vel_theta;
+    s.base_vel_x        = base_vel_x;
+    s.base_vel_y        = base_vel_y;
+    s.base_vel_lin      = base_vel_lin;
+    s.base_vel_theta    = base_vel_theta;
+    s.traveled_distance = traveled_distance;
+    s.traveled_angle    = traveled_angle;
+    mutex.post();
+
+    snapshots.publish();
+    snapshot_ready.post();
+}
+
+void OdometryHandler::broadcast()
+{
+    //only the latest odometry is broadcast: if the ports are slower than the control thread, the older data are skipped
+    if (!snapshots.update())
+    {
+        return;
+    }
+    const odometry_snapshot& odom = snapshots.read_buffer();
+
+    if (odom.time > 0) timeStamp.update(odom.time);
+    else               timeStamp.update();
     if (port_odometry.getOutputCount()>0)
     {
         port_odometry.setEnvelope(timeStamp);
         yarp::dev::OdometryData &b = port_odometry.prepare();
-        b.odom_x=odom_x; //position in the odom reference frame
-        b.odom_y=odom_y;
-        b.odom_theta=odom_theta;
-        b.base_vel_x=base_vel_x; //velocity in the robot reference frame
-        b.base_vel_y=base_vel_y;
-        b.base_vel_theta=base_vel_theta;
-        b.odom_vel_x=odom_vel_x; //velocity in the odom reference frame
-        b.odom_vel_y=odom_vel_y;
-        b.odom_vel_theta=odom_vel_theta;
+        b.odom_x=odom.odom_x; //position in the odom reference frame
+        b.odom_y=odom.odom_y;
+        b.odom_theta=odom.odom_theta;
+        b.base_vel_x=odom.base_vel_x; //velocity in the robot reference frame
+        b.base_vel_y=odom.base_vel_y;
+        b.base_vel_theta=odom.base_vel_theta;
+        b.odom_vel_x=odom.odom_vel_x; //velocity in the odom reference frame
+        b.odom_vel_y=odom.odom_vel_y;
+        b.odom_vel_theta=odom.odom_vel_theta;
         port_odometry.write();
     }
 
@@ -176,8 +237,8 @@ void OdometryHandler::broadcast()
         port_odometer.setEnvelope(timeStamp);
         Bottle &t = port_odometer.prepare();
         t.clear();
-        t.addDouble(traveled_distance);
-        t.addDouble(traveled_angle);
+        t.addDouble(odom.traveled_distance);
+        t.addDouble(odom.traveled_angle);
         port_odometer.write();
     }
 
@@ -186,8 +247,8 @@ void OdometryHandler::broadcast()
         port_vels.setEnvelope(timeStamp);
         Bottle &v = port_vels.prepare();
         v.clear();
-        v.addDouble(base_vel_lin);
-        v.addDouble(base_vel_theta);
+        v.addDouble(odom.base_vel_lin);
+        v.addDouble(odom.base_vel_theta);
         port_vels.write();
     }
 
@@ -199,11 +260,11 @@ void OdometryHandler::broadcast()
         rosData.header.frame_id = odometry_frame_id;
         rosData.child_frame_id = child_frame_id;
 
-        rosData.pose.pose.position.x = odom_x;
-        rosData.pose.pose.position.y = odom_y;
+        rosData.pose.pose.position.x = odom.odom_x;
+        rosData.pose.pose.position.y = odom.odom_y;
         rosData.pose.pose.position.z = 0.0;
         yarp::rosmsg::geometry_msgs::Quaternion odom_quat;
-        double halfYaw = odom_theta * DEG2RAD * 0.5;
+        double halfYaw = odom.odom_theta * DEG2RAD * 0.5;
         double cosYaw = cos(halfYaw);
         double sinYaw = sin(halfYaw);
         odom_quat.x = 0;
@@ -211,12 +272,12 @@ void OdometryHandler::broadcast()
         odom_quat.z = sinYaw;
         odom_quat.w = cosYaw;
         rosData.pose.pose.orientation = odom_quat;
-        rosData.twist.twist.linear.x = base_vel_x;
-        rosData.twist.twist.linear.y = base_vel_y;
+        rosData.twist.twist.linear.x = odom.base_vel_x;
+        rosData.twist.twist.linear.y = odom.base_vel_y;
         rosData.twist.twist.linear.z = 0;
         rosData.twist.twist.angular.x = 0;
         rosData.twist.twist.angular.y = 0;
-        rosData.twist.twist.angular.z = base_vel_theta * DEG2RAD;
+        rosData.twist.twist.angular.z = odom.base_vel_theta * DEG2RAD;
 
         rosPublisherPort_odometry.write();
     }
@@ -239,16 +300,16 @@ void OdometryHandler::broadcast()
         transform.header.frame_id = odometry_frame_id;
         transform.header.seq = timeStamp.getCount();
         transform.header.stamp = timeStamp.getTime();
-        double halfYaw = odom_theta * DEG2RAD * 0.5;
+        double halfYaw = odom.odom_theta * DEG2RAD * 0.5;
         double cosYaw = cos(halfYaw);
         double sinYaw = sin(halfYaw);
         transform.transform.rotation.x = 0;
         transform.transform.rotation.y = 0;
         transform.transform.rotation.z = sinYaw;
         transform.transform.rotation.w = cosYaw;
-        transform.transform.translation.x = odom_x;
-        transform.transform.translation.y = odom_y;
-        transform.transform.translation.z = odom_z;
+        transform.transform.translation.x = odom.odom_x;
+        transform.transform.translation.y = odom.odom_y;
+        transform.transform.translation.z = odom.odom_z;
         if (rosData.transforms.size() == 0)
         {
             rosData.transforms.push_back(transform);
@@ -261,8 +322,44 @@ void OdometryHandler::broadcast()
 
         rosPublisherPort_tf.write();
     }
+}
 
-    mutex.post();
+bool OdometryHandler::read_encoders(yarp::sig::Vector& encs, double& timestamp)
+{
+    if (ienc_timed)
+    {
+        if (enc_stamps.size() != encs.size()) enc_stamps.resize(encs.size());
+        if (!ienc_timed->getEncodersTimed(encs.data(), enc_stamps.data()))
+        {
+            return false;
+        }
+
+        //all the joints are acquired together, their timestamps differ only for the transmission
+        timestamp = 0;
+        for (size_t i = 0; i < enc_stamps.size(); i++)
+        {
+            timestamp += enc_stamps[i];
+        }
+        timestamp /= enc_stamps.size();
+        if (timestamp <= 0)
+        {
+            timestamp = yarp::os::Time::now();
+        }
+        return true;
+    }
+
+    timestamp = yarp::os::Time::now();
+    return ienc->getEncoders(encs.data());
+}
+
+void OdometryHandler::integrate_arc(double dx, double dy, double dtheta, double theta)
+{
+    double half = dtheta / 2;
+    double k = (fabs(half) > 1e-9) ? sin(half) / half : 1.0;
+    double c = cos(theta + half);
+    double s = sin(theta + half);
+    odom_x += k * (dx * c - dy * s);
+    odom_y += k * (dx * s + dy * c);
 }
 
 double OdometryHandler::get_base_vel_lin()
@@ -30,6 +30,7 @@
 #include <yarp/dev/Drivers.h>
 #include <yarp/dev/PolyDriver.h>
 #include <yarp/os/RateThread.h>
+#include <yarp/os/Thread.h>
 #include <yarp/os/Semaphore.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <iCub/ctrl/adaptWinPolyEstimator.h>
@@ -44,6 +45,8 @@
 #include <yarp/rosmsg/tf2_msgs/TFMessage.h>
 #include <yarp/dev/OdometryData.h>
 
+#include "tripleBuffer.h"
+
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -60,8 +63,54 @@ using namespace yarp::math;
 #define DEG2RAD M_PI/180.0
 #endif
 
+class OdometryHandler;
+
+/**
+* The thread which writes the odometry ports. It is woken up by OdometryHandler::publish(), so that the control thread
+* never waits on the ports.
+*/
+class OdometryPublisher : public yarp::os::Thread
+{
+private:
+    OdometryHandler*    handler;
+
+public:
+    OdometryPublisher(OdometryHandler* _handler) : handler(_handler) {}
+    virtual void run();
+    virtual void onStop();
+};
+
 class OdometryHandler
 {
+    friend class OdometryPublisher;
+
+public:
+    //the odometry data sent over the ports
+    struct odometry_snapshot
+    {
+        double          time;       //acquisition time of the encoders
+        double          odom_x;
+        double          odom_y;
+        double          odom_z;
+        double          odom_theta;
+        double          odom_vel_x;
+        double          odom_vel_y;
+        double          odom_vel_lin;
+        double          odom_vel_theta;
+        double          base_vel_x;
+        double          base_vel_y;
+        double          base_vel_lin;
+        double          base_vel_theta;
+        double          traveled_distance;
+        double          traveled_angle;
+    };
+
+private:
+    //handover of the odometry from the control thread to the publisher thread
+    TripleBuffer<odometry_snapshot>  snapshots;
+    yarp::os::Semaphore              snapshot_ready;
+    OdometryPublisher                publisher;
+
 protected:
     Property              ctrl_options;
     yarp::os::Semaphore   mutex;
@@ -115,6 +164,28 @@ protected:
     //motor control interfaces 
     PolyDriver                      *control_board_driver;
     IEncoders                       *ienc;
+    IEncodersTimed                  *ienc_timed;
+    yarp::sig::Vector               enc_stamps;
+
+protected:
+    /**
+    * Reads the position of all the joints with a single call to the control board.
+    * @param encs the joint positions (deg). It must be already sized as the number of joints.
+    * @param timestamp the acquisition time of the positions. It is the timestamp given by the control board if available,
+    * the current time otherwise.
+    * @return true if the encoders have been read successfully.
+    */
+    bool           read_encoders(yarp::sig::Vector& encs, double& timestamp);
+
+    /**
+    * Integrates a displacement of the base into odom_x, odom_y, assuming a constant velocity during the step, i.e. a motion along an arc.
+    * The displacement is rotated by the heading at the middle of the step and scaled by the ratio between the chord and the arc.
+    * @param dx the displacement along the x axis of the base, at the beginning of the step [m]
+    * @param dy the displacement along the y axis of the base, at the beginning of the step [m]
+    * @param dtheta the rotation of the base during the step [rad]
+    * @param theta the heading of the base at the beginning of the step [rad]
+    */
+    void           integrate_arc(double dx, double dy, double dtheta, double theta);
 
 public:
     /**
@@ -147,7 +218,12 @@ public:
     virtual void   compute() = 0;
 
     /**
-    * Broadcast odometry data over YARP ports (or ROS topics)
+    * Makes the odometry computed by compute() available to the publisher thread. It never blocks on I/O.
+    */
+    virtual void   publish();
+
+    /**
+    * Broadcast the last published odometry data over YARP ports (or ROS topics). Called by the publisher thread.
     */
     virtual void   broadcast();
 
@@ -0,0 +1,74 @@
+/*
+* Copyright (C)2020  iCub Facility - Istituto Italiano di Tecnologia
+* Permission is granted to copy, distribute, and/or modify this program
+* under the terms of the GNU General Public License, version 2 or any
+* later version published by the Free Software Foundation.
+*
+* A copy of the license can be found at
+* http://www.robotcub.org/icub/license/gpl.txt
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details
+*/
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+/**
+* Passes the latest value of T from a single writer thread to a single reader thread without locks.
+* The writer fills write_buffer() and then calls publish(), the reader calls update() and then uses read_buffer().
+* Neither of them ever waits for the other: the writer always has a buffer not used by the reader, and the
+* third buffer holds the last published value until the reader takes it (older values are overwritten).
+*/
+template <typename T>
+class TripleBuffer
+{
+private:
+    static const int fresh_bit = 4;
+
+    T                buffers[3];
+    std::atomic<int> middle;   //the buffer exchanged between the writer and the reader, with fresh_bit set if not read yet
+    int              back;     //used only by the writer
+    int              front;    //used only by the reader
+
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+
+    /**
+    * The buffer to be filled by the writer. Its content is undefined: the writer must set all the fields.
+    */
+    T& write_buffer() { return buffers[back]; }
+
+    /**
+    * Makes the content of write_buffer() available to the reader.
+    */
+    void publish()
+    {
+        back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & ~fresh_bit;
+    }
+
+    /**
+    * Takes the value published last by the writer.
+    * @return false if nothing has been published since the previous call. In this case read_buffer() is unchanged.
+    */
+    bool update()
+    {
+        if ((middle.load(std::memory_order_relaxed) & fresh_bit) == 0)
+        {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~fresh_bit;
+        return true;
+    }
+
+    /**
+    * The value taken by the last call to update().
+    */
+    const T& read_buffer() const { return buffers[front]; }
+};
+
+#endif
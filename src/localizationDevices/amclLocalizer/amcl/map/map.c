@@ -51,7 +51,14 @@ map_t *map_alloc(void)
   map->scale = 0;
   
   // Allocate storage for main map
-  map->cells = (map_cell_t*) NULL;
+  map->occ_state = (int8_t*) NULL;
+  map->occ_dist = (uint16_t*) NULL;
+  map->max_occ_dist = 0;
+
+  map->range_angle_count = 0;
+  map->range_max = 0;
+  map->range_cell = (int32_t*) NULL;
+  map->range_table = (uint16_t*) NULL;
   
   return map;
 }
@@ -60,25 +67,26 @@ map_t *map_alloc(void)
 // Destroy a map
 void map_free(map_t *map)
 {
-  free(map->cells);
+  free(map->occ_state);
+  free(map->occ_dist);
+  free(map->range_cell);
+  free(map->range_table);
   free(map);
   return;
 }
 
 
-// Get the cell at the given point
-map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa)
+// Get the index of the cell at the given point
+int map_get_cell_index(map_t *map, double ox, double oy)
 {
   int i, j;
-  map_cell_t *cell;
 
   i = MAP_GXWX(map, ox);
   j = MAP_GYWY(map, oy);
   
   if (!MAP_VALID(map, i, j))
-    return NULL;
+    return -1;
 
-  cell = map->cells + MAP_INDEX(map, i, j);
-  return cell;
+  return MAP_INDEX(map, i, j);
 }
 
@@ -28,6 +28,7 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -41,20 +42,12 @@ struct _rtk_fig_t;
 // Limits
 #define MAP_WIFI_MAX_LEVELS 8
 
-  
-// Description for a single map cell.
-typedef struct
-{
-  // Occupancy state (-1 = free, 0 = unknown, +1 = occ)
-  int occ_state;
+// Number of steps used to quantize the distance to the nearest occupied cell
+// between 0 and max_occ_dist
+#define MAP_OCC_DIST_LEVELS 65535
 
-  // Distance to the nearest occupied cell
-  double occ_dist;
-
-  // Wifi levels
-  //int wifi_levels[MAP_WIFI_MAX_LEVELS];
-
-} map_cell_t;
+// Number of steps used to quantize the expected ranges between 0 and range_max
+#define MAP_RANGE_LEVELS 65535
 
 
 // Description for a map
@@ -69,12 +62,27 @@ typedef struct
   // Map dimensions (number of cells)
   int size_x, size_y;
   
-  // The map data, stored as a grid
-  map_cell_t *cells;
+  // The map data, stored as separate grids with one entry per cell (see MAP_INDEX).
+  // Occupancy state (-1 = free, 0 = unknown, +1 = occ)
+  int8_t *occ_state;
+
+  // Distance to the nearest occupied cell, quantized in MAP_OCC_DIST_LEVELS steps
+  // (see MAP_OCC_DIST). It is computed by map_update_cspace() and has one more
+  // entry than the map, holding max_occ_dist, which is used for off-map positions.
+  uint16_t *occ_dist;
 
   // Max distance at which we care about obstacles, for constructing
   // likelihood field
   double max_occ_dist;
+
+  // Expected ranges, computed by map_update_range_table() (optional).
+  // For each free cell, range_angle_count readings quantized in
+  // MAP_RANGE_LEVELS steps of range_max. range_cell gives the row of
+  // range_table of each cell, -1 for the cells which are not free.
+  int range_angle_count;
+  double range_max;
+  int32_t *range_cell;
+  uint16_t *range_table;
   
 } map_t;
 
@@ -90,8 +98,8 @@ map_t *map_alloc(void);
 // Destroy a map
 void map_free(map_t *map);
 
-// Get the cell at the given point
-map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa);
+// Get the index of the cell at the given point, -1 if outside the map
+int map_get_cell_index(map_t *map, double ox, double oy);
 
 // Load an occupancy map
 int map_load_occ(map_t *map, const char *filename, double scale, int negate);
@@ -110,6 +118,24 @@ void map_update_cspace(map_t *map, double max_occ_dist);
 // Extract a single range reading from the map
 double map_calc_range(map_t *map, double ox, double oy, double oa, double max_range);
 
+// Same as map_calc_range(), using the precomputed table when it covers the
+// request (free origin cell, max_range not larger than the one of the table)
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range);
+
+// Precompute the ranges seen from every free cell in angle_count directions,
+// up to max_range. The cells are processed in parallel. Returns -1, leaving
+// the map without a table, if the table would be larger than max_size bytes
+// (0 for no limit) or if the memory for the table is not available.
+int map_update_range_table(map_t *map, double max_range, int angle_count, size_t max_size);
+
+// Store the range table, so that it is not recomputed at the next start
+int map_save_range_table(map_t *map, const char *filename);
+
+// Load a range table stored by map_save_range_table(). Fails, returning -1,
+// if the file was computed on a different map or with other parameters, or
+// if the table is larger than max_size bytes (0 for no limit).
+int map_load_range_table(map_t *map, const char *filename, double max_range, int angle_count, size_t max_size);
+
 
 /**************************************************************************
  * GUI/diagnostic functions
@@ -137,6 +163,9 @@ void map_draw_wifi(map_t *map, struct _rtk_fig_t *fig, int index);
 #define MAP_GXWX(map, x) (floor((x - map->origin_x) / map->scale + 0.5) + map->size_x / 2)
 #define MAP_GYWY(map, y) (floor((y - map->origin_y) / map->scale + 0.5) + map->size_y / 2)
 
+// Convert a quantized distance of occ_dist to meters
+#define MAP_OCC_DIST(map, q) ((q) * map->max_occ_dist / MAP_OCC_DIST_LEVELS)
+
 // Test to see if the given map coords lie within the absolute map bounds.
 #define MAP_VALID(map, i, j) ((i >= 0) && (i < map->size_x) && (j >= 0) && (j < map->size_y))
 
@@ -19,158 +19,132 @@
  *
  */
 
-#include <queue>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <vector>
 #include "amcl/map/map.h"
+#include "amcl/map/map_parallel.h"
 
-class CellData
+// Convert a distance in meters to the representation of map_t::occ_dist
+inline uint16_t map_quantize_occ_dist(map_t* map, double distance)
 {
-  public:
-    map_t* map_;
-    unsigned int i_, j_;
-    unsigned int src_i_, src_j_;
-};
-
-class CachedDistanceMap
-{
-  public:
-    CachedDistanceMap(double scale, double max_dist) : 
-      distances_(NULL), scale_(scale), max_dist_(max_dist) 
-    {
-      cell_radius_ = max_dist / scale;
-      distances_ = new double *[cell_radius_+2];
-      for(int i=0; i<=cell_radius_+1; i++)
-      {
-	distances_[i] = new double[cell_radius_+2];
-        for(int j=0; j<=cell_radius_+1; j++)
-	{
-	  distances_[i][j] = sqrt(i*i + j*j);
-	}
-      }
-    }
-    ~CachedDistanceMap()
-    {
-      if(distances_)
-      {
-	for(int i=0; i<=cell_radius_+1; i++)
-	  delete[] distances_[i];
-	delete[] distances_;
-      }
-    }
-    double** distances_;
-    double scale_;
-    double max_dist_;
-    int cell_radius_;
-};
-
-
-bool operator<(const CellData& a, const CellData& b)
-{
-  return a.map_->cells[MAP_INDEX(a.map_, a.i_, a.j_)].occ_dist > a.map_->cells[MAP_INDEX(b.map_, b.i_, b.j_)].occ_dist;
+  double q = floor(distance / map->max_occ_dist * MAP_OCC_DIST_LEVELS + 0.5);
+  return (uint16_t) (q < MAP_OCC_DIST_LEVELS ? q : MAP_OCC_DIST_LEVELS);
 }
 
-CachedDistanceMap*
-get_distance_map(double scale, double max_dist)
+// Update the cspace distance values.
+// The exact euclidean distance transform is computed in linear time with the
+// separable algorithm of Meijster, Roerdink and Hesselink (2000): a first pass
+// finds the distance to the nearest obstacle along each column, a second pass
+// combines the columns along each row taking the lower envelope of parabolas.
+// Both passes are parallelized, over columns and over rows respectively.
+// Cells further than max_occ_dist from any obstacle get max_occ_dist.
+void map_update_cspace(map_t *map, double max_occ_dist)
 {
-  static CachedDistanceMap* cdm = NULL;
-
-  if(!cdm || (cdm->scale_ != scale) || (cdm->max_dist_ != max_dist))
-  {
-    if(cdm)
-      delete cdm;
-    cdm = new CachedDistanceMap(scale, max_dist);
-  }
+  const int size_x = map->size_x;
+  const int size_y = map->size_y;
 
-  return cdm;
-}
-
-void enqueue(map_t* map, int i, int j,
-	     int src_i, int src_j,
-	     std::priority_queue<CellData>& Q,
-	     CachedDistanceMap* cdm,
-	     unsigned char* marked)
-{
-  if(marked[MAP_INDEX(map, i, j)])
-    return;
+  map->max_occ_dist = max_occ_dist;
 
-  int di = abs(i - src_i);
-  int dj = abs(j - src_j);
-  double distance = cdm->distances_[di][dj];
+  // one more entry for the off-map positions
+  free(map->occ_dist);
+  map->occ_dist = (uint16_t*) malloc(sizeof(uint16_t) * (size_x * size_y + 1));
+  map->occ_dist[size_x * size_y] = MAP_OCC_DIST_LEVELS;
 
-  if(distance > cdm->cell_radius_)
+  // an empty map has only the off-map entry: the passes below would read
+  // the first row and column
+  if (size_x <= 0 || size_y <= 0)
     return;
 
-  map->cells[MAP_INDEX(map, i, j)].occ_dist = distance * map->scale;
+  // The distance in cells beyond which cells are considered far from obstacles
+  const int cell_radius = max_occ_dist / map->scale;
 
-  CellData cell;
-  cell.map_ = map;
-  cell.i_ = i;
-  cell.j_ = j;
-  cell.src_i_ = src_i;
-  cell.src_j_ = src_j;
+  // First pass: distance (in cells) to the nearest obstacle of the same column,
+  // stored temporarily in occ_dist. It is saturated to cell_radius + 1, which
+  // does not change the result inside cell_radius and fits the 16 bits.
+  const int column_inf = std::min(cell_radius + 1, 65535);
+  uint16_t* g = map->occ_dist;
+  const int8_t* occ = map->occ_state;
 
-  Q.push(cell);
-
-  marked[MAP_INDEX(map, i, j)] = 1;
-}
-
-// Update the cspace distance values
-void map_update_cspace(map_t *map, double max_occ_dist)
-{
-  unsigned char* marked;
-  std::priority_queue<CellData> Q;
-
-  marked = new unsigned char[map->size_x*map->size_y];
-  memset(marked, 0, sizeof(unsigned char) * map->size_x*map->size_y);
-
-  map->max_occ_dist = max_occ_dist;
-
-  CachedDistanceMap* cdm = get_distance_map(map->scale, map->max_occ_dist);
-
-  // Enqueue all the obstacle cells
-  CellData cell;
-  cell.map_ = map;
-  for(int i=0; i<map->size_x; i++)
+  map_parallel_for(size_x, 64, [&](int x_begin, int x_end)
   {
-    cell.src_i_ = cell.i_ = i;
-    for(int j=0; j<map->size_y; j++)
+    for (int x = x_begin; x < x_end; x++)
+      g[x] = (occ[x] == +1) ? 0 : column_inf;
+    for (int y = 1; y < size_y; y++)
     {
-      if(map->cells[MAP_INDEX(map, i, j)].occ_state == +1)
-      {
-	map->cells[MAP_INDEX(map, i, j)].occ_dist = 0.0;
-	cell.src_j_ = cell.j_ = j;
-	marked[MAP_INDEX(map, i, j)] = 1;
-	Q.push(cell);
-      }
-      else
-	map->cells[MAP_INDEX(map, i, j)].occ_dist = max_occ_dist;
+      const int row = y * size_x;
+      for (int x = x_begin; x < x_end; x++)
+        g[row + x] = (occ[row + x] == +1) ? 0 : std::min(g[row - size_x + x] + 1, column_inf);
+    }
+    for (int y = size_y - 2; y >= 0; y--)
+    {
+      const int row = y * size_x;
+      for (int x = x_begin; x < x_end; x++)
+        g[row + x] = std::min<int>(g[row + x], g[row + size_x + x] + 1);
     }
-  }
+  });
 
-  while(!Q.empty())
+  // Second pass: squared distance to the nearest obstacle, combining the columns
+  const long long radius_sq = (long long)cell_radius * cell_radius;
+  map_parallel_for(size_y, 64, [&](int y_begin, int y_end)
   {
-    CellData current_cell = Q.top();
-    if(current_cell.i_ > 0)
-      enqueue(map, current_cell.i_-1, current_cell.j_, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if(current_cell.j_ > 0)
-      enqueue(map, current_cell.i_, current_cell.j_-1, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if((int)current_cell.i_ < map->size_x - 1)
-      enqueue(map, current_cell.i_+1, current_cell.j_, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if((int)current_cell.j_ < map->size_y - 1)
-      enqueue(map, current_cell.i_, current_cell.j_+1, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
+    std::vector<long long> g_sq(size_x);
+    std::vector<int> s(size_x);
+    std::vector<int> t(size_x);
 
-    Q.pop();
-  }
+    for (int y = y_begin; y < y_end; y++)
+    {
+      uint16_t* row = map->occ_dist + y * size_x;
+      for (int x = 0; x < size_x; x++)
+        g_sq[x] = (long long)row[x] * row[x];
+
+      // distance from x of the obstacles nearest to column i
+      auto f = [&](int x, int i) { return (long long)(x - i) * (x - i) + g_sq[i]; };
+      // first column for which the parabola of u is below the one of i (i < u)
+      auto sep = [&](int i, int u)
+      {
+        long long num = (long long)u * u - (long long)i * i + g_sq[u] - g_sq[i];
+        long long den = 2 * (u - i);
+        return (int)(num >= 0 ? num / den : -((-num + den - 1) / den));
+      };
+
+      // lower envelope of the parabolas
+      int q = 0;
+      s[0] = 0;
+      t[0] = 0;
+      for (int u = 1; u < size_x; u++)
+      {
+        while (q >= 0 && f(t[q], s[q]) > f(t[q], u))
+          q--;
+        if (q < 0)
+        {
+          q = 0;
+          s[0] = u;
+        }
+        else
+        {
+          int w = 1 + sep(s[q], u);
+          if (w < size_x)
+          {
+            q++;
+            s[q] = u;
+            t[q] = w;
+          }
+        }
+      }
 
-  delete[] marked;
+      for (int u = size_x - 1; u >= 0; u--)
+      {
+        long long d_sq = f(u, s[q]);
+        if (d_sq > radius_sq)
+          row[u] = MAP_OCC_DIST_LEVELS;
+        else
+          row[u] = map_quantize_occ_dist(map, sqrt((double)d_sq) * map->scale);
+        if (u == t[q])
+          q--;
+      }
+    }
+  });
 }
@@ -0,0 +1,38 @@
+/*
+ *   Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ *   All rights reserved.
+ *
+ *   This software may be modified and distributed under the terms of the
+ *   GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Helper used to split the precomputations on the map among the
+//       cores of the machine (C++ only)
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef MAP_PARALLEL_H
+#define MAP_PARALLEL_H
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Run fn(begin, end) on [0, count), split among the cores of the machine.
+// Each thread gets at least min_chunk items.
+inline void map_parallel_for(int count, int min_chunk, const std::function<void(int, int)>& fn)
+{
+  int thread_count = std::thread::hardware_concurrency();
+  thread_count = std::max(1, std::min(thread_count, count / min_chunk));
+  std::vector<std::thread> threads;
+  for (int t = 1; t < thread_count; t++)
+    threads.push_back(std::thread(fn, (int)((long long)count * t / thread_count),
+                                      (int)((long long)count * (t + 1) / thread_count)));
+  fn(0, (int)((long long)count / thread_count));
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+}
+
+#endif
@@ -86,12 +86,12 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
 
   if(steep)
   {
-    if(!MAP_VALID(map,y,x) || map->cells[MAP_INDEX(map,y,x)].occ_state > -1)
+    if(!MAP_VALID(map,y,x) || map->occ_state[MAP_INDEX(map,y,x)] > -1)
       return sqrt((x-x0)*(x-x0) + (y-y0)*(y-y0)) * map->scale;
   }
   else
   {
-    if(!MAP_VALID(map,x,y) || map->cells[MAP_INDEX(map,x,y)].occ_state > -1)
+    if(!MAP_VALID(map,x,y) || map->occ_state[MAP_INDEX(map,x,y)] > -1)
       return sqrt((x-x0)*(x-x0) + (y-y0)*(y-y0)) * map->scale;
   }
 
@@ -107,14 +107,37 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
 
     if(steep)
     {
-      if(!MAP_VALID(map,y,x) || map->cells[MAP_INDEX(map,y,x)].occ_state > -1)
+      if(!MAP_VALID(map,y,x) || map->occ_state[MAP_INDEX(map,y,x)] > -1)
         return sqrt((x-x0)*(x-x0) + (y-y0)*(y-y0)) * map->scale;
     }
     else
     {
-      if(!MAP_VALID(map,x,y) || map->cells[MAP_INDEX(map,x,y)].occ_state > -1)
+      if(!MAP_VALID(map,x,y) || map->occ_state[MAP_INDEX(map,x,y)] > -1)
         return sqrt((x-x0)*(x-x0) + (y-y0)*(y-y0)) * map->scale;
     }
   }
   return max_range;
 }
+
+// Read the expected range from the precomputed table. The angle is rounded to
+// the nearest direction of the table.
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range)
+{
+  int i, j, row, bin;
+  double range;
+
+  if (map->range_table == NULL || max_range > map->range_max)
+    return map_calc_range(map, ox, oy, oa, max_range);
+
+  i = MAP_GXWX(map, ox);
+  j = MAP_GYWY(map, oy);
+  if (!MAP_VALID(map, i, j) || (row = map->range_cell[MAP_INDEX(map, i, j)]) < 0)
+    return map_calc_range(map, ox, oy, oa, max_range);
+
+  bin = (int) floor(oa * map->range_angle_count / (2 * M_PI) + 0.5) % map->range_angle_count;
+  if (bin < 0)
+    bin += map->range_angle_count;
+
+  range = map->range_table[(size_t) row * map->range_angle_count + bin] * map->range_max / MAP_RANGE_LEVELS;
+  return range < max_range ? range : max_range;
+}
@@ -0,0 +1,218 @@
+/*
+ *   Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ *   All rights reserved.
+ *
+ *   This software may be modified and distributed under the terms of the
+ *   GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Table of the expected ranges, used by the beam model in place of
+//       ray casting
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "amcl/map/map.h"
+#include "amcl/map/map_parallel.h"
+
+// Header of the files written by map_save_range_table()
+struct map_range_file_header
+{
+  char magic[8];
+  int32_t size_x, size_y;
+  int32_t angle_count;
+  int32_t row_count;
+  double scale;
+  double origin_x, origin_y;
+  double max_range;
+  uint64_t occ_hash;
+};
+
+static const char map_range_file_magic[8] = {'A', 'M', 'C', 'L', 'R', 'N', 'G', '1'};
+
+// FNV-1a hash of the occupancy grid, to detect a table computed on another map
+static uint64_t map_occ_hash(map_t *map)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < map->size_x * map->size_y; i++)
+  {
+    hash ^= (uint8_t) map->occ_state[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Assign a row of the table to each free cell, in the order of the cells.
+// Returns the number of rows, -1 if the index cannot be allocated.
+static int map_index_range_cells(map_t *map)
+{
+  int row_count = 0;
+  size_t size = sizeof(int32_t) * (size_t) map->size_x * map->size_y;
+
+  free(map->range_cell);
+  map->range_cell = (int32_t*) malloc(size);
+  if (map->range_cell == NULL)
+  {
+    fprintf(stderr, "Unable to allocate the range table index (%zu bytes)\n", size);
+    return -1;
+  }
+  for (int i = 0; i < map->size_x * map->size_y; i++)
+    map->range_cell[i] = (map->occ_state[i] == -1) ? row_count++ : -1;
+  return row_count;
+}
+
+// Release the table
+static void map_clear_range_table(map_t *map)
+{
+  free(map->range_cell);
+  free(map->range_table);
+  map->range_cell = NULL;
+  map->range_table = NULL;
+  map->range_angle_count = 0;
+  map->range_max = 0;
+}
+
+// Precompute the ranges seen from the free cells. The rays are cast with
+// map_calc_range(), so the table gives the same results, apart from the
+// rounding of the angle and of the range.
+int map_update_range_table(map_t *map, double max_range, int angle_count, size_t max_size)
+{
+  map_clear_range_table(map);
+  if (angle_count < 1 || max_range <= 0)
+    return -1;
+
+  const int row_count = map_index_range_cells(map);
+  if (row_count < 0)
+  {
+    map_clear_range_table(map);
+    return -1;
+  }
+  const int cell_count = map->size_x * map->size_y;
+  size_t size = sizeof(uint16_t) * (size_t) row_count * angle_count;
+  // with overcommit malloc() rarely fails, and a table which does not fit
+  // in memory would only fail later, when its pages are written
+  if (max_size > 0 && size > max_size)
+  {
+    fprintf(stderr, "The range table (%zu bytes) exceeds the limit of %zu bytes\n", size, max_size);
+    map_clear_range_table(map);
+    return -1;
+  }
+  uint16_t* table = (uint16_t*) malloc(size);
+  if (table == NULL)
+  {
+    // without the table map_lookup_range() casts the rays with map_calc_range()
+    fprintf(stderr, "Unable to allocate the range table (%zu bytes)\n", size);
+    map_clear_range_table(map);
+    return -1;
+  }
+
+  map_parallel_for(cell_count, 1024, [&](int begin, int end)
+  {
+    for (int i = begin; i < end; i++)
+    {
+      int row = map->range_cell[i];
+      if (row < 0)
+        continue;
+      double ox = MAP_WXGX(map, i % map->size_x);
+      double oy = MAP_WYGY(map, i / map->size_x);
+      uint16_t* ranges = table + (size_t) row * angle_count;
+      for (int k = 0; k < angle_count; k++)
+      {
+        double range = map_calc_range(map, ox, oy, k * 2 * M_PI / angle_count, max_range);
+        double q = floor(range / max_range * MAP_RANGE_LEVELS + 0.5);
+        ranges[k] = (uint16_t) (q < MAP_RANGE_LEVELS ? q : MAP_RANGE_LEVELS);
+      }
+    }
+  });
+
+  map->range_table = table;
+  map->range_angle_count = angle_count;
+  map->range_max = max_range;
+  return 0;
+}
+
+// Store the range table
+int map_save_range_table(map_t *map, const char *filename)
+{
+  if (map->range_table == NULL)
+    return -1;
+
+  map_range_file_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, map_range_file_magic, sizeof(header.magic));
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.angle_count = map->range_angle_count;
+  header.row_count = 0;
+  for (int i = 0; i < map->size_x * map->size_y; i++)
+    if (map->range_cell[i] >= 0)
+      header.row_count++;
+  header.scale = map->scale;
+  header.origin_x = map->origin_x;
+  header.origin_y = map->origin_y;
+  header.max_range = map->range_max;
+  header.occ_hash = map_occ_hash(map);
+
+  FILE *file = fopen(filename, "wb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), filename);
+    return -1;
+  }
+  size_t entries = (size_t) header.row_count * header.angle_count;
+  int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+           fwrite(map->range_table, sizeof(uint16_t), entries, file) == entries;
+  fclose(file);
+  return ok ? 0 : -1;
+}
+
+// Load a range table stored by map_save_range_table()
+int map_load_range_table(map_t *map, const char *filename, double max_range, int angle_count, size_t max_size)
+{
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL)
+    return -1;
+
+  map_range_file_header header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, map_range_file_magic, sizeof(header.magic)) != 0 ||
+      header.size_x != map->size_x || header.size_y != map->size_y ||
+      header.scale != map->scale ||
+      header.origin_x != map->origin_x || header.origin_y != map->origin_y ||
+      header.angle_count != angle_count || header.max_range != max_range ||
+      header.occ_hash != map_occ_hash(map))
+  {
+    fclose(file);
+    return -1;
+  }
+  if (max_size > 0 && sizeof(uint16_t) * (size_t) header.row_count * angle_count > max_size)
+  {
+    fprintf(stderr, "The range table stored in %s exceeds the limit of %zu bytes\n", filename, max_size);
+    fclose(file);
+    return -1;
+  }
+
+  map_clear_range_table(map);
+  int row_count = map_index_range_cells(map);
+  size_t entries = (size_t) (row_count > 0 ? row_count : 0) * angle_count;
+  uint16_t* table = (row_count == header.row_count) ? (uint16_t*) malloc(sizeof(uint16_t) * entries) : NULL;
+  if (row_count != header.row_count || table == NULL ||
+      fread(table, sizeof(uint16_t), entries, file) != entries)
+  {
+    free(table);
+    map_clear_range_table(map);
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+
+  map->range_table = table;
+  map->range_angle_count = angle_count;
+  map->range_max = max_range;
+  return 0;
+}
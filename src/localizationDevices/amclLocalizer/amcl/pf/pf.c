@@ -39,17 +39,13 @@
 // with samples in them.
 static int pf_resample_limit(pf_t *pf, int k);
 
-#ifdef WIN32
-static double drand48()
-{
-    return (rand() / (RAND_MAX + 1.0));
-}
+// Build the tables of the alias method for the weights of a set
+static void pf_build_alias_table(pf_t *pf, pf_sample_set_t *set);
 
-static void srand48(long int seedval)
-{
-    srand(seedval);
-}
-#endif
+// Draw the index of a sample of the set, according to the selected resampler.
+// [m] is the number of samples drawn so far, [shift] the random offset of
+// the systematic resampler.
+static int pf_resample_draw(pf_t *pf, pf_sample_set_t *set, int m, double shift);
 
 // Create a new filter
 pf_t *pf_alloc(int min_samples, int max_samples,
@@ -61,15 +57,16 @@ pf_t *pf_alloc(int min_samples, int max_samples,
   pf_sample_set_t *set;
   pf_sample_t *sample;
   
-  srand48(time(NULL));
-
   pf = calloc(1, sizeof(pf_t));
 
+  pf_rng_seed(&pf->rng, time(NULL));
+
   pf->random_pose_fn = random_pose_fn;
   pf->random_pose_data = random_pose_data;
 
   pf->min_samples = min_samples;
   pf->max_samples = max_samples;
+  pf->sample_limit = max_samples;
 
   // Control parameters for the population size calculation.  [err] is
   // the max error between the true distribution and the estimated
@@ -79,6 +76,12 @@ pf_t *pf_alloc(int min_samples, int max_samples,
   pf->pop_err = 0.01;
   pf->pop_z = 3;
   pf->dist_threshold = 0.5; 
+
+  pf->resample_model = PF_RESAMPLE_MULTINOMIAL;
+  pf->cdf = calloc(max_samples + 1, sizeof(double));
+  pf->alias_prob = calloc(max_samples, sizeof(double));
+  pf->alias_index = calloc(max_samples, sizeof(int));
+  pf->alias_work = calloc(max_samples, sizeof(int));
   
   pf->current_set = 0;
   for (j = 0; j < 2; j++)
@@ -131,11 +134,31 @@ void pf_free(pf_t *pf)
     pf_kdtree_free(pf->sets[i].kdtree);
     free(pf->sets[i].samples);
   }
+  free(pf->cdf);
+  free(pf->alias_prob);
+  free(pf->alias_index);
+  free(pf->alias_work);
   free(pf);
   
   return;
 }
 
+// Set the maximum number of samples drawn by the resampler
+void pf_set_sample_limit(pf_t *pf, int sample_limit)
+{
+  if (sample_limit < pf->min_samples)
+    sample_limit = pf->min_samples;
+  if (sample_limit > pf->max_samples)
+    sample_limit = pf->max_samples;
+  pf->sample_limit = sample_limit;
+}
+
+// Seed the random number generator of the filter
+void pf_seed(pf_t *pf, uint64_t seed)
+{
+  pf_rng_seed(&pf->rng, seed);
+}
+
 // Initialize the filter using a guassian
 void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
 {
@@ -158,7 +181,7 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
   {
     sample = set->samples + i;
     sample->weight = 1.0 / pf->max_samples;
-    sample->pose = pf_pdf_gaussian_sample(pdf);
+    sample->pose = pf_pdf_gaussian_sample(pdf, &pf->rng);
 
     // Add sample to histogram
     pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
@@ -197,7 +220,7 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
   {
     sample = set->samples + i;
     sample->weight = 1.0 / pf->max_samples;
-    sample->pose = (*init_fn) (init_data);
+    sample->pose = (*init_fn) (init_data, &pf->rng);
 
     // Add sample to histogram
     pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
@@ -270,6 +293,25 @@ void pf_update_action(pf_t *pf, pf_action_model_fn_t action_fn, void *action_dat
 #include <float.h>
 // Update the filter with some new sensor observation
 void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_data)
+{
+  pf_sensor_begin(pf);
+  pf_sensor_weight(pf, sensor_fn, sensor_data);
+  pf_sensor_finish(pf);
+  return;
+}
+
+
+// Start an update with the observations of one or more sensors
+void pf_sensor_begin(pf_t *pf)
+{
+  pf->sensor_log_likelihood = 0.0;
+  pf->sensor_count = 0;
+  return;
+}
+
+
+// Multiply the weights by the likelihood of a sensor observation
+void pf_sensor_weight(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_data)
 {
   int i;
   pf_sample_set_t *set;
@@ -280,29 +322,19 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
 
   // Compute the sample weights
   total = (*sensor_fn) (sensor_data, set);
-  
+  pf->sensor_count++;
+
   if (total > 0.0)
   {
-    // Normalize weights
-    double w_avg=0.0;
+    // The weights are normalized after each sensor, so that the product of
+    // the likelihoods does not underflow: the result is the same as
+    // normalizing once.
     for (i = 0; i < set->sample_count; i++)
     {
       sample = set->samples + i;
-      w_avg += sample->weight;
       sample->weight /= total;
     }
-    // Update running averages of likelihood of samples (Prob Rob p258)
-    w_avg /= set->sample_count;
-    if(pf->w_slow == 0.0)
-      pf->w_slow = w_avg;
-    else
-      pf->w_slow += pf->alpha_slow * (w_avg - pf->w_slow);
-    if(pf->w_fast == 0.0)
-      pf->w_fast = w_avg;
-    else
-      pf->w_fast += pf->alpha_fast * (w_avg - pf->w_fast);
-    //printf("w_avg: %e slow: %e fast: %e\n", 
-           //w_avg, pf->w_slow, pf->w_fast);
+    pf->sensor_log_likelihood += log(total);
   }
   else
   {
@@ -312,24 +344,55 @@ void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_dat
       sample = set->samples + i;
       sample->weight = 1.0 / set->sample_count;
     }
+    pf->sensor_log_likelihood = -HUGE_VAL;
   }
 
   return;
 }
 
 
+// Finish the update started by pf_sensor_begin()
+void pf_sensor_finish(pf_t *pf)
+{
+  pf_sample_set_t *set;
+  double w_avg;
+
+  set = pf->sets + pf->current_set;
+
+  if (pf->sensor_count == 0 || pf->sensor_log_likelihood == -HUGE_VAL)
+    return;
+
+  // The weights summed to 1 before the update, so the average of the
+  // unnormalized weights is the total likelihood over the sample count.
+  // With several sensors the geometric mean of their likelihoods is used:
+  // the product would change by orders of magnitude whenever one of them
+  // is not fused (e.g. a late scan), and the drop of w_fast below w_slow
+  // would inject random particles.
+  // Update running averages of likelihood of samples (Prob Rob p258)
+  w_avg = exp(pf->sensor_log_likelihood / pf->sensor_count) / set->sample_count;
+  if(pf->w_slow == 0.0)
+    pf->w_slow = w_avg;
+  else
+    pf->w_slow += pf->alpha_slow * (w_avg - pf->w_slow);
+  if(pf->w_fast == 0.0)
+    pf->w_fast = w_avg;
+  else
+    pf->w_fast += pf->alpha_fast * (w_avg - pf->w_fast);
+  //printf("w_avg: %e slow: %e fast: %e\n",
+         //w_avg, pf->w_slow, pf->w_fast);
+
+  return;
+}
+
+
 // Resample the distribution
 void pf_update_resample(pf_t *pf)
 {
-  int i;
+  int i, m;
   double total;
   pf_sample_set_t *set_a, *set_b;
   pf_sample_t *sample_a, *sample_b;
-
-  //double r,c,U;
-  //int m;
-  //double count_inv;
-  double* c;
+  double shift;
 
   double w_diff;
 
@@ -337,12 +400,15 @@ void pf_update_resample(pf_t *pf)
   set_b = pf->sets + (pf->current_set + 1) % 2;
 
   // Build up cumulative probability table for resampling.
-  // TODO: Replace this with a more efficient procedure
-  // (e.g., http://www.network-theory.co.uk/docs/gslref/GeneralDiscreteDistributions.html)
-  c = (double*)malloc(sizeof(double)*(set_a->sample_count+1));
-  c[0] = 0.0;
+  pf->cdf[0] = 0.0;
   for(i=0;i<set_a->sample_count;i++)
-    c[i+1] = c[i]+set_a->samples[i].weight;
+    pf->cdf[i+1] = pf->cdf[i]+set_a->samples[i].weight;
+
+  shift = 0.0;
+  if(pf->resample_model == PF_RESAMPLE_ALIAS)
+    pf_build_alias_table(pf, set_a);
+  else if(pf->resample_model == PF_RESAMPLE_SYSTEMATIC)
+    shift = pf_rng_uniform(&pf->rng);
 
   // Create the kd tree for adaptive sampling
   pf_kdtree_clear(set_b->kdtree);
@@ -350,63 +416,22 @@ void pf_update_resample(pf_t *pf)
   // Draw samples from set a to create set b.
   total = 0;
   set_b->sample_count = 0;
+  m = 0;
 
   w_diff = 1.0 - pf->w_fast / pf->w_slow;
   if(w_diff < 0.0)
     w_diff = 0.0;
   //printf("w_diff: %9.6f\n", w_diff);
 
-  // Can't (easily) combine low-variance sampler with KLD adaptive
-  // sampling, so we'll take the more traditional route.
-  /*
-  // Low-variance resampler, taken from Probabilistic Robotics, p110
-  count_inv = 1.0/set_a->sample_count;
-  r = drand48() * count_inv;
-  c = set_a->samples[0].weight;
-  i = 0;
-  m = 0;
-  */
-  while(set_b->sample_count < pf->max_samples)
+  while(set_b->sample_count < pf->sample_limit)
   {
     sample_b = set_b->samples + set_b->sample_count++;
 
-    if(drand48() < w_diff)
-      sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data);
+    if(pf_rng_uniform(&pf->rng) < w_diff)
+      sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data, &pf->rng);
     else
     {
-      // Can't (easily) combine low-variance sampler with KLD adaptive
-      // sampling, so we'll take the more traditional route.
-      /*
-      // Low-variance resampler, taken from Probabilistic Robotics, p110
-      U = r + m * count_inv;
-      while(U>c)
-      {
-        i++;
-        // Handle wrap-around by resetting counters and picking a new random
-        // number
-        if(i >= set_a->sample_count)
-        {
-          r = drand48() * count_inv;
-          c = set_a->samples[0].weight;
-          i = 0;
-          m = 0;
-          U = r + m * count_inv;
-          continue;
-        }
-        c += set_a->samples[i].weight;
-      }
-      m++;
-      */
-
-      // Naive discrete event sampler
-      double r;
-      r = drand48();
-      for(i=0;i<set_a->sample_count;i++)
-      {
-        if((c[i] <= r) && (r < c[i+1]))
-          break;
-      }
-      assert(i<set_a->sample_count);
+      i = pf_resample_draw(pf, set_a, m++, shift);
 
       sample_a = set_a->samples + i;
 
@@ -448,11 +473,117 @@ void pf_update_resample(pf_t *pf)
 
   pf_update_converged(pf);
 
-  free(c);
   return;
 }
 
 
+// Van der Corput sequence in base 2: the bits of m mirrored around the point
+static double pf_radical_inverse(unsigned int m)
+{
+  m = (m << 16) | (m >> 16);
+  m = ((m & 0x00ff00ffu) << 8) | ((m & 0xff00ff00u) >> 8);
+  m = ((m & 0x0f0f0f0fu) << 4) | ((m & 0xf0f0f0f0u) >> 4);
+  m = ((m & 0x33333333u) << 2) | ((m & 0xccccccccu) >> 2);
+  m = ((m & 0x55555555u) << 1) | ((m & 0xaaaaaaaau) >> 1);
+  return m * (1.0 / 4294967296.0);
+}
+
+
+// Build the tables of the alias method (Vose's algorithm). Each of the N
+// columns has probability 1/N and holds the column's own sample with
+// probability alias_prob, its alias otherwise.
+void pf_build_alias_table(pf_t *pf, pf_sample_set_t *set)
+{
+  int i, s, l;
+  int n = set->sample_count;
+  double total = pf->cdf[n];
+  double *prob = pf->alias_prob;
+  int *alias = pf->alias_index;
+  int *work = pf->alias_work;
+
+  // the columns below the average are stacked at the start of the
+  // workspace, the ones above at the end
+  int small = 0;
+  int large = n;
+
+  for (i = 0; i < n; i++)
+  {
+    prob[i] = set->samples[i].weight * n / total;
+    if (prob[i] < 1.0)
+      work[small++] = i;
+    else
+      work[--large] = i;
+  }
+
+  while (small > 0 && large < n)
+  {
+    s = work[--small];
+    l = work[large];
+    alias[s] = l;
+    prob[l] -= 1.0 - prob[s];
+    if (prob[l] < 1.0)
+    {
+      large++;
+      work[small++] = l;
+    }
+  }
+
+  // what is left is (numerically) full
+  for (; large < n; large++)
+  {
+    prob[work[large]] = 1.0;
+    alias[work[large]] = work[large];
+  }
+  while (small > 0)
+  {
+    small--;
+    prob[work[small]] = 1.0;
+    alias[work[small]] = work[small];
+  }
+}
+
+
+// Draw the index of a sample of the set
+int pf_resample_draw(pf_t *pf, pf_sample_set_t *set, int m, double shift)
+{
+  int lo, hi, mid, i;
+  double r;
+
+  if (pf->resample_model == PF_RESAMPLE_ALIAS)
+  {
+    // the integer part selects the column, the fractional part tosses its coin
+    r = pf_rng_uniform(&pf->rng) * set->sample_count;
+    i = (int) r;
+    if (i >= set->sample_count)
+      i = set->sample_count - 1;
+    return (r - i < pf->alias_prob[i]) ? i : pf->alias_index[i];
+  }
+
+  if (pf->resample_model == PF_RESAMPLE_SYSTEMATIC)
+  {
+    r = shift + pf_radical_inverse(m);
+    if (r >= 1.0)
+      r -= 1.0;
+  }
+  else
+    r = pf_rng_uniform(&pf->rng);
+
+  // Binary search of the sample i such that cdf[i] <= r < cdf[i+1]
+  r *= pf->cdf[set->sample_count];
+  lo = 0;
+  hi = set->sample_count;
+  while (hi - lo > 1)
+  {
+    mid = (lo + hi) / 2;
+    if (pf->cdf[mid] <= r)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+
 // Compute the required number of samples, given that there are k bins
 // with samples in them.  This is taken directly from Fox et al.
 int pf_resample_limit(pf_t *pf, int k)
@@ -461,7 +592,7 @@ int pf_resample_limit(pf_t *pf, int k)
   int n;
 
   if (k <= 1)
-    return pf->max_samples;
+    return pf->sample_limit;
 
   a = 1;
   b = 2 / (9 * ((double) k - 1));
@@ -472,8 +603,8 @@ int pf_resample_limit(pf_t *pf, int k)
 
   if (n < pf->min_samples)
     return pf->min_samples;
-  if (n > pf->max_samples)
-    return pf->max_samples;
+  if (n > pf->sample_limit)
+    return pf->sample_limit;
   
   return n;
 }
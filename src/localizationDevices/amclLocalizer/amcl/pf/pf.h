@@ -30,6 +30,7 @@
 
 #include "pf_vector.h"
 #include "pf_kdtree.h"
+#include "pf_pdf.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,8 +42,8 @@ struct _rtk_fig_t;
 struct _pf_sample_set_t;
 
 // Function prototype for the initialization model; generates a sample pose from
-// an appropriate distribution.
-typedef pf_vector_t (*pf_init_model_fn_t) (void *init_data);
+// an appropriate distribution, drawing from the random generator of the filter.
+typedef pf_vector_t (*pf_init_model_fn_t) (void *init_data, pf_rng_t *rng);
 
 // Function prototype for the action model; generates a sample pose from
 // an appropriate distribution
@@ -55,6 +56,22 @@ typedef double (*pf_sensor_model_fn_t) (void *sensor_data,
                                         struct _pf_sample_set_t* set);
 
 
+// Algorithm used to draw the samples of the new set during resampling
+typedef enum
+{
+  // Independent draws, each one located with a binary search over the
+  // cumulative weights: O(log N) per sample
+  PF_RESAMPLE_MULTINOMIAL,
+  // Independent draws with the alias method (Walker, Vose): O(N) to build the
+  // tables, then O(1) per sample
+  PF_RESAMPLE_ALIAS,
+  // Low variance sampler: the draws are a randomly shifted van der Corput
+  // sequence, so that any prefix of them is evenly spread over the cumulative
+  // weights, also when the KLD criterion stops the resampling early
+  PF_RESAMPLE_SYSTEMATIC
+} pf_resample_model_t;
+
+
 // Information for a single sample
 typedef struct
 {
@@ -113,6 +130,10 @@ typedef struct _pf_t
   // This min and max number of samples
   int min_samples, max_samples;
 
+  // Upper bound of the number of samples drawn by the resampler, between
+  // min_samples and max_samples. It can be lowered to save computation.
+  int sample_limit;
+
   // Population size parameters
   double pop_err, pop_z;
   
@@ -127,12 +148,31 @@ typedef struct _pf_t
   // Decay rates for running averages
   double alpha_slow, alpha_fast;
 
+  // Observations fused since pf_sensor_begin(): sum of the logs of the total
+  // weights given by the sensor models (-HUGE_VAL if one of them gave no
+  // weight), and number of fused observations
+  double sensor_log_likelihood;
+  int sensor_count;
+
   // Function used to draw random pose samples
   pf_init_model_fn_t random_pose_fn;
   void *random_pose_data;
 
   double dist_threshold; //distance threshold in each axis over which the pf is considered to not be converged
   int converged; 
+
+  // Resampling algorithm
+  pf_resample_model_t resample_model;
+
+  // Resampling workspace, allocated once for max_samples: cumulative weights
+  // (max_samples + 1 entries) and the tables of the alias method
+  double *cdf;
+  double *alias_prob;
+  int *alias_index;
+  int *alias_work;
+
+  // Random number generator used by the filter and by its models
+  pf_rng_t rng;
 } pf_t;
 
 
@@ -144,6 +184,14 @@ pf_t *pf_alloc(int min_samples, int max_samples,
 // Free an existing filter
 void pf_free(pf_t *pf);
 
+// Set the maximum number of samples drawn by the resampler; the value is
+// clamped to [min_samples, max_samples].
+void pf_set_sample_limit(pf_t *pf, int sample_limit);
+
+// Seed the random number generator of the filter, to reproduce a run.
+// pf_alloc() seeds it with the current time.
+void pf_seed(pf_t *pf, uint64_t seed);
+
 // Initialize the filter using a guassian
 void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov);
 
@@ -156,6 +204,16 @@ void pf_update_action(pf_t *pf, pf_action_model_fn_t action_fn, void *action_dat
 // Update the filter with some new sensor observation
 void pf_update_sensor(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_data);
 
+// Update the filter with the observations of several sensors: the weights
+// given by each pf_sensor_weight() multiply the ones of the previous calls,
+// and pf_sensor_finish() updates the running averages of the likelihood once
+// for all of them, with the geometric mean of the likelihoods of the sensors
+// (so that the averages do not jump when a sensor is missing from an update).
+// pf_update_sensor() does the same for a single sensor.
+void pf_sensor_begin(pf_t *pf);
+void pf_sensor_weight(pf_t *pf, pf_sensor_model_fn_t sensor_fn, void *sensor_data);
+void pf_sensor_finish(pf_t *pf);
+
 // Resample the distribution
 void pf_update_resample(pf_t *pf);
 
@@ -78,6 +78,7 @@ pf_kdtree_t *pf_kdtree_alloc(int max_size)
   self->node_count = 0;
   self->node_max_count = max_size;
   self->nodes = calloc(self->node_max_count, sizeof(pf_kdtree_node_t));
+  self->queue = calloc(self->node_max_count, sizeof(self->queue[0]));
 
   self->leaf_count = 0;
 
@@ -89,6 +90,7 @@ pf_kdtree_t *pf_kdtree_alloc(int max_size)
 // Destroy a tree
 void pf_kdtree_free(pf_kdtree_t *self)
 {
+  free(self->queue);
   free(self->nodes);
   free(self);
   return;
@@ -362,7 +364,7 @@ void pf_kdtree_cluster(pf_kdtree_t *self)
   pf_kdtree_node_t **queue, *node;
 
   queue_count = 0;
-  queue = calloc(self->node_count, sizeof(queue[0]));
+  queue = self->queue;
 
   // Put all the leaves in a queue
   for (i = 0; i < self->node_count; i++)
@@ -397,7 +399,6 @@ void pf_kdtree_cluster(pf_kdtree_t *self)
     pf_kdtree_cluster_node(self, node, 0);
   }
 
-  free(queue);
   return;
 }
 
@@ -77,6 +77,9 @@ typedef struct
   // The number of leaf nodes in the tree
   int leaf_count;
 
+  // Work queue used by pf_kdtree_cluster(), allocated with the nodes
+  pf_kdtree_node_t **queue;
+
 } pf_kdtree_t;
 
 
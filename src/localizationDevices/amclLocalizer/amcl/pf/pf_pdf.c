@@ -34,20 +34,48 @@
 
 #include "amcl/pf/pf_pdf.h"
 
-// Random number generator seed value
-static unsigned int pf_pdf_seed;
+/**************************************************************************
+ * Random numbers
+ *************************************************************************/
+
+static uint64_t pf_rng_rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
 
-#ifdef WIN32
-static double drand48()
+// Initialize the generator from a seed. The state is filled with splitmix64,
+// as recommended by the authors of xoshiro.
+void pf_rng_seed(pf_rng_t *rng, uint64_t seed)
 {
-    return (rand() / (RAND_MAX + 1.0));
+  int i;
+  uint64_t z;
+
+  for (i = 0; i < 4; i++)
+  {
+    seed += 0x9e3779b97f4a7c15ULL;
+    z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    rng->s[i] = z ^ (z >> 31);
+  }
 }
 
-static void srand48(long int seedval)
+// Draw uniformly from [0, 1), using the 53 most significant bits
+double pf_rng_uniform(pf_rng_t *rng)
 {
-    srand(seedval);
+  uint64_t *s = rng->s;
+  uint64_t result = pf_rng_rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = pf_rng_rotl(s[3], 45);
+
+  return (result >> 11) * (1.0 / 9007199254740992.0);
 }
-#endif
 
 /**************************************************************************
  * Gaussian
@@ -72,12 +100,6 @@ pf_pdf_gaussian_t *pf_pdf_gaussian_alloc(pf_vector_t x, pf_matrix_t cx)
   pdf->cd.v[1] = sqrt(cd.m[1][1]);
   pdf->cd.v[2] = sqrt(cd.m[2][2]);
 
-  // Initialize the random number generator
-  //pdf->rng = gsl_rng_alloc(gsl_rng_taus);
-  //gsl_rng_set(pdf->rng, ++pf_pdf_seed);
-
-  srand48(++pf_pdf_seed);
-  
   return pdf;
 }
 
@@ -114,7 +136,7 @@ double pf_pdf_gaussian_value(pf_pdf_gaussian_t *pdf, pf_vector_t x)
 
 
 // Generate a sample from the pdf.
-pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
+pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf, pf_rng_t *rng)
 {
   int i, j;
   pf_vector_t r;
@@ -124,7 +146,7 @@ pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
   for (i = 0; i < 3; i++)
   {
     //r.v[i] = gsl_ran_gaussian(pdf->rng, pdf->cd.v[i]);
-    r.v[i] = pf_ran_gaussian(pdf->cd.v[i]);
+    r.v[i] = pf_ran_gaussian(rng, pdf->cd.v[i]);
   }
 
   for (i = 0; i < 3; i++)
@@ -141,15 +163,15 @@ pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
 // deviation sigma.
 // We use the polar form of the Box-Muller transformation, explained here:
 //   http://www.taygeta.com/random/gaussian.html
-double pf_ran_gaussian(double sigma)
+double pf_ran_gaussian(pf_rng_t *rng, double sigma)
 {
   double x1, x2, w, r;
 
   do
   {
-    do { r = drand48(); } while (r==0.0);
+    do { r = pf_rng_uniform(rng); } while (r==0.0);
     x1 = 2.0 * r - 1.0;
-    do { r = drand48(); } while (r==0.0);
+    do { r = pf_rng_uniform(rng); } while (r==0.0);
     x2 = 2.0 * r - 1.0;
     w = x1*x1 + x2*x2;
   } while(w > 1.0 || w==0.0);
@@ -28,6 +28,8 @@
 #ifndef PF_PDF_H
 #define PF_PDF_H
 
+#include <stdint.h>
+
 #include "pf_vector.h"
 
 //#include <gsl/gsl_rng.h>
@@ -37,6 +39,25 @@
 extern "C" {
 #endif
 
+/**************************************************************************
+ * Random numbers
+ *************************************************************************/
+
+// State of a pseudo random number generator (xoshiro256**, Blackman and
+// Vigna). It is small and fast, and every filter owns one, so that a
+// sequence of samples can be reproduced by seeding it.
+typedef struct
+{
+  uint64_t s[4];
+} pf_rng_t;
+
+// Initialize the generator from a seed
+void pf_rng_seed(pf_rng_t *rng, uint64_t seed);
+
+// Draw uniformly from [0, 1)
+double pf_rng_uniform(pf_rng_t *rng);
+
+
 /**************************************************************************
  * Gaussian
  *************************************************************************/
@@ -73,10 +94,10 @@ void pf_pdf_gaussian_free(pf_pdf_gaussian_t *pdf);
 // deviation sigma.
 // We use the polar form of the Box-Muller transformation, explained here:
 //   http://www.taygeta.com/random/gaussian.html
-double pf_ran_gaussian(double sigma);
+double pf_ran_gaussian(pf_rng_t *rng, double sigma);
 
 // Generate a sample from the pdf.
-pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf);
+pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf, pf_rng_t *rng);
 
 #ifdef __cplusplus
 }
@@ -31,6 +31,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <algorithm>
 
 #include "amcl/sensors/amcl_laser.h"
 
@@ -40,7 +41,7 @@ using namespace amcl;
 // Default constructor
 AMCLLaser::AMCLLaser(size_t max_beams, map_t* map) : AMCLSensor(), 
 						     max_samples(0), max_obs(0), 
-						     temp_obs(NULL)
+						     beamskip_error(false)
 {
   this->time = 0.0;
 
@@ -52,12 +53,6 @@ AMCLLaser::AMCLLaser(size_t max_beams, map_t* map) : AMCLSensor(),
 
 AMCLLaser::~AMCLLaser()
 {
-  if(temp_obs){
-	for(int k=0; k < max_samples; k++){
-	  delete [] temp_obs[k];
-	}
-	delete []temp_obs; 
-  }
 }
 
 void 
@@ -90,7 +85,10 @@ AMCLLaser::SetModelLikelihoodField(double z_hit,
   this->z_rand = z_rand;
   this->sigma_hit = sigma_hit;
 
-  map_update_cspace(this->map, max_occ_dist);
+  // the distances may have been already computed for another laser on the same map
+  if (this->map->occ_dist == NULL || this->map->max_occ_dist != max_occ_dist)
+    map_update_cspace(this->map, max_occ_dist);
+  UpdateLikelihoodField();
 }
 
 void 
@@ -111,7 +109,10 @@ AMCLLaser::SetModelLikelihoodFieldProb(double z_hit,
   this->beam_skip_distance = beam_skip_distance;
   this->beam_skip_threshold = beam_skip_threshold;
   this->beam_skip_error_threshold = beam_skip_error_threshold;
-  map_update_cspace(this->map, max_occ_dist);
+  // the distances may have been already computed for another laser on the same map
+  if (this->map->occ_dist == NULL || this->map->max_occ_dist != max_occ_dist)
+    map_update_cspace(this->map, max_occ_dist);
+  UpdateLikelihoodField();
 }
 
 
@@ -123,22 +124,84 @@ bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
     return false;
 
   // Apply the laser sensor model
+  pf_update_sensor(pf, SensorModel(), data);
+
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Apply the laser sensor model as part of a fused update
+bool AMCLLaser::WeightSensor(pf_t *pf, AMCLSensorData *data)
+{
+  if (this->max_beams < 2)
+    return false;
+
+  pf_sensor_weight(pf, SensorModel(), data);
+
+  return true;
+}
+
+
+pf_sensor_model_fn_t AMCLLaser::SensorModel() const
+{
   if(this->model_type == LASER_MODEL_BEAM)
-    pf_update_sensor(pf, (pf_sensor_model_fn_t) BeamModel, data);
+    return (pf_sensor_model_fn_t) BeamModel;
   else if(this->model_type == LASER_MODEL_LIKELIHOOD_FIELD)
-    pf_update_sensor(pf, (pf_sensor_model_fn_t) LikelihoodFieldModel, data);  
+    return (pf_sensor_model_fn_t) LikelihoodFieldModel;
   else if(this->model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
-    pf_update_sensor(pf, (pf_sensor_model_fn_t) LikelihoodFieldModelProb, data);  
+    return (pf_sensor_model_fn_t) LikelihoodFieldModelProb;
   else
-    pf_update_sensor(pf, (pf_sensor_model_fn_t) BeamModel, data);
+    return (pf_sensor_model_fn_t) BeamModel;
+}
 
-  return true;
+
+////////////////////////////////////////////////////////////////////////////////
+// Split the computation of the weights among the threads of the pool
+double AMCLLaser::ComputeWeights(AMCLLaserData *data, pf_sample_set_t* set,
+                                 range_model_fn_t range_fn)
+{
+  // Below this number of particles per thread, the synchronization costs more
+  // than the computation of the weights
+  const int min_samples_per_thread = 128;
+
+  int thread_count = this->pool ? this->pool->GetThreadCount() : 1;
+  if (thread_count < 2 || set->sample_count < 2 * min_samples_per_thread)
+    return range_fn(data, set, 0, 0, set->sample_count);
+
+  // The lambda captures a single pointer, so that it fits in the small buffer
+  // of std::function and no memory is allocated on each update
+  struct
+  {
+    AMCLLaser *self;
+    AMCLLaserData *data;
+    pf_sample_set_t *set;
+    range_model_fn_t range_fn;
+  } job = {this, data, set, range_fn};
+
+  this->partial_weights.assign(thread_count, 0.0);
+  this->pool->ParallelFor(set->sample_count, [&job](int thread_index, int begin, int end)
+  {
+    job.self->partial_weights[thread_index] = job.range_fn(job.data, job.set, thread_index, begin, end);
+  });
+
+  double total_weight = 0.0;
+  for (int t = 0; t < thread_count; t++)
+    total_weight += this->partial_weights[t];
+  return(total_weight);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // Determine the probability for the given pose
 double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
+{
+  AMCLLaser *self = (AMCLLaser*) data->sensor;
+  return self->ComputeWeights(data, set, BeamModelRange);
+}
+
+double AMCLLaser::BeamModelRange(AMCLLaserData *data, pf_sample_set_t* set,
+                                 int /*thread_index*/, int begin, int end)
 {
   AMCLLaser *self;
   int i, j, step;
@@ -155,7 +218,7 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
   total_weight = 0.0;
 
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  for (j = begin; j < end; j++)
   {
     sample = set->samples + j;
     pose = sample->pose;
@@ -171,9 +234,10 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
       obs_range = data->ranges[i][0];
       obs_bearing = data->ranges[i][1];
 
-      // Compute the range according to the map
-      map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
-                                 pose.v[2] + obs_bearing, data->range_max);
+      // Compute the range according to the map (from the range table, if
+      // it has been computed)
+      map_range = map_lookup_range(self->map, pose.v[0], pose.v[1],
+                                   pose.v[2] + obs_bearing, data->range_max);
       pz = 0.0;
 
       // Part 1: good, but noisy, hit
@@ -210,23 +274,44 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
 }
 
 double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set)
+{
+  AMCLLaser *self = (AMCLLaser*) data->sensor;
+
+  int step = (data->range_count - 1) / (self->max_beams - 1);
+
+  // Step size must be at least 1
+  if(step < 1)
+    step = 1;
+
+  self->PrepareBeams(data, step);
+  return self->ComputeWeights(data, set, LikelihoodFieldModelRange);
+}
+
+double AMCLLaser::LikelihoodFieldModelRange(AMCLLaserData *data, pf_sample_set_t* set,
+                                            int thread_index, int begin, int end)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, pz;
+  int j, k;
+  double pz;
   double p;
-  double obs_range, obs_bearing;
   double total_weight;
   pf_sample_t *sample;
   pf_vector_t pose;
-  pf_vector_t hit;
 
   self = (AMCLLaser*) data->sensor;
 
   total_weight = 0.0;
 
+  // Pre-compute a couple of things
+  const double z_hit = self->z_hit;
+  const double z_rand_term = self->z_rand * (1.0/data->range_max);
+  const float* table = self->likelihood_table.data();
+  const uint16_t* occ_dist = self->map->occ_dist;
+  const int beam_count = (int) self->beam_x.size();
+  int* cells = self->beam_cells.data() + thread_index * beam_count;
+
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  for (j = begin; j < end; j++)
   {
     sample = set->samples + j;
     pose = sample->pose;
@@ -234,53 +319,19 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose, pose);
 
-    p = 1.0;
-
-    // Pre-compute a couple of things
-    double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
-    double z_rand_mult = 1.0/data->range_max;
-
-    step = (data->range_count - 1) / (self->max_beams - 1);
+    // Part 1: Get distance from the hit to closest obstacle.
+    // Off-map penalized as max distance
+    self->ProjectBeams(pose, cells);
 
-    // Step size must be at least 1
-    if(step < 1)
-      step = 1;
+    p = 1.0;
 
-    for (i = 0; i < data->range_count; i += step)
+    for (k = 0; k < beam_count; k++)
     {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
-
-      // This model ignores max range readings
-      if(obs_range >= data->range_max)
-        continue;
-
-      // Check for NaN
-      if(obs_range != obs_range)
-        continue;
-
-      pz = 0.0;
-
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
-
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map, hit.v[0]);
-      mj = MAP_GYWY(self->map, hit.v[1]);
-      
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-      if(!MAP_VALID(self->map, mi, mj))
-        z = self->map->max_occ_dist;
-      else
-        z = self->map->cells[MAP_INDEX(self->map,mi,mj)].occ_dist;
       // Gaussian model
       // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      pz += self->z_hit * exp(-(z * z) / z_hit_denom);
+      pz = z_hit * table[occ_dist[cells[k]]];
       // Part 2: random measurements
-      pz += self->z_rand * z_rand_mult;
+      pz += z_rand_term;
 
       // TODO: outlier rejection for short readings
 
@@ -302,37 +353,16 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
 double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t* set)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, pz;
-  double log_p;
-  double obs_range, obs_bearing;
+  int beam_ind;
   double total_weight;
-  pf_sample_t *sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
-
-  step = ceil((data->range_count) / static_cast<double>(self->max_beams)); 
-  
-  // Step size must be at least 1
-  if(step < 1)
-    step = 1;
-
-  // Pre-compute a couple of things
-  double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
-  double z_rand_mult = 1.0/data->range_max;
-
-  double max_dist_prob = exp(-(self->map->max_occ_dist * self->map->max_occ_dist) / z_hit_denom);
-
   //Beam skipping - ignores beams for which a majoirty of particles do not agree with the map
   //prevents correct particles from getting down weighted because of unexpected obstacles 
   //such as humans 
 
   bool do_beamskip = self->do_beamskip;
-  double beam_skip_distance = self->beam_skip_distance;
   double beam_skip_threshold = self->beam_skip_threshold;
   
   //we only do beam skipping if the filter has converged 
@@ -340,13 +370,13 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
     do_beamskip = false;
   }
 
-  //we need a count the no of particles for which the beam agreed with the map 
-  int *obs_count = new int[self->max_beams]();
+  //we need a count the no of particles for which the beam agreed with the map.
+  //Each thread has its own row of counters, which are summed afterwards.
+  int thread_count = self->pool ? self->pool->GetThreadCount() : 1;
+  self->obs_count.assign(thread_count * self->max_beams, 0);
 
   //we also need a mask of which observations to integrate (to decide which beams to integrate to all particles) 
-  bool *obs_mask = new bool[self->max_beams]();
-  
-  int beam_ind = 0;
+  self->obs_mask.assign(self->max_beams, 0);
   
   //realloc indicates if we need to reallocate the temp data structure needed to do beamskipping 
   bool realloc = false; 
@@ -366,8 +396,87 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
     }
   }
 
+  int step = ceil((data->range_count) / static_cast<double>(self->max_beams)); 
+  
+  // Step size must be at least 1
+  if(step < 1)
+    step = 1;
+
+  self->PrepareBeams(data, step);
+
+  // Compute the sample weights (if no beam skipping is done) or the
+  // probabilities of the single beams
+  total_weight = self->ComputeWeights(data, set, LikelihoodFieldModelProbRange);
+  
+  if(do_beamskip){
+    // reduce the counters of the threads into the first row
+    for (int t = 1; t < thread_count; t++){
+      const int *row = self->obs_count.data() + t * self->max_beams;
+      for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
+        self->obs_count[beam_ind] += row[beam_ind];
+      }
+    }
+
+    int skipped_beam_count = 0; 
+    for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
+      if((self->obs_count[beam_ind] / static_cast<double>(set->sample_count)) > beam_skip_threshold){
+	self->obs_mask[beam_ind] = true;
+      }
+      else{
+	self->obs_mask[beam_ind] = false;
+	skipped_beam_count++; 
+      }
+    }
+
+    //we check if there is at least a critical number of beams that agreed with the map 
+    //otherwise it probably indicates that the filter converged to a wrong solution
+    //if that's the case we integrate all the beams and hope the filter might converge to 
+    //the right solution
+    self->beamskip_error = false; 
+
+    if(skipped_beam_count >= (beam_ind * self->beam_skip_error_threshold)){
+      fprintf(stderr, "Over %f%% of the observations were not in the map - pf may have converged to wrong pose - integrating all observations\n", (100 * self->beam_skip_error_threshold));
+      self->beamskip_error = true; 
+    }
+
+    total_weight = self->ComputeWeights(data, set, BeamSkipIntegrateRange);
+  }
+
+  return(total_weight);
+}
+
+double AMCLLaser::LikelihoodFieldModelProbRange(AMCLLaserData *data, pf_sample_set_t* set,
+                                                int thread_index, int begin, int end)
+{
+  AMCLLaser *self;
+  int j, k;
+  double pz;
+  double log_p;
+  double total_weight;
+  pf_sample_t *sample;
+  pf_vector_t pose;
+
+  self = (AMCLLaser*) data->sensor;
+
+  total_weight = 0.0;
+
+  // Pre-compute a couple of things
+  const double z_hit = self->z_hit;
+  const double z_rand_term = self->z_rand * (1.0/data->range_max);
+  const float* table = self->likelihood_table.data();
+  const uint16_t* occ_dist = self->map->occ_dist;
+  const int beam_count = (int) self->beam_x.size();
+  const int off_map = self->map->size_x * self->map->size_y;
+  int* cells = self->beam_cells.data() + thread_index * beam_count;
+
+  bool do_beamskip = self->do_beamskip && set->converged;
+  double beam_skip_distance = self->beam_skip_distance;
+
+  // the counters of this thread
+  int *obs_count = self->obs_count.data() + thread_index * self->max_beams;
+
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  for (j = begin; j < end; j++)
   {
     sample = set->samples + j;
     pose = sample->pose;
@@ -375,133 +484,177 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
     // Take account of the laser pose relative to the robot
     pose = pf_vector_coord_add(self->laser_pose, pose);
 
+    // Part 1: Get distance from the hit to closest obstacle.
+    // Off-map penalized as max distance
+    self->ProjectBeams(pose, cells);
+
     log_p = 0;
-    
-    beam_ind = 0;
-    
-    for (i = 0; i < data->range_count; i += step, beam_ind++)
-    {
-      obs_range = data->ranges[i][0];
-      obs_bearing = data->ranges[i][1];
 
-      // This model ignores max range readings
-      if(obs_range >= data->range_max){
-        continue;
-      }
+    if(!do_beamskip){
+      for (k = 0; k < beam_count; k++)
+      {
+        // Gaussian model
+        // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
+        pz = z_hit * table[occ_dist[cells[k]]];
+        // Part 2: random measurements
+        pz += z_rand_term;
 
-      // Check for NaN
-      if(obs_range != obs_range){
-        continue;
-      }
+        assert(pz <= 1.0);
+        assert(pz >= 0.0);
 
-      pz = 0.0;
+        // TODO: outlier rejection for short readings
 
-      // Compute the endpoint of the beam
-      hit.v[0] = pose.v[0] + obs_range * cos(pose.v[2] + obs_bearing);
-      hit.v[1] = pose.v[1] + obs_range * sin(pose.v[2] + obs_bearing);
-
-      // Convert to map grid coords.
-      int mi, mj;
-      mi = MAP_GXWX(self->map, hit.v[0]);
-      mj = MAP_GYWY(self->map, hit.v[1]);
-      
-      // Part 1: Get distance from the hit to closest obstacle.
-      // Off-map penalized as max distance
-      
-      if(!MAP_VALID(self->map, mi, mj)){
-	pz += self->z_hit * max_dist_prob;
-      }
-      else{
-	z = self->map->cells[MAP_INDEX(self->map,mi,mj)].occ_dist;
-	if(z < beam_skip_distance){
-	  obs_count[beam_ind] += 1;
-	}
-	pz += self->z_hit * exp(-(z * z) / z_hit_denom);
+        log_p += log(pz);
       }
-       
-      // Gaussian model
-      // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      
-      // Part 2: random measurements
-      pz += self->z_rand * z_rand_mult;
+      sample->weight *= exp(log_p);
+      total_weight += sample->weight;
+    }
+    else{
+      for (k = 0; k < beam_count; k++)
+      {
+        int beam_ind = self->beam_index[k];
+        if(cells[k] != off_map && MAP_OCC_DIST(self->map, occ_dist[cells[k]]) < beam_skip_distance){
+          obs_count[beam_ind] += 1;
+        }
+        pz = z_hit * table[occ_dist[cells[k]]] + z_rand_term;
 
-      assert(pz <= 1.0); 
-      assert(pz >= 0.0);
+        assert(pz <= 1.0);
+        assert(pz >= 0.0);
 
-      // TODO: outlier rejection for short readings
-            
-      if(!do_beamskip){
-	log_p += log(pz);
-      }
-      else{
-	self->temp_obs[j][beam_ind] = pz; 
+        self->temp_obs[j][beam_ind] = pz;
       }
     }
-    if(!do_beamskip){
-      sample->weight *= exp(log_p);
-      total_weight += sample->weight;
-    }
   }
-  
-  if(do_beamskip){
-    int skipped_beam_count = 0; 
+
+  return(total_weight);
+}
+
+double AMCLLaser::BeamSkipIntegrateRange(AMCLLaserData *data, pf_sample_set_t* set,
+                                         int /*thread_index*/, int begin, int end)
+{
+  AMCLLaser *self;
+  int j, beam_ind;
+  double log_p;
+  double total_weight;
+  pf_sample_t *sample;
+
+  self = (AMCLLaser*) data->sensor;
+
+  total_weight = 0.0;
+
+  for (j = begin; j < end; j++)
+  {
+    sample = set->samples + j;
+
+    log_p = 0;
+
     for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
-      if((obs_count[beam_ind] / static_cast<double>(set->sample_count)) > beam_skip_threshold){
-	obs_mask[beam_ind] = true;
-      }
-      else{
-	obs_mask[beam_ind] = false;
-	skipped_beam_count++; 
+      if(self->beamskip_error || self->obs_mask[beam_ind]){
+        log_p += log(self->temp_obs[j][beam_ind]);
       }
     }
 
-    //we check if there is at least a critical number of beams that agreed with the map 
-    //otherwise it probably indicates that the filter converged to a wrong solution
-    //if that's the case we integrate all the beams and hope the filter might converge to 
-    //the right solution
-    bool error = false; 
+    sample->weight *= exp(log_p);
 
-    if(skipped_beam_count >= (beam_ind * self->beam_skip_error_threshold)){
-      fprintf(stderr, "Over %f%% of the observations were not in the map - pf may have converged to wrong pose - integrating all observations\n", (100 * self->beam_skip_error_threshold));
-      error = true; 
-    }
-
-    for (j = 0; j < set->sample_count; j++)
-      {
-	sample = set->samples + j;
-	pose = sample->pose;
-
-	log_p = 0;
-
-	for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
-	  if(error || obs_mask[beam_ind]){
-	    log_p += log(self->temp_obs[j][beam_ind]);
-	  }
-	}
-	
-	sample->weight *= exp(log_p);
-	
-	total_weight += sample->weight;
-      }      
+    total_weight += sample->weight;
   }
 
-  delete [] obs_count; 
-  delete [] obs_mask;
   return(total_weight);
 }
 
-void AMCLLaser::reallocTempData(int new_max_samples, int new_max_obs){
-  if(temp_obs){
-    for(int k=0; k < max_samples; k++){
-      delete [] temp_obs[k];
-    }
-    delete []temp_obs; 
+////////////////////////////////////////////////////////////////////////////////
+// Store the endpoints of the beams of the scan
+void AMCLLaser::PrepareBeams(AMCLLaserData *data, int step)
+{
+  int i, beam_ind;
+  double obs_range, obs_bearing;
+
+  // The buffers are sized for all the beams of the scan, and not only for
+  // the valid ones, so that they are not reallocated by a later scan
+  int thread_count = this->pool ? this->pool->GetThreadCount() : 1;
+  size_t max_beam_count = (data->range_count + step - 1) / step;
+  this->beam_x.reserve(max_beam_count);
+  this->beam_y.reserve(max_beam_count);
+  this->beam_index.reserve(max_beam_count);
+  this->beam_cells.reserve(thread_count * max_beam_count);
+
+  this->beam_x.clear();
+  this->beam_y.clear();
+  this->beam_index.clear();
+
+  for (i = 0, beam_ind = 0; i < data->range_count; i += step, beam_ind++)
+  {
+    obs_range = data->ranges[i][0];
+    obs_bearing = data->ranges[i][1];
+
+    // The likelihood field models ignore max range readings
+    if(obs_range >= data->range_max)
+      continue;
+
+    // Check for NaN
+    if(obs_range != obs_range)
+      continue;
+
+    this->beam_x.push_back(obs_range * cos(obs_bearing) / this->map->scale);
+    this->beam_y.push_back(obs_range * sin(obs_bearing) / this->map->scale);
+    this->beam_index.push_back(beam_ind);
   }
+
+  this->beam_cells.resize(thread_count * this->beam_x.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Find the cells hit by the beams. The loop has no branches and works on
+// floats, so that it is vectorized by the compiler.
+void AMCLLaser::ProjectBeams(const pf_vector_t& laser_pose, int* cells) const
+{
+  const map_t* map = this->map;
+  const int beam_count = (int) this->beam_x.size();
+  const float* bx = this->beam_x.data();
+  const float* by = this->beam_y.data();
+
+  // One rotation for all the beams
+  const float c = (float) cos(laser_pose.v[2]);
+  const float s = (float) sin(laser_pose.v[2]);
+
+  // The laser position in map cells, see MAP_GXWX() and MAP_GYWY()
+  const float gx0 = (float) ((laser_pose.v[0] - map->origin_x) / map->scale + 0.5 + map->size_x / 2);
+  const float gy0 = (float) ((laser_pose.v[1] - map->origin_y) / map->scale + 0.5 + map->size_y / 2);
+
+  const int size_x = map->size_x;
+  const float max_gx = (float) map->size_x;
+  const float max_gy = (float) map->size_y;
+  const int off_map = map->size_x * map->size_y;
+
+  for (int k = 0; k < beam_count; k++)
+  {
+    float gx = gx0 + c * bx[k] - s * by[k];
+    float gy = gy0 + s * bx[k] + c * by[k];
+    bool valid = (gx >= 0.0f) & (gx < max_gx) & (gy >= 0.0f) & (gy < max_gy);
+    // clamp before the conversion, the result is discarded anyway if not valid
+    int mi = (int) std::min(std::max(0.0f, gx), max_gx - 1.0f);
+    int mj = (int) std::min(std::max(0.0f, gy), max_gy - 1.0f);
+    cells[k] = valid ? (mj * size_x + mi) : off_map;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tabulate the likelihood of the obstacle distances
+void AMCLLaser::UpdateLikelihoodField()
+{
+  double z_hit_denom = 2 * this->sigma_hit * this->sigma_hit;
+
+  this->likelihood_table.resize(MAP_OCC_DIST_LEVELS + 1);
+  for (int q = 0; q <= MAP_OCC_DIST_LEVELS; q++)
+  {
+    double z = MAP_OCC_DIST(this->map, q);
+    this->likelihood_table[q] = (float) exp(-(z * z) / z_hit_denom);
+  }
+}
+
+void AMCLLaser::reallocTempData(int new_max_samples, int new_max_obs){
   max_obs = new_max_obs; 
   max_samples = fmax(max_samples, new_max_samples); 
 
-  temp_obs = new double*[max_samples]();
-  for(int k=0; k < max_samples; k++){
-    temp_obs[k] = new double[max_obs]();
-  }
+  temp_obs.assign(max_samples, std::vector<double>(max_obs, 0.0));
 }
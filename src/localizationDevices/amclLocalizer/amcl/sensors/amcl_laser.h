@@ -30,8 +30,12 @@
 #define AMCL_LASER_H
 
 #include "amcl_sensor.h"
+#include "amcl_worker_pool.h"
 #include "../map/map.h"
 
+#include <memory>
+#include <vector>
+
 namespace amcl
 {
 
@@ -46,12 +50,29 @@ typedef enum
 class AMCLLaserData : public AMCLSensorData
 {
   public:
-    AMCLLaserData () {ranges=NULL;};
+    AMCLLaserData () {ranges=NULL; range_count=0; range_capacity=0;};
     virtual ~AMCLLaserData() {delete [] ranges;};
+
+  // Set the number of readings. The buffer is reallocated only when it grows,
+  // so that the same object can be reused for all the scans of a laser.
+  public: void Resize(int count)
+  {
+    if (count > this->range_capacity)
+    {
+      delete [] this->ranges;
+      this->ranges = new double[count][2];
+      this->range_capacity = count;
+    }
+    this->range_count = count;
+  }
+
   // Laser range data (range, bearing tuples)
   public: int range_count;
   public: double range_max;
   public: double (*ranges)[2];
+
+  // Number of readings which fit in ranges
+  private: int range_capacity;
 };
 
 
@@ -63,6 +84,10 @@ class AMCLLaser : public AMCLSensor
 
   public: virtual ~AMCLLaser(); 
 
+  // Not copyable: each laser builds its own model (see amclLocalizerThread)
+  private: AMCLLaser(const AMCLLaser&) = delete;
+  private: AMCLLaser& operator=(const AMCLLaser&) = delete;
+
   public: void SetModelBeam(double z_hit,
                             double z_short,
                             double z_max,
@@ -90,10 +115,28 @@ class AMCLLaser : public AMCLSensor
   // filter has been updated.
   public: virtual bool UpdateSensor(pf_t *pf, AMCLSensorData *data);
 
+  // Multiply the weights of the particles by the likelihood of the scan,
+  // as part of an update fused with other sensors (see pf_sensor_begin()).
+  // Returns true if the weights have been updated.
+  public: bool WeightSensor(pf_t *pf, AMCLSensorData *data);
+
+  // The sensor model of the selected model type
+  private: pf_sensor_model_fn_t SensorModel() const;
+
   // Set the laser's pose after construction
   public: void SetLaserPose(pf_vector_t& laser_pose) 
           {this->laser_pose = laser_pose;}
 
+  // Set the number of beams used for each scan, to decimate the readings
+  public: void SetMaxBeams(int max_beams)
+          {this->max_beams = max_beams;}
+
+  // Set the pool of threads used to compute the weights of the particles.
+  // The pool can be shared by several lasers. If no pool is set, the
+  // particles are processed by the calling thread.
+  public: void SetWorkerPool(std::shared_ptr<AMCLWorkerPool> pool)
+          {this->pool = pool;}
+
   // Determine the probability for the given pose
   private: static double BeamModel(AMCLLaserData *data, 
                                    pf_sample_set_t* set);
@@ -105,6 +148,37 @@ class AMCLLaser : public AMCLSensor
   private: static double LikelihoodFieldModelProb(AMCLLaserData *data, 
 					     pf_sample_set_t* set);
 
+  // Weight the samples [begin, end) of the set; returns their total weight.
+  // thread_index selects the scratch buffers of the calling thread.
+  private: typedef double (*range_model_fn_t) (AMCLLaserData *data, pf_sample_set_t* set,
+                                               int thread_index, int begin, int end);
+  private: static double BeamModelRange(AMCLLaserData *data, pf_sample_set_t* set,
+                                        int thread_index, int begin, int end);
+  private: static double LikelihoodFieldModelRange(AMCLLaserData *data, pf_sample_set_t* set,
+                                                   int thread_index, int begin, int end);
+  private: static double LikelihoodFieldModelProbRange(AMCLLaserData *data, pf_sample_set_t* set,
+                                                       int thread_index, int begin, int end);
+  private: static double BeamSkipIntegrateRange(AMCLLaserData *data, pf_sample_set_t* set,
+                                                int thread_index, int begin, int end);
+
+  // Run a range model over the whole set, splitting the samples among the
+  // threads of the pool. The partial weights of the threads are summed in
+  // a fixed order, so that the result does not depend on the scheduling.
+  private: double ComputeWeights(AMCLLaserData *data, pf_sample_set_t* set,
+                                 range_model_fn_t range_fn);
+
+  // Store the endpoints of the beams used by the likelihood field models, in
+  // the laser frame. Called once per scan, before the particles are weighted.
+  private: void PrepareBeams(AMCLLaserData *data, int step);
+
+  // Compute the map cell hit by each prepared beam, for the given laser pose.
+  // Beams ending outside the map get the index of the off-map entry of
+  // map_t::occ_dist.
+  private: void ProjectBeams(const pf_vector_t& laser_pose, int* cells) const;
+
+  // Tabulate the gaussian of the quantized obstacle distances
+  private: void UpdateLikelihoodField();
+
   private: void reallocTempData(int max_samples, int max_obs);
 
   private: laser_model_t model_type;
@@ -132,7 +206,29 @@ class AMCLLaser : public AMCLSensor
   //temp data that is kept before observations are integrated to each particle (requried for beam skipping)
   private: int max_samples;
   private: int max_obs;
-  private: double **temp_obs;
+  private: std::vector<std::vector<double>> temp_obs;
+
+  // Threads used to weight the particles (optional)
+  private: std::shared_ptr<AMCLWorkerPool> pool;
+  // Total weight computed by each thread
+  private: std::vector<double> partial_weights;
+  // For each thread, the number of its particles agreeing with the map on
+  // each beam (max_beams entries per thread). Kept separated to avoid races.
+  private: std::vector<int> obs_count;
+  // Beams integrated in the second pass of the beam skipping
+  private: std::vector<char> obs_mask;
+  // True if all the beams are integrated in the second pass (error condition)
+  private: bool beamskip_error;
+
+  // Endpoints of the beams of the current scan in the laser frame, in map
+  // cells, and the index of each beam among the subsampled ones
+  private: std::vector<float> beam_x;
+  private: std::vector<float> beam_y;
+  private: std::vector<int> beam_index;
+  // For each thread, the map cell hit by each beam (beam_x.size() entries per thread)
+  private: std::vector<int> beam_cells;
+  // exp(-z^2 / (2 sigma_hit^2)) for each quantized obstacle distance z of the map
+  private: std::vector<float> likelihood_table;
 
   // Laser model params
   //
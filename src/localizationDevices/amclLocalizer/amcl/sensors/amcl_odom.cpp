@@ -150,9 +150,9 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
       double sn_bearing = sin(delta_bearing);
 
       // Sample pose differences
-      delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-      delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-      delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
+      delta_trans_hat = delta_trans + pf_ran_gaussian(&pf->rng, trans_hat_stddev);
+      delta_rot_hat = delta_rot + pf_ran_gaussian(&pf->rng, rot_hat_stddev);
+      delta_strafe_hat = 0 + pf_ran_gaussian(&pf->rng, strafe_hat_stddev);
       // Apply sampled update to particle pose
       sample->pose.v[0] += (delta_trans_hat * cs_bearing + 
                             delta_strafe_hat * sn_bearing);
@@ -195,14 +195,14 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
 
       // Sample pose differences
       delta_rot1_hat = angle_diff(delta_rot1,
-                                  pf_ran_gaussian(this->alpha1*delta_rot1_noise*delta_rot1_noise +
+                                  pf_ran_gaussian(&pf->rng, this->alpha1*delta_rot1_noise*delta_rot1_noise +
                                                   this->alpha2*delta_trans*delta_trans));
       delta_trans_hat = delta_trans - 
-              pf_ran_gaussian(this->alpha3*delta_trans*delta_trans +
+              pf_ran_gaussian(&pf->rng, this->alpha3*delta_trans*delta_trans +
                               this->alpha4*delta_rot1_noise*delta_rot1_noise +
                               this->alpha4*delta_rot2_noise*delta_rot2_noise);
       delta_rot2_hat = angle_diff(delta_rot2,
-                                  pf_ran_gaussian(this->alpha1*delta_rot2_noise*delta_rot2_noise +
+                                  pf_ran_gaussian(&pf->rng, this->alpha1*delta_rot2_noise*delta_rot2_noise +
                                                   this->alpha2*delta_trans*delta_trans));
 
       // Apply sampled update to particle pose
@@ -241,9 +241,9 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
       double sn_bearing = sin(delta_bearing);
 
       // Sample pose differences
-      delta_trans_hat = delta_trans + pf_ran_gaussian(trans_hat_stddev);
-      delta_rot_hat = delta_rot + pf_ran_gaussian(rot_hat_stddev);
-      delta_strafe_hat = 0 + pf_ran_gaussian(strafe_hat_stddev);
+      delta_trans_hat = delta_trans + pf_ran_gaussian(&pf->rng, trans_hat_stddev);
+      delta_rot_hat = delta_rot + pf_ran_gaussian(&pf->rng, rot_hat_stddev);
+      delta_strafe_hat = 0 + pf_ran_gaussian(&pf->rng, strafe_hat_stddev);
       // Apply sampled update to particle pose
       sample->pose.v[0] += (delta_trans_hat * cs_bearing + 
                             delta_strafe_hat * sn_bearing);
@@ -286,14 +286,14 @@ bool AMCLOdom::UpdateAction(pf_t *pf, AMCLSensorData *data)
 
       // Sample pose differences
       delta_rot1_hat = angle_diff(delta_rot1,
-                                  pf_ran_gaussian(sqrt(this->alpha1*delta_rot1_noise*delta_rot1_noise +
+                                  pf_ran_gaussian(&pf->rng, sqrt(this->alpha1*delta_rot1_noise*delta_rot1_noise +
                                                        this->alpha2*delta_trans*delta_trans)));
       delta_trans_hat = delta_trans - 
-              pf_ran_gaussian(sqrt(this->alpha3*delta_trans*delta_trans +
+              pf_ran_gaussian(&pf->rng, sqrt(this->alpha3*delta_trans*delta_trans +
                                    this->alpha4*delta_rot1_noise*delta_rot1_noise +
                                    this->alpha4*delta_rot2_noise*delta_rot2_noise));
       delta_rot2_hat = angle_diff(delta_rot2,
-                                  pf_ran_gaussian(sqrt(this->alpha1*delta_rot2_noise*delta_rot2_noise +
+                                  pf_ran_gaussian(&pf->rng, sqrt(this->alpha1*delta_rot2_noise*delta_rot2_noise +
                                                        this->alpha2*delta_trans*delta_trans)));
 
       // Apply sampled update to particle pose
@@ -0,0 +1,141 @@
+/*
+ *   Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ *   All rights reserved.
+ *
+ *   This software may be modified and distributed under the terms of the
+ *   GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Persistent pool of threads used to split the sensor models
+//       over the particles of a sample set
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include "amcl/sensors/amcl_worker_pool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace amcl;
+
+////////////////////////////////////////////////////////////////////////////////
+// Default constructor
+AMCLWorkerPool::AMCLWorkerPool(int thread_count) : task(NULL), task_count(0),
+                                                   generation(0), pending(0), quit(false),
+                                                   worker_cpu_time(0.0)
+{
+  if (thread_count < 1)
+    thread_count = std::thread::hardware_concurrency();
+  if (thread_count < 1)
+    thread_count = 1;
+  this->thread_count = thread_count;
+
+  // Thread 0 is the caller of ParallelFor()
+  for (int i = 1; i < this->thread_count; i++)
+    this->workers.push_back(std::thread(&AMCLWorkerPool::WorkerLoop, this, i));
+}
+
+AMCLWorkerPool::~AMCLWorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->quit = true;
+  }
+  this->start_cv.notify_all();
+  for (size_t i = 0; i < this->workers.size(); i++)
+    this->workers[i].join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run a task on all the threads of the pool
+void AMCLWorkerPool::ParallelFor(int count, const task_fn_t& task)
+{
+  if (this->thread_count < 2 || count < this->thread_count)
+  {
+    task(0, 0, count);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->task = &task;
+    this->task_count = count;
+    this->pending = this->thread_count - 1;
+    this->generation++;
+  }
+  this->start_cv.notify_all();
+
+  task(0, 0, count / this->thread_count);
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->done_cv.wait(lock, [this] {return this->pending == 0;});
+  this->task = NULL;
+}
+
+void AMCLWorkerPool::WorkerLoop(int thread_index)
+{
+  unsigned int last_generation = 0;
+  while (true)
+  {
+    const task_fn_t* current_task;
+    int count;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->start_cv.wait(lock, [&] {return this->quit || this->generation != last_generation;});
+      if (this->quit)
+        return;
+      last_generation = this->generation;
+      current_task = this->task;
+      count = this->task_count;
+    }
+
+    int begin = (int)((long long)count * thread_index / this->thread_count);
+    int end = (int)((long long)count * (thread_index + 1) / this->thread_count);
+    double cpu_start = ThreadCpuTime();
+    (*current_task)(thread_index, begin, end);
+    double cpu_time = ThreadCpuTime() - cpu_start;
+
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->worker_cpu_time += cpu_time;
+      last = (--this->pending == 0);
+    }
+    if (last)
+      this->done_cv.notify_one();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CPU time of the workers since the previous call
+double AMCLWorkerPool::TakeWorkerCpuTime()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  double cpu_time = this->worker_cpu_time;
+  this->worker_cpu_time = 0.0;
+  return cpu_time;
+}
+
+double AMCLWorkerPool::ThreadCpuTime()
+{
+#ifdef _WIN32
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+    return 0.0;
+  ULARGE_INTEGER kernel, user;
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+  user.LowPart = user_time.dwLowDateTime;
+  user.HighPart = user_time.dwHighDateTime;
+  return (double)(kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0.0;
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
@@ -0,0 +1,79 @@
+/*
+ *   Copyright (C) 2020 Istituto Italiano di Tecnologia (IIT)
+ *   All rights reserved.
+ *
+ *   This software may be modified and distributed under the terms of the
+ *   GPL-2+ license. See the accompanying LICENSE file for details.
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Persistent pool of threads used to split the sensor models
+//       over the particles of a sample set
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_WORKER_POOL_H
+#define AMCL_WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace amcl
+{
+
+// The threads are created once and sleep between two calls of ParallelFor(),
+// so that the cost of a sensor update is not increased by thread creation.
+class AMCLWorkerPool
+{
+  // Function executed on the range [begin, end) by the thread thread_index
+  public: typedef std::function<void(int thread_index, int begin, int end)> task_fn_t;
+
+  // Create a pool which uses thread_count threads, including the calling one.
+  // A value smaller than 1 selects the number of cores of the machine.
+  public: AMCLWorkerPool(int thread_count);
+
+  public: ~AMCLWorkerPool();
+
+  // Number of threads which cooperate in ParallelFor(), including the caller
+  public: int GetThreadCount() const {return this->thread_count;}
+
+  // Split [0, count) in GetThreadCount() contiguous chunks and run task on each of
+  // them, one chunk per thread. The calling thread processes the first chunk.
+  // Returns when all the chunks have been processed. It must not be called
+  // concurrently from different threads.
+  public: void ParallelFor(int count, const task_fn_t& task);
+
+  // CPU time [s] used by the worker threads in ParallelFor() since the
+  // previous call. The chunks run by the calling thread are not included:
+  // they are part of its own CPU time.
+  public: double TakeWorkerCpuTime();
+
+  // CPU time [s] used so far by the calling thread
+  public: static double ThreadCpuTime();
+
+  private: void WorkerLoop(int thread_index);
+
+  private: int thread_count;
+  private: std::vector<std::thread> workers;
+
+  private: std::mutex mutex;
+  private: std::condition_variable start_cv;
+  private: std::condition_variable done_cv;
+
+  // The job currently executed, valid while pending > 0
+  private: const task_fn_t* task;
+  private: int task_count;
+  private: unsigned int generation;
+  private: int pending;
+  private: bool quit;
+
+  // Accumulated by the workers when they complete a chunk
+  private: double worker_cpu_time;
+};
+
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include <cmath>
 #include <random>
 #include <algorithm>
+#include <atomic>
 #include "amclLocalizer.h"
 
 using namespace yarp::os;
@@ -39,6 +40,13 @@ using namespace std;
 
 YARP_LOG_COMPONENT(AMCL_DEV, "navigation.devices.amclLocalizer")
 
+//trace of the filter pipeline: compiled only with LOWLEVEL_DEBUG, printed only if the 'trace' option is set
+#ifdef LOWLEVEL_DEBUG
+#define AMCL_TRACE(...) do { if (m_config.m_trace) { yCDebug(AMCL_DEV, __VA_ARGS__); } } while (0)
+#else
+#define AMCL_TRACE(...) do { } while (0)
+#endif
+
 static double normalize(double z)
 {
     return atan2(sin(z), cos(z));
@@ -68,8 +76,26 @@ void amclLocalizerRPCHandler::setInterface(amclLocalizer* iface)
 bool amclLocalizerRPCHandler::respond(const yarp::os::Bottle& command, yarp::os::Bottle& reply)
 {
     reply.clear();
+    if (command.get(0).asString() == "compute_stats" && interface && interface->m_thread)
+    {
+        double last_cpu_time = 0;
+        double last_wall_time = 0;
+        double scale = 0;
+        int sample_limit = 0;
+        interface->m_thread->getComputeStats(last_cpu_time, last_wall_time, scale, sample_limit);
+        reply.addString("cpu_time");
+        reply.addDouble(last_cpu_time);
+        reply.addString("wall_time");
+        reply.addDouble(last_wall_time);
+        reply.addString("scale");
+        reply.addDouble(scale);
+        reply.addString("sample_limit");
+        reply.addInt(sample_limit);
+        return true;
+    }
     reply.addVocab(Vocab::encode("many"));
-    reply.addString("Not yet Implemented");
+    reply.addString("Unknown command. Available commands:");
+    reply.addString("compute_stats: cost of the last filter update and current compute scale");
     return true;
 }
 
@@ -135,14 +161,13 @@ amclLocalizerThread::amclLocalizerThread(double _period, string _name, yarp::os:
 {
     m_handler_odom = nullptr;
     m_handler_pf = nullptr;
-    m_handler_laser = nullptr;
     m_initial_pose_hyp = nullptr;
     m_amcl_map = nullptr;
     m_iMap = nullptr;
-    m_iLaser = nullptr;
 
     m_last_odometry_data_received = -1;
     m_last_statistics_printed = -1;
+    m_compute_scale = 1.0;
 
     m_localization_data.map_id = "unknown";
     m_localization_data.x = nan("");
@@ -151,9 +176,134 @@ amclLocalizerThread::amclLocalizerThread(double _period, string _name, yarp::os:
 
 }
 
+bool amclLocalizerThread::integrateLaser(laser_device_t& laser, const pf_vector_t& pose)
+{
+    //scans which are too old do not describe the current surroundings of the robot
+    double age = yarp::os::Time::now() - laser.measurement_timestamp;
+    if (laser.measurement_timestamp < 0 || laser.measurement_data.empty() || age > m_config.m_laser_max_age)
+    {
+        AMCL_TRACE("Laser %s: no recent scan (age: %.3fs)", laser.remote_port.c_str(), age);
+        return false;
+    }
+
+    //the lasers are not synchronized: the scan was acquired when the odometry was measurement_odom.
+    //The motion since then is expressed in the current base frame and composed with the mounting pose.
+    pf_vector_t scan_base_pose = pf_vector_coord_sub(laser.measurement_odom, pose);
+    pf_vector_t laser_pose = pf_vector_coord_add(laser.mounting_pose, scan_base_pose);
+    laser.model->SetLaserPose(laser_pose);
+
+    //the scan buffer is kept between the updates, it is reallocated only if the laser has more readings
+    AMCLLaserData& ldata = laser.data;
+    ldata.sensor = laser.model;
+    ldata.Resize(laser.measurement_data.size());
+    double angle_min = laser.min_laser_angle * DEG2RAD; //in the laser frame, the mounting pose is in laser_pose
+    double angle_increment = laser.horizontal_resolution * DEG2RAD;
+    // wrapping angle to [-pi .. pi]
+    angle_increment = fmod(angle_increment + 5 * M_PI, 2 * M_PI) - M_PI; //@@@CHEKC THIS
+
+    AMCL_TRACE("Laser %s, angles in laser frame: min: %.3f, inc: %.3f, size %d, age %.3fs", laser.remote_port.c_str(), angle_min, angle_increment, ldata.range_count, age);
+
+    // Apply range min/max thresholds, if the user supplied them
+    if (m_config.m_laser_max_range > 0.0)
+    {
+        ldata.range_max = std::min(laser.max_laser_distance, m_config.m_laser_max_range);
+    }
+    else
+    {
+        ldata.range_max = laser.max_laser_distance;
+    }
+    double range_min;
+    if (m_config.m_laser_min_range > 0.0)
+    {
+        range_min = std::max(laser.min_laser_distance, m_config.m_laser_min_range);
+    }
+    else
+    {
+        range_min = laser.min_laser_distance;
+    }
+    for (int i = 0; i<ldata.range_count; i++)
+    {
+        // amcl doesn't (yet) have a concept of min range.  So we'll map short readings to max range.
+        double rho = 0;
+        double theta = 0;
+        laser.measurement_data[i].get_polar(rho,theta); //@@@@ check carefully, i and theta
+        if (rho <= range_min)
+        {
+            ldata.ranges[i][0] = ldata.range_max;
+        }
+        else
+        {
+            ldata.ranges[i][0] = rho;
+        }
+        // Compute bearing
+        ldata.ranges[i][1] = angle_min + (i * angle_increment);
+    }
+
+    //the weights computed with this scan multiply the ones of the other lasers
+    return laser.model->WeightSensor(m_handler_pf, (AMCLSensorData*)&ldata);
+}
+
+void amclLocalizerThread::updateComputeBudget(double cpu_time, double wall_time)
+{
+    if (m_config.m_governor_enable)
+    {
+        //the filter needs all its resources when it is not sure about the pose of the robot:
+        //before convergence, with a spread cloud or when the recent likelihood drops (w_fast < w_slow)
+        pf_sample_set_t* set = m_handler_pf->sets + m_handler_pf->current_set;
+        double cov_xy = set->cov.m[0][0] + set->cov.m[1][1];
+        double cov_theta = set->cov.m[2][2];
+        bool recovering = m_handler_pf->w_slow > 0 && m_handler_pf->w_fast < 0.9 * m_handler_pf->w_slow;
+        bool uncertain = !set->converged || recovering ||
+                         cov_xy > m_config.m_governor_max_cov_xy ||
+                         cov_theta > m_config.m_governor_max_cov_theta;
+
+        //grow quickly when uncertain, shrink slowly otherwise
+        double scale = uncertain ? m_compute_scale * 2.0 : m_compute_scale * 0.9;
+
+        //the CPU budget is always respected, down to the minimum scale
+        if (m_config.m_governor_cpu_budget > 0 && cpu_time > m_config.m_governor_cpu_budget)
+        {
+            scale = std::min(scale, m_compute_scale * m_config.m_governor_cpu_budget / cpu_time);
+        }
+        m_compute_scale = std::max(m_config.m_governor_min_scale, std::min(1.0, scale));
+
+        for (auto& laser : m_laser_devices)
+        {
+            double max_beams = laser->max_beams > 0 ? laser->max_beams : m_config.m_max_beams;
+            laser->model->SetMaxBeams(std::max(2, (int)(max_beams * m_compute_scale + 0.5)));
+        }
+        pf_set_sample_limit(m_handler_pf, (int)(m_config.m_max_particles * m_compute_scale + 0.5));
+
+        AMCL_TRACE("Compute governor: cpu %.2fms, cov_xy %.4f, cov_theta %.4f, uncertain %d, scale %.3f",
+            cpu_time * 1000.0, cov_xy, cov_theta, uncertain, m_compute_scale);
+    }
+
+    std::lock_guard<std::mutex> lock(m_compute_stats_mutex);
+    m_compute_stats.last_cpu_time = cpu_time;
+    m_compute_stats.last_wall_time = wall_time;
+    m_compute_stats.total_cpu_time += cpu_time;
+    m_compute_stats.max_cpu_time = std::max(m_compute_stats.max_cpu_time, cpu_time);
+    m_compute_stats.updates++;
+    m_compute_stats.scale = m_compute_scale;
+    m_compute_stats.sample_limit = m_handler_pf->sample_limit;
+}
+
+void amclLocalizerThread::getComputeStats(double& last_cpu_time, double& last_wall_time, double& scale, int& sample_limit)
+{
+    std::lock_guard<std::mutex> lock(m_compute_stats_mutex);
+    last_cpu_time = m_compute_stats.last_cpu_time;
+    last_wall_time = m_compute_stats.last_wall_time;
+    scale = m_compute_stats.scale;
+    sample_limit = m_compute_stats.sample_limit;
+}
+
 void amclLocalizerThread::updateFilter()
 {
-    int laser_index = 0; //@@@always use the first and unique (for now) laser
+    //CPU time of this thread plus the one of the workers computing the weights. The process CPU time
+    //would also count the other devices running in the same process.
+    double cpu_start = AMCLWorkerPool::ThreadCpuTime();
+    if (m_laser_model_pool) { m_laser_model_pool->TakeWorkerCpuTime(); }
+    double wall_start = yarp::os::Time::now();
 
     pf_vector_t delta = pf_vector_zero();
     pf_vector_t pose;
@@ -173,22 +323,14 @@ void amclLocalizerThread::updateFilter()
                       fabs(delta.v[1]) > m_config.m_d_thresh ||
                       fabs(delta.v[2]) > m_config.m_a_thresh;
 
-#ifdef LOWLEVEL_DEBUG
         if (update)
         {
-            yCDebug(AMCL_DEV) << "Update requested by thresholds";
-        }
-        else
-        {
-    #ifdef LOWLEVEL_ALWAYS_DEBUG
-            yCDebug() << "No threshold update requested";
-    #endif
+            AMCL_TRACE("Update requested by thresholds");
         }
-        if(m_force_update)
+        if (m_force_update)
         {
-            yCDebug(AMCL_DEV) << "Force Update requested";
+            AMCL_TRACE("Force Update requested");
         }
-#endif
 
         update = update || m_force_update;
         m_force_update = false;
@@ -196,49 +338,42 @@ void amclLocalizerThread::updateFilter()
         // Set the laser update flags
         if (update)
         {
-            for (unsigned int i = 0; i < m_lasers_update.size(); i++)
+            for (auto& laser : m_laser_devices)
             {
-                m_lasers_update[i] = true;
+                laser->update = true;
             }
-#ifdef LOWLEVEL_DEBUG
-            yCDebug(AMCL_DEV) << "1. Laser updated = true";
-#endif
-        }
-        else
-        {
-#ifdef LOWLEVEL_DEBUG
-    #ifdef LOWLEVEL_ALWAYS_DEBUG
-            yCDebug() << "1. Laser updated unrequested";
-    #endif
-#endif
+            AMCL_TRACE("1. Laser updated = true");
         }
     }
 
+    bool lasers_update = false;
+    for (auto& laser : m_laser_devices)
+    {
+        lasers_update = lasers_update || laser->update;
+    }
+
     bool force_publication = false;
     //first run, filter initialization
     if (m_pf_initialized==false)
     {
-#ifdef LOWLEVEL_DEBUG
-        yCDebug(AMCL_DEV) << "m_pf_initialized=false, initialiazing...";
-#endif
+        AMCL_TRACE("m_pf_initialized=false, initialiazing...");
         // Pose at last filter update
         m_pf_odom_pose = pose;
         // Filter is now initialized
         m_pf_initialized = true;
         // Should update sensor data
-        for (unsigned int i = 0; i < m_lasers_update.size(); i++)
+        for (auto& laser : m_laser_devices)
         {
-            m_lasers_update[i] = true;
+            laser->update = true;
         }
+        lasers_update = true;
         force_publication = true;
         m_resample_count = 0;
     }
     // If the robot has moved, update the filter
-    else if (m_pf_initialized && m_lasers_update[laser_index])
+    else if (m_pf_initialized && lasers_update)
     {
-#ifdef LOWLEVEL_DEBUG
-        yCDebug(AMCL_DEV) << "m_pf_init=true, m_lasers_update=true. update odometry";
-#endif
+        AMCL_TRACE("m_pf_init=true, m_lasers_update=true. update odometry");
         //printf("pose\n");
         //pf_vector_fprintf(pose, stdout, "%.3f");
 
@@ -258,99 +393,42 @@ void amclLocalizerThread::updateFilter()
 
     bool resampled = false;
     // If the robot has moved, update the filter
-    if (m_lasers_update[laser_index])
+    if (lasers_update)
     {
-#ifdef LOWLEVEL_DEBUG
-        yCDebug(AMCL_DEV) << "m_lasers_update=true, update laser data";
-#endif
-        AMCLLaserData ldata;
-        ldata.sensor = m_lasers[laser_index];
-        ldata.range_count = m_laser_measurement_data.size(); //@@@ 360? get this form the laser
-        double angle_min = m_min_laser_angle * DEG2RAD; ///@@@ get this from the laser, THIS needs to be expressed in the base frame, in RADIAS
-        double angle_increment = m_horizontal_resolution *DEG2RAD; //@@@ THIS needs to expressed in the base frame, in RADIANS
-        // wrapping angle to [-pi .. pi]
-        angle_increment = fmod(angle_increment + 5 * M_PI, 2 * M_PI) - M_PI; //@@@CHEKC THIS
-
-#ifdef  LOWLEVEL_DEBUG 
-        yCDebug(AMCL_DEV,"Laser #%d, angles in base frame: min: %.3f, inc: %.3f, size %d", laser_index, angle_min, angle_increment, ldata.range_count);
-#endif
-
-        // Apply range min/max thresholds, if the user supplied them
-        if (m_config.m_laser_max_range > 0.0)
-        {
-            double tmp = m_max_laser_distance;
-            ldata.range_max = std::min(tmp, m_config.m_laser_max_range);
-        }
-        else
-        {
-            ldata.range_max = m_max_laser_distance;
-        }
-        double range_min;
-        if (m_config.m_laser_min_range > 0.0)
-        {
-            double tmp = m_min_laser_distance;
-            range_min = std::max(tmp, m_config.m_laser_min_range);
-        }
-        else
-        {
-            range_min = m_min_laser_distance;
-        }
-        // The AMCLLaserData destructor will free this memory
-        ldata.ranges = new double[ldata.range_count][2];
-        yAssert(ldata.ranges);
-        for (int i = 0; i<ldata.range_count; i++)
+        AMCL_TRACE("m_lasers_update=true, update laser data");
+        //all the available scans are fused in the weights of the particles, then the set is resampled.
+        //The running averages of the likelihood, which drive the injection of random particles,
+        //are updated once with the geometric mean of the likelihoods of the scans, so that they
+        //do not jump when a laser is skipped because its scan is too old.
+        int integrated_lasers = 0;
+        pf_sensor_begin(m_handler_pf);
+        for (auto& laser : m_laser_devices)
         {
-            // amcl doesn't (yet) have a concept of min range.  So we'll map short readings to max range.
-            double rho = 0;
-            double theta = 0;
-            m_laser_measurement_data[i].get_polar(rho,theta); //@@@@ check carefully, i and theta
-            if (rho <= range_min)
-            {
-                ldata.ranges[i][0] = ldata.range_max;
-            }
-            else
+            if (laser->update && integrateLaser(*laser, pose))
             {
-                ldata.ranges[i][0] = rho;
+                integrated_lasers++;
             }
-            // Compute bearing
-            ldata.ranges[i][1] = angle_min + (i * angle_increment);
-            yCDebug(AMCL_DEV) << ldata.ranges[i][1];
+            laser->update = false;
         }
-
-        m_lasers[laser_index]->UpdateSensor(m_handler_pf, (AMCLSensorData*)&ldata);
-
-        m_lasers_update[laser_index] = false;
+        pf_sensor_finish(m_handler_pf);
 
         m_pf_odom_pose = pose;
 
         // Resample the particles
-        if (!(++m_resample_count % m_resample_interval))
+        if (integrated_lasers > 0 && !(++m_resample_count % m_resample_interval))
         {
             pf_update_resample(m_handler_pf);
-            yCDebug(AMCL_DEV,"Resampled by time (count %d / %d)", m_resample_count, m_resample_interval);
+            AMCL_TRACE("Resampled by time (count %d / %d)", m_resample_count, m_resample_interval);
             resampled = true;
         }
 
         pf_sample_set_t* set = m_handler_pf->sets + m_handler_pf->current_set;
-#ifdef LOWLEVEL_DEBUG
-        yCDebug(AMCL_DEV,"Num samples: %d\n", set->sample_count);
-#endif
+        AMCL_TRACE("Num samples: %d", set->sample_count);
         // Publish the resulting cloud
         // TODO: set maximum rate for publishing
         if (!m_force_update)
         {
-            //mutex protected vs amclLocalizerThread::getPoses()
-            m_particle_poses_mutex.lock();
-            m_particle_poses.clear();
-            for (int i = 0; i < set->sample_count; i++)
-            {
-                Map2DLocation ppose;
-                ppose.x = set->samples[i].pose.v[0];
-                ppose.y = set->samples[i].pose.v[1];
-                ppose.theta = set->samples[i].pose.v[2]*RAD2DEG; //@@@@@@@CHECKME
-                m_particle_poses.push_back(ppose);
-            }
-            m_particle_poses_mutex.unlock();
+            publishParticleCloud(set);
         }
     }
 
@@ -359,7 +437,7 @@ void amclLocalizerThread::updateFilter()
         // Read out the current hypotheses
         double max_weight = 0.0;
         int max_weight_hyp = -1;
-        std::vector<amcl_hyp_t> hyps;
+        std::vector<amcl_hyp_t>& hyps = m_hyps;
         hyps.resize(m_handler_pf->sets[m_handler_pf->current_set].cluster_count);
         for (int hyp_count = 0;
             hyp_count < m_handler_pf->sets[m_handler_pf->current_set].cluster_count; hyp_count++)
@@ -410,12 +488,73 @@ void amclLocalizerThread::updateFilter()
         }
 
     }
+
+    if (lasers_update)
+    {
+        double cpu_time = AMCLWorkerPool::ThreadCpuTime() - cpu_start;
+        if (m_laser_model_pool) { cpu_time += m_laser_model_pool->TakeWorkerCpuTime(); }
+        updateComputeBudget(cpu_time, yarp::os::Time::now() - wall_start);
+    }
+}
+
+void amclLocalizerThread::publishParticleCloud(pf_sample_set_t* set)
+{
+    //the map_id string is shared by all the snapshots of the same map
+    if (!m_particle_cloud_map_id || *m_particle_cloud_map_id != m_localization_data.map_id)
+    {
+        m_particle_cloud_map_id = std::make_shared<const std::string>(m_localization_data.map_id);
+    }
+
+    //take a snapshot which is not the published one and which is not held by a reader.
+    //Readers can only obtain the published snapshot, so a free one cannot be taken meanwhile.
+    std::shared_ptr<particle_cloud_t> cloud;
+    for (auto& pooled : m_particle_cloud_pool)
+    {
+        if (pooled.use_count() == 1)
+        {
+            cloud = pooled;
+            break;
+        }
+    }
+    if (!cloud)
+    {
+        cloud = std::make_shared<particle_cloud_t>();
+        m_particle_cloud_pool.push_back(cloud);
+    }
+    //the readers of this snapshot are done, see its last reads before overwriting it
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    cloud->map_id = m_particle_cloud_map_id;
+    cloud->poses.resize(set->sample_count);
+    for (int i = 0; i < set->sample_count; i++)
+    {
+        cloud->poses[i] = set->samples[i].pose;
+    }
+    std::atomic_store(&m_particle_cloud, std::shared_ptr<const particle_cloud_t>(cloud));
+}
+
+std::shared_ptr<const amclLocalizerThread::particle_cloud_t> amclLocalizerThread::getParticleCloud()
+{
+    return std::atomic_load(&m_particle_cloud);
 }
 
 bool amclLocalizerThread::getPoses(std::vector<Map2DLocation>& poses)
 {
-    std::lock_guard<std::mutex> lock(m_particle_poses_mutex);
-    poses = m_particle_poses;
+    //the conversion is done by the caller, on a snapshot which is not touched by the filter
+    std::shared_ptr<const particle_cloud_t> cloud = getParticleCloud();
+    if (!cloud)
+    {
+        poses.clear();
+        return true;
+    }
+    poses.resize(cloud->poses.size());
+    for (size_t i = 0; i < cloud->poses.size(); i++)
+    {
+        poses[i].map_id = *cloud->map_id;
+        poses[i].x = cloud->poses[i].v[0];
+        poses[i].y = cloud->poses[i].v[1];
+        poses[i].theta = cloud->poses[i].v[2] * RAD2DEG; //@@@@@@@CHECKME
+    }
     return true;
 }
 
@@ -431,6 +570,18 @@ void amclLocalizerThread::run()
     //print some stats every 10 seconds
     if (current_time - m_last_statistics_printed > 10.0)
     {
+        std::lock_guard<std::mutex> lock(m_compute_stats_mutex);
+        if (m_compute_stats.updates > 0)
+        {
+            yCInfo(AMCL_DEV, "%d updates, cpu time: mean %.2fms max %.2fms, scale %.2f, max particles %d",
+                m_compute_stats.updates,
+                m_compute_stats.total_cpu_time / m_compute_stats.updates * 1000.0,
+                m_compute_stats.max_cpu_time * 1000.0,
+                m_compute_stats.scale, m_compute_stats.sample_limit);
+        }
+        m_compute_stats.total_cpu_time = 0;
+        m_compute_stats.max_cpu_time = 0;
+        m_compute_stats.updates = 0;
         m_last_statistics_printed = yarp::os::Time::now();
     }
 
@@ -450,17 +601,30 @@ void amclLocalizerThread::run()
         m_odometry_data.theta = odom->odom_theta;
     }
 
-    //read laser data
-    bool las_ok = m_iLaser->getLaserMeasurement(m_laser_measurement_data);
-    if (las_ok)
+    //read laser data. Each scan is stored with its timestamp and the odometry at that time,
+    //so that the scans of the lasers can be fused even if they are not synchronized.
+    for (auto& laser : m_laser_devices)
     {
-        m_laser_measurement_timestamp = yarp::os::Time::now();
-        pf_vector_t pose_v;
-        //@@@@set here the pose of the laser respect to base_frame_id
-        pose_v.v[0] = 0;
-        pose_v.v[1] = 0;
-        pose_v.v[2] = 0;
-        m_lasers[0]->SetLaserPose(pose_v);
+        double timestamp = yarp::os::Time::now();
+        if (laser->iTimed)
+        {
+            yarp::os::Stamp stamp = laser->iTimed->getLastInputStamp();
+            if (stamp.isValid())
+            {
+                timestamp = stamp.getTime();
+            }
+        }
+        if (timestamp == laser->measurement_timestamp)
+        {
+            continue;
+        }
+        if (laser->iLaser->getLaserMeasurement(laser->measurement_data))
+        {
+            laser->measurement_timestamp = timestamp;
+            laser->measurement_odom.v[0] = m_odometry_data.x;
+            laser->measurement_odom.v[1] = m_odometry_data.y;
+            laser->measurement_odom.v[2] = m_odometry_data.theta * DEG2RAD;
+        }
     }
 
     //process data
@@ -623,20 +787,36 @@ bool amclLocalizerThread::threadInit()
         yCError(AMCL_DEV) << "Missing ODOMETRY group!";
         return false;
     }
-    Bottle laser_group = m_cfg.findGroup("LASER");
-    if (laser_group.isNull())
+    if (m_cfg.findGroup("LASER").isNull())
     {
         yCError(AMCL_DEV) << "Missing LASER group!";
         return false;
     }
 
-    //laser group
-    if (laser_group.check("laser_broadcast_port") == false)
+    //laser groups: [LASER] describes the first rangefinder, [LASER_1], [LASER_2]... the other ones
+    m_laser_devices.clear();
+    for (size_t i = 0; ; i++)
     {
-        yCError(AMCL_DEV) << "Missing `laser_broadcast_port` in [LASER] group";
-        return false;
+        std::string group_name = (i == 0) ? std::string("LASER") : "LASER_" + std::to_string(i);
+        Bottle laser_group = m_cfg.findGroup(group_name);
+        if (laser_group.isNull())
+        {
+            break;
+        }
+        if (laser_group.check("laser_broadcast_port") == false)
+        {
+            yCError(AMCL_DEV) << "Missing `laser_broadcast_port` in [" << group_name << "] group";
+            return false;
+        }
+        std::unique_ptr<laser_device_t> laser(new laser_device_t);
+        laser->remote_port = laser_group.find("laser_broadcast_port").asString();
+        laser->mounting_pose.v[0] = laser_group.check("laser_pose_x", Value(0.0)).asDouble();
+        laser->mounting_pose.v[1] = laser_group.check("laser_pose_y", Value(0.0)).asDouble();
+        laser->mounting_pose.v[2] = laser_group.check("laser_pose_theta", Value(0.0)).asDouble() * DEG2RAD;
+        laser->max_beams = laser_group.check("laser_max_beams", Value(-1)).asInt();
+        laser->measurement_odom = pf_vector_zero();
+        m_laser_devices.push_back(std::move(laser));
     }
-    m_laser_remote_port = laser_group.find("laser_broadcast_port").asString();
 
     //odometry group
     if (odometry_group.check("odometry_broadcast_port") == false)
@@ -752,10 +932,35 @@ bool amclLocalizerThread::threadInit()
     m_base_frame_id = amcl_group.check("base_frame_id", Value("base_link")).asString();
     m_global_frame_id = amcl_group.check("global_frame_id", Value("map")).asString();
     m_resample_interval = amcl_group.check("resample_interval", Value(2)).asDouble();
+    std::string tmp_resample_model = amcl_group.check("resample_model", Value("multinomial")).asString();
+    if (tmp_resample_model == "multinomial")
+        m_resample_model = PF_RESAMPLE_MULTINOMIAL;
+    else if (tmp_resample_model == "alias")
+        m_resample_model = PF_RESAMPLE_ALIAS;
+    else if (tmp_resample_model == "systematic")
+        m_resample_model = PF_RESAMPLE_SYSTEMATIC;
+    else
+    {
+        yCWarning(AMCL_DEV,"Unknown resample model \"%s\"; defaulting to multinomial",
+            tmp_resample_model.c_str());
+        m_resample_model = PF_RESAMPLE_MULTINOMIAL;
+    }
+    m_random_seed = amcl_group.check("random_seed", Value(-1)).asInt();
      
     m_config.m_alpha_slow = amcl_group.check("recovery_alpha_slow", Value(0.001)).asDouble();
     m_config.m_alpha_fast = amcl_group.check("recovery_alpha_fast", Value(0.1)).asDouble();
     m_tf_broadcast = amcl_group.check("tf_broadcast", Value(true)).asBool();
+    m_config.m_laser_model_threads = amcl_group.check("laser_model_threads", Value(0)).asInt();
+    m_config.m_trace = amcl_group.check("trace", Value(false)).asBool();
+    m_config.m_laser_max_age = amcl_group.check("laser_max_age", Value(0.5)).asDouble();
+    m_config.m_range_table_angles = amcl_group.check("laser_range_table_angles", Value(0)).asInt();
+    m_config.m_range_table_file = amcl_group.check("laser_range_table_file", Value("")).asString();
+    m_config.m_range_table_max_mb = amcl_group.check("laser_range_table_max_mb", Value(512.0)).asDouble();
+    m_config.m_governor_enable = amcl_group.check("governor_enable", Value(false)).asBool();
+    m_config.m_governor_cpu_budget = amcl_group.check("governor_cpu_budget", Value(0.0)).asDouble();
+    m_config.m_governor_min_scale = amcl_group.check("governor_min_scale", Value(0.25)).asDouble();
+    m_config.m_governor_max_cov_xy = amcl_group.check("governor_max_cov_xy", Value(0.05)).asDouble();
+    m_config.m_governor_max_cov_theta = amcl_group.check("governor_max_cov_theta", Value(0.03)).asDouble();
 
     //get the map from the map_server
     Property map_options;
@@ -789,6 +994,7 @@ bool amclLocalizerThread::threadInit()
     }
 
     m_amcl_map = convertMap(m_yarp_map);
+    buildFreeCellIndex();
 
     if (m_handler_pf != nullptr)
     {
@@ -798,9 +1004,16 @@ bool amclLocalizerThread::threadInit()
     m_handler_pf = pf_alloc(m_config.m_min_particles, m_config.m_max_particles,
                             m_config.m_alpha_slow, m_config.m_alpha_fast,
                            (pf_init_model_fn_t)amclLocalizerThread::uniformPoseGenerator,
-                           (void *)m_amcl_map);
+                           (void *)this);
     m_handler_pf->pop_err = m_config.m_pf_err;
     m_handler_pf->pop_z = m_config.m_pf_z;
+    m_handler_pf->resample_model = m_resample_model;
+    //the hypotheses are read out at each update, one for each cluster
+    m_hyps.reserve(m_handler_pf->sets[0].cluster_max_count);
+    if (m_random_seed >= 0)
+    {
+        pf_seed(m_handler_pf, m_random_seed);
+    }
 
     // Initialize the filter
     pf_vector_t pf_init_pose_mean = pf_vector_zero();
@@ -829,79 +1042,96 @@ bool amclLocalizerThread::threadInit()
     m_handler_odom->SetModel(m_odom_model_type, m_config.m_alpha1, m_config.m_alpha2, m_config.m_alpha3, m_config.m_alpha4, m_config.m_alpha5);
 
     // Laser
-    if (m_handler_laser)
-    {
-        delete m_handler_laser;
-        m_handler_laser = 0;
-    }
-    m_handler_laser = new AMCLLaser(m_config.m_max_beams, m_amcl_map);
-    yAssert(m_handler_laser);
-    if (m_laser_model_type == LASER_MODEL_BEAM)
-    {
-        m_handler_laser->SetModelBeam(m_config.m_z_hit, m_config.m_z_short, m_config.m_z_max, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_lambda_short, 0.0);
-    }
-    else if (m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
-    {
-        yCInfo(AMCL_DEV,"Initializing likelihood field model; this can take some time on large maps...");
-        m_handler_laser->SetModelLikelihoodFieldProb(m_config.m_z_hit, m_config.m_z_rand, m_config.m_sigma_hit,
-            m_config.m_laser_likelihood_max_dist,
-            m_config.m_do_beamskip, m_config.m_beam_skip_distance,
-            m_config.m_beam_skip_threshold, m_config.m_beam_skip_error_threshold);
-        yCInfo(AMCL_DEV,"Done initializing likelihood field model with probabilities.");
-    }
-    else if (m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD)
+    m_laser_model_pool = std::make_shared<AMCLWorkerPool>(m_config.m_laser_model_threads);
+    yCInfo(AMCL_DEV, "Using %d threads to compute the weights of the particles", m_laser_model_pool->GetThreadCount());
+    if (m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB || m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD)
     {
+        //the distances from the obstacles are computed once, the models of all the lasers use them
         yCInfo(AMCL_DEV,"Initializing likelihood field model; this can take some time on large maps...");
-        m_handler_laser->SetModelLikelihoodField(m_config.m_z_hit, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_laser_likelihood_max_dist);
+        map_update_cspace(m_amcl_map, m_config.m_laser_likelihood_max_dist);
         yCInfo(AMCL_DEV,"Done initializing likelihood field model.");
     }
 
-    //opens the laser client and the corresponding interface
-    Property options;
-    options.put("device", "Rangefinder2DClient");
-    options.put("local", m_name + "/laser:i");
-    options.put("remote", m_laser_remote_port);
-    if (m_pLas.open(options) == false)
-    {
-        yCError(AMCL_DEV) << "Unable to open laser driver";
-        return false;
-    }
-    m_pLas.view(m_iLaser);
-    if (m_iLaser == 0)
+    //opens the laser clients and the corresponding interfaces
+    for (size_t i = 0; i < m_laser_devices.size(); i++)
     {
-        yCError(AMCL_DEV) << "Unable to open laser interface";
-        return false;
-    }
+        laser_device_t& laser = *m_laser_devices[i];
+        Property options;
+        options.put("device", "Rangefinder2DClient");
+        options.put("local", (i == 0) ? m_name + "/laser:i" : m_name + "/laser_" + std::to_string(i) + ":i");
+        options.put("remote", laser.remote_port);
+        if (laser.driver.open(options) == false)
+        {
+            yCError(AMCL_DEV) << "Unable to open laser driver" << laser.remote_port;
+            return false;
+        }
+        laser.driver.view(laser.iLaser);
+        if (laser.iLaser == 0)
+        {
+            yCError(AMCL_DEV) << "Unable to open laser interface" << laser.remote_port;
+            return false;
+        }
+        //optional: without timestamps, a scan is assumed to be taken when it is read
+        laser.driver.view(laser.iTimed);
 
-    if (m_iLaser->getScanLimits(m_min_laser_angle, m_max_laser_angle) == false)
-    {
-        yCError(AMCL_DEV) << "Unable to obtain laser scan limits (angles)";
-        return false;
-    }
+        if (laser.iLaser->getScanLimits(laser.min_laser_angle, laser.max_laser_angle) == false)
+        {
+            yCError(AMCL_DEV) << "Unable to obtain laser scan limits (angles)";
+            return false;
+        }
 
-    if (m_iLaser->getHorizontalResolution(m_horizontal_resolution) == false)
-    {
-        yCError(AMCL_DEV) << "Unable to getHorizontalResolution()";
-        return false;
+        if (laser.iLaser->getHorizontalResolution(laser.horizontal_resolution) == false)
+        {
+            yCError(AMCL_DEV) << "Unable to getHorizontalResolution()";
+            return false;
+        }
+
+        if (laser.iLaser->getDistanceRange(laser.min_laser_distance, laser.max_laser_distance) == false)
+        {
+            yCError(AMCL_DEV) << "Unable to obtain laser scan limits (distance)";
+            return false;
+        }
+
+        //each laser has its own model, with its pose and its number of beams
+        laser.model = createLaserModel(laser.max_beams > 0 ? laser.max_beams : (int)m_config.m_max_beams);
+        yCInfo(AMCL_DEV, "Laser %s: pose (%.3f %.3f %.1f), %d beams", laser.remote_port.c_str(),
+            laser.mounting_pose.v[0], laser.mounting_pose.v[1], laser.mounting_pose.v[2] * RAD2DEG,
+            laser.max_beams > 0 ? laser.max_beams : (int)m_config.m_max_beams);
     }
 
-    if (m_iLaser->getDistanceRange(m_min_laser_distance, m_max_laser_distance) == false)
+    //the beam model can read the expected ranges from a table instead of casting the rays
+    if (m_laser_model_type == LASER_MODEL_BEAM && m_config.m_range_table_angles > 0)
     {
-        yCError(AMCL_DEV) << "Unable to obtain laser scan limits (distance)";
-        return false;
+        buildRangeTable();
     }
 
-    m_laser_angle_of_view = fabs(m_min_laser_angle) + fabs(m_max_laser_angle);
-    
-    //@@@@ add an entry for each equipped laser device
-    m_lasers.push_back(new AMCLLaser(*m_handler_laser));
-    m_lasers_update.push_back(true);
-
     //@@@CHECK the position of this call
     this->initializeLocalization(m_initial_loc);
     return true;
 }
 
+AMCLLaser* amclLocalizerThread::createLaserModel(int max_beams)
+{
+    AMCLLaser* model = new AMCLLaser(max_beams, m_amcl_map);
+    model->SetWorkerPool(m_laser_model_pool);
+    if (m_laser_model_type == LASER_MODEL_BEAM)
+    {
+        model->SetModelBeam(m_config.m_z_hit, m_config.m_z_short, m_config.m_z_max, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_lambda_short, 0.0);
+    }
+    else if (m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD_PROB)
+    {
+        model->SetModelLikelihoodFieldProb(m_config.m_z_hit, m_config.m_z_rand, m_config.m_sigma_hit,
+            m_config.m_laser_likelihood_max_dist,
+            m_config.m_do_beamskip, m_config.m_beam_skip_distance,
+            m_config.m_beam_skip_threshold, m_config.m_beam_skip_error_threshold);
+    }
+    else if (m_laser_model_type == LASER_MODEL_LIKELIHOOD_FIELD)
+    {
+        model->SetModelLikelihoodField(m_config.m_z_hit, m_config.m_z_rand, m_config.m_sigma_hit, m_config.m_laser_likelihood_max_dist);
+    }
+    return model;
+}
+
 void amclLocalizerThread::threadRelease()
 {
     if (m_handler_odom)
@@ -909,10 +1139,11 @@ void amclLocalizerThread::threadRelease()
         delete m_handler_odom;
         m_handler_odom = nullptr;
     }
-    if (m_handler_laser)
+    for (auto& laser : m_laser_devices)
     {
-        delete m_handler_laser;
-        m_handler_laser = nullptr;
+        laser->driver.close();
+        delete laser->model;
+        laser->model = nullptr;
     }
 
     //@@@@@@@@@@@@@@must use its own alloc?
@@ -923,66 +1154,87 @@ void amclLocalizerThread::threadRelease()
     }
 }
 
-pf_vector_t amclLocalizerThread::uniformPoseGenerator(void* arg)
+pf_vector_t amclLocalizerThread::uniformPoseGenerator(void* arg, pf_rng_t* rng)
 {
-    map_t* map = (map_t*)arg;
-#if NEW_UNIFORM_SAMPLING
-    unsigned int rand_index = drand48() * free_space_indices.size();
-    std::pair<int, int> free_point = free_space_indices[rand_index];
-    pf_vector_t p;
-    p.v[0] = MAP_WXGX(map, free_point.first);
-    p.v[1] = MAP_WYGY(map, free_point.second);
-    p.v[2] = drand48() * 2 * M_PI - M_PI;
-#else
-    double min_x, max_x, min_y, max_y;
+    amclLocalizerThread* self = (amclLocalizerThread*)arg;
+    map_t* map = self->m_amcl_map;
+    pf_vector_t p = pf_vector_zero();
 
-    min_x = -(map->size_x * map->scale) / 2.0 + map->origin_x;
-    max_x = (map->size_x * map->scale) / 2.0 + map->origin_x;
-    min_y = -(map->size_y * map->scale) / 2.0 + map->origin_y;
-    max_y = (map->size_y * map->scale) / 2.0 + map->origin_y;
+    if (self->m_free_cells.empty())
+    {
+        yCError(AMCL_DEV) << "Problems in map data: no free cells found";
+        return p;
+    }
 
-    pf_vector_t p;
+    //pick a free cell, then a random position inside it
+    size_t rand_index = (size_t)(pf_rng_uniform(rng) * self->m_free_cells.size());
+    int index = self->m_free_cells[rand_index];
+    int i = index % map->size_x;
+    int j = index / map->size_x;
+    p.v[0] = MAP_WXGX(map, i) + (pf_rng_uniform(rng) - 0.5) * map->scale;
+    p.v[1] = MAP_WYGY(map, j) + (pf_rng_uniform(rng) - 0.5) * map->scale;
+    p.v[2] = pf_rng_uniform(rng) * 2 * M_PI - M_PI;
+    return p;
+}
 
-    yCDebug(AMCL_DEV,"Generating new uniform sample");
-    std::random_device rd;
-    std::mt19937 gen(rd());
-#if 0
-    std::uniform_real_distribution<double> dis_x(min_x, max_x);
-    std::uniform_real_distribution<double> dis_y(min_y, max_y);
-#else
-    if (max_x < min_x) std::swap(min_x, max_x);
-    std::uniform_real_distribution<double> dis_x(min_x, max_x);
+void amclLocalizerThread::buildRangeTable()
+{
+    //the table must cover the longest reading of all the lasers
+    double max_range = 0;
+    for (auto& laser : m_laser_devices)
+    {
+        double range = laser->max_laser_distance;
+        if (m_config.m_laser_max_range > 0.0)
+        {
+            range = std::min(range, m_config.m_laser_max_range);
+        }
+        max_range = std::max(max_range, range);
+    }
 
-    if (max_y < min_y) std::swap(min_y, max_y);
-    std::uniform_real_distribution<double> dis_y(min_y, max_y);
-#endif
-    std::uniform_real_distribution<double> dis_t(-M_PI, +M_PI);
-
-    for (size_t check_counter=0;; check_counter++)
-    {
-        //p.v[0] = min_x + drand48() * (max_x - min_x);
-        //p.v[1] = min_y + drand48() * (max_y - min_y);
-        //p.v[2] = drand48() * 2 * M_PI - M_PI;
-
-        p.v[0] = dis_x(gen);
-        p.v[1] = dis_y(gen);
-        p.v[2] = dis_t(gen);
-        // Check that it's a free cell
-        int i, j;
-        i = MAP_GXWX(map, p.v[0]);
-        j = MAP_GYWY(map, p.v[1]);
-        if (MAP_VALID(map, i, j) && (map->cells[MAP_INDEX(map, i, j)].occ_state == -1))
+    //limit on the size of the table, checked before allocating it
+    size_t max_size = m_config.m_range_table_max_mb > 0 ? (size_t)(m_config.m_range_table_max_mb * 1024 * 1024) : 0;
+    if (!m_config.m_range_table_file.empty() &&
+        map_load_range_table(m_amcl_map, m_config.m_range_table_file.c_str(), max_range, m_config.m_range_table_angles, max_size) == 0)
+    {
+        yCInfo(AMCL_DEV) << "Range table loaded from" << m_config.m_range_table_file;
+        return;
+    }
+
+    yCInfo(AMCL_DEV, "Computing the range table (%d directions up to %.2fm); this can take some time on large maps...",
+        m_config.m_range_table_angles, max_range);
+    double start = yarp::os::Time::now();
+    if (map_update_range_table(m_amcl_map, max_range, m_config.m_range_table_angles, max_size) != 0)
+    {
+        yCWarning(AMCL_DEV, "Unable to compute the range table (limit %.0fMB, see laser_range_table_max_mb), the ranges will be computed by ray casting",
+            m_config.m_range_table_max_mb);
+        return;
+    }
+    yCInfo(AMCL_DEV, "Range table computed in %.1fs", yarp::os::Time::now() - start);
+
+    if (!m_config.m_range_table_file.empty())
+    {
+        if (map_save_range_table(m_amcl_map, m_config.m_range_table_file.c_str()) == 0)
         {
-            break;
+            yCInfo(AMCL_DEV) << "Range table saved to" << m_config.m_range_table_file;
+        }
+        else
+        {
+            yCWarning(AMCL_DEV) << "Unable to save the range table to" << m_config.m_range_table_file;
         }
+    }
+}
 
-        if (check_counter > 10000)
+void amclLocalizerThread::buildFreeCellIndex()
+{
+    m_free_cells.clear();
+    for (int i = 0; i < m_amcl_map->size_x * m_amcl_map->size_y; i++)
+    {
+        if (m_amcl_map->occ_state[i] == -1)
         {
-            yCError(AMCL_DEV) << "Deadlock detected. Problems in map data: no free cells found";
+            m_free_cells.push_back(i);
         }
     }
-#endif
-    return p;
+    yCInfo(AMCL_DEV) << "Map has" << m_free_cells.size() << "free cells";
 }
 
 map_t* amclLocalizerThread::convertMap(MapGrid2D& yarp_map)
@@ -1000,8 +1252,8 @@ map_t* amclLocalizerThread::convertMap(MapGrid2D& yarp_map)
     map->origin_x = x_orig + (map->size_x / 2) * map->scale;
     map->origin_y = y_orig + (map->size_y / 2) * map->scale;
 
-    map->cells = (map_cell_t*)malloc(sizeof(map_cell_t)*map->size_x*map->size_y);
-    yAssert(map->cells);
+    map->occ_state = (int8_t*)malloc(sizeof(int8_t)*map->size_x*map->size_y);
+    yAssert(map->occ_state);
     //for (int i = 0; i<map->size_x * map->size_y; i++)
     for (int y = 0; y < map->size_y; y++)
         for (int x = 0; x < map->size_x; x++)
@@ -1014,27 +1266,27 @@ map_t* amclLocalizerThread::convertMap(MapGrid2D& yarp_map)
 
 #if 0
         if (occupancy == 0)
-            map->cells[i].occ_state = -1;
+            map->occ_state[i] = -1;
         else if (occupancy == 100)
-            map->cells[i].occ_state = +1;
+            map->occ_state[i] = +1;
         else
-            map->cells[i].occ_state = 0;
+            map->occ_state[i] = 0;
 #else
         //@@@@check me
         if (occupancy >= 0)
         {
             if (occupancy > 50)
             {
-                map->cells[i].occ_state = +1;
+                map->occ_state[i] = +1;
             }
             else
             {
-                map->cells[i].occ_state = -1;
+                map->occ_state[i] = -1;
             }
         }
         else
         {
-            map->cells[i].occ_state = 0;
+            map->occ_state[i] = 0;
         }
 #endif
 
@@ -20,8 +20,10 @@
 #include <yarp/os/PeriodicThread.h>
 #include <yarp/dev/PolyDriver.h>
 #include <yarp/dev/IRangefinder2D.h>
+#include <yarp/dev/IPreciselyTimed.h>
 #include <yarp/dev/IMap2D.h>
 #include <cmath>
+#include <memory>
 
 #include "./amcl/map/map.h"
 #include "./amcl/pf/pf.h"
@@ -119,18 +121,28 @@ protected:
     yarp::dev::Nav2D::IMap2D*    m_iMap;
     yarp::dev::Nav2D::MapGrid2D  m_yarp_map;
 
-    //laser client
-    yarp::dev::PolyDriver                        m_pLas;
-    yarp::dev::IRangefinder2D*                   m_iLaser;
-    std::vector<yarp::dev::LaserMeasurementData> m_laser_measurement_data;
-    double                                       m_laser_measurement_timestamp;
-    double                                       m_min_laser_angle;
-    double                                       m_max_laser_angle;
-    double                                       m_horizontal_resolution;
-    double                                       m_min_laser_distance;
-    double                                       m_max_laser_distance;
-    double                                       m_laser_angle_of_view;
-    std::string                                  m_laser_remote_port;
+    //laser clients, one for each rangefinder of the robot
+    struct laser_device_t
+    {
+        std::string                                  remote_port;
+        yarp::dev::PolyDriver                        driver;
+        yarp::dev::IRangefinder2D*                   iLaser = nullptr;
+        yarp::dev::IPreciselyTimed*                  iTimed = nullptr;
+        std::vector<yarp::dev::LaserMeasurementData> measurement_data;
+        double                                       measurement_timestamp = -1;
+        pf_vector_t                                  measurement_odom;  //odometry when the scan was received
+        double                                       min_laser_angle = 0;
+        double                                       max_laser_angle = 0;
+        double                                       horizontal_resolution = 0;
+        double                                       min_laser_distance = 0;
+        double                                       max_laser_distance = 0;
+        pf_vector_t                                  mounting_pose;     //pose in the base frame, theta in radians
+        int                                          max_beams = -1;
+        bool                                         update = true;     //the scan must be integrated at the next update
+        amcl::AMCLLaser*                             model = nullptr;
+        amcl::AMCLLaserData                          data;              //kept between the updates to avoid allocations
+    };
+    std::vector<std::unique_ptr<laser_device_t>> m_laser_devices;
 
     bool m_use_map_topic;
     bool m_first_map_only;
@@ -164,6 +176,17 @@ protected:
         double m_alpha_fast;
         double m_d_thresh;
         double m_a_thresh;
+        int    m_laser_model_threads;
+        bool   m_trace;
+        double m_laser_max_age;
+        int    m_range_table_angles;
+        std::string m_range_table_file;
+        double m_range_table_max_mb;
+        bool   m_governor_enable;
+        double m_governor_cpu_budget;
+        double m_governor_min_scale;
+        double m_governor_max_cov_xy;
+        double m_governor_max_cov_theta;
     } m_config;
 
     amcl::laser_model_t m_laser_model_type;
@@ -172,14 +195,14 @@ protected:
     std::string m_base_frame_id;
     std::string m_global_frame_id;
     int m_resample_interval;
+    pf_resample_model_t m_resample_model;
+    int m_random_seed;
     int m_resample_count;
-    std::vector< bool > m_lasers_update;
-    std::vector< amcl::AMCLLaser* > m_lasers;
 
     bool m_tf_broadcast;
 
     amcl::AMCLOdom*  m_handler_odom;
-    amcl::AMCLLaser* m_handler_laser;
+    std::shared_ptr<amcl::AMCLWorkerPool> m_laser_model_pool;
     bool             m_force_update;
 
     pf_t* m_handler_pf;
@@ -187,10 +210,40 @@ protected:
     pf_vector_t m_pf_odom_pose;
     amcl_hyp_t* m_initial_pose_hyp;
     map_t* m_amcl_map;
+    std::vector<int> m_free_cells;
+    std::vector<amcl_hyp_t> m_hyps;
+
+    //compute governor: fraction of the configured beams and particles currently used
+    double m_compute_scale;
+
+    //cost of the filter updates
+    std::mutex m_compute_stats_mutex;
+    struct compute_stats_t
+    {
+        double last_cpu_time = 0;     //CPU time of the last update, filter thread and workers [s]
+        double last_wall_time = 0;    //duration of the last update [s]
+        double total_cpu_time = 0;    //since the last statistics print
+        double max_cpu_time = 0;      //since the last statistics print
+        int    updates = 0;           //since the last statistics print
+        double scale = 1.0;
+        int    sample_limit = 0;
+    } m_compute_stats;
 
-    //all the estimated particles
-    std::mutex m_particle_poses_mutex;
-    std::vector<yarp::dev::Nav2D::Map2DLocation> m_particle_poses;
+public:
+    //snapshot of all the estimated particles. It is never modified after being published,
+    //so the readers can use it without locks while the filter prepares the next one.
+    struct particle_cloud_t
+    {
+        std::shared_ptr<const std::string> map_id;
+        std::vector<pf_vector_t>           poses;   //x, y [m], theta [rad]
+    };
+
+private:
+    //the published snapshot, accessed only with std::atomic_load() / std::atomic_store()
+    std::shared_ptr<const particle_cloud_t> m_particle_cloud;
+    //snapshots reused by the filter: the ones not referenced by anyone else are free
+    std::vector<std::shared_ptr<particle_cloud_t>> m_particle_cloud_pool;
+    std::shared_ptr<const std::string> m_particle_cloud_map_id;
 
     //the robot most probable position
     std::mutex                          m_localization_data_mutex;
@@ -209,10 +262,18 @@ public:
     bool initializeLocalization(const yarp::dev::Nav2D::Map2DLocation& loc, const yarp::sig::Matrix& cov);
     bool getCurrentLoc(yarp::dev::Nav2D::Map2DLocation& loc);
     bool getPoses(std::vector<yarp::dev::Nav2D::Map2DLocation>& poses);
+    std::shared_ptr<const particle_cloud_t> getParticleCloud();
+    void getComputeStats(double& last_cpu_time, double& last_wall_time, double& scale, int& sample_limit);
 
 private:
-    static pf_vector_t uniformPoseGenerator(void* arg);
+    static pf_vector_t uniformPoseGenerator(void* arg, pf_rng_t* rng);
+    void buildFreeCellIndex();
+    void buildRangeTable();
+    amcl::AMCLLaser* createLaserModel(int max_beams);
     map_t* convertMap(yarp::dev::Nav2D::MapGrid2D& yarp_map);
     void updateFilter();
+    bool integrateLaser(laser_device_t& laser, const pf_vector_t& pose);
+    void updateComputeBudget(double cpu_time, double wall_time);
+    void publishParticleCloud(pf_sample_set_t* set);
     void applyInitialPose();
 };
@@ -31,6 +31,7 @@
 #include <yarp/os/RateThread.h>
 #include <yarp/dev/IRangefinder2D.h>
 #include <string>
+#include <limits>
 #include <math.h>
 #include <yarp/math/Math.h>
 #include <yarp/math/Quaternion.h>
@@ -57,6 +58,13 @@ obstacles_class::obstacles_class(Searchable &rf)
     m_max_detection_distance = 1.5;
     m_min_detection_distance = 0.4;
     m_last_print_time = yarp::os::Time::now();
+    m_last_platform_print_time = 0;
+    m_angle_f = 0;
+    m_angle_t = 0;
+    m_angle_g = 0;
+    m_w_f = 0;
+    m_w_t = 0;
+    m_w_g = 0;
 
     /////////////////
     Bottle geometry_group = rf.findGroup("ROBOT_GEOMETRY");
@@ -110,21 +118,66 @@ obstacles_class::obstacles_class(Searchable &rf)
         m_speed_reduction_factor = obstacles_avoidance_group.check("speed_reduction_factor", Value(0.70)).asDouble();
 }
 
-//checks if a point is inside a polygon
-int obstacles_class::pnpoly(int nvert, double *vertx, double *verty, double testx, double testy)
+bool obstacles_class::load_scan(std::vector<LaserMeasurementData>& laser_data)
 {
-  int i, j, c = 0;
-  for (i = 0, j = nvert-1; i < nvert; j = i++)
-  {
-    if (( (verty[i]>testy) != (verty[j]>testy) ) &&
-          (testx < (vertx[j]-vertx[i]) * (testy-verty[i]) / (verty[j]-verty[i]) + vertx[i]) )
+    size_t las_size = laser_data.size();
+    if (las_size == 0)
     {
-       c = !c;
+        yCError(GOTO_OBSTACLES) << "Internal error, invalid laser data struct!";
+        return false;
+    }
+
+    if (m_scan_angle.size() != las_size)
+    {
+        m_scan_angle.assign(las_size, std::numeric_limits<double>::quiet_NaN());
+        m_scan_cos.resize(las_size);
+        m_scan_sin.resize(las_size);
+        m_scan_t.resize(las_size);
+        m_scan_d.resize(las_size);
+        m_scan_x.resize(las_size);
+        m_scan_y.resize(las_size);
+    }
+
+    for (size_t i = 0; i < las_size; i++)
+    {
+        double d = 0;
+        double angle = 0;
+        laser_data[i].get_polar(d, angle);
+        if (angle != m_scan_angle[i])
+        {
+            m_scan_angle[i] = angle;
+            m_scan_t[i] = float(angle);
+            m_scan_cos[i] = float(cos(angle));
+            m_scan_sin[i] = float(sin(angle));
+        }
+        m_scan_d[i] = float(d);
+        m_scan_x[i] = float(d) * m_scan_cos[i];
+        m_scan_y[i] = float(d) * m_scan_sin[i];
     }
-  }
-  return c;
+    return true;
 }
 
+void obstacles_class::update_obstacle_avoidance()
+{
+    //searches the nearest obstacle in the converted scan
+    const float* pd = m_scan_d.data();
+    const float* pt = m_scan_t.data();
+    const size_t las_size = m_scan_d.size();
+    const float blind_angle = float(m_frontal_blind_angle*DEG2RAD);
+    float min_distance = float(m_max_obstacle_distance);
+    float min_angle    = 0.0;
+    for (size_t i = 0; i < las_size; i++)
+    {
+        bool closer = (pd[i] < min_distance) && !(pt[i] >= -blind_angle && pt[i] <= blind_angle); //skip frontal obstacles
+        min_distance = closer ? pd[i] : min_distance;
+        min_angle    = closer ? pt[i] : min_angle;
+    }
+
+    m_angle_f = min_angle;
+    m_angle_t = m_angle_f + 90.0;
+    m_w_f = (1 - (min_distance / m_max_obstacle_distance)) / 2;
+    m_w_t = 0;
+}
 
 bool obstacles_class::compute_obstacle_avoidance(std::vector<LaserMeasurementData>& laser_data)
 {
@@ -156,51 +209,17 @@ bool obstacles_class::compute_obstacle_avoidance(std::vector<LaserMeasurementDat
 
     m_angle_g = goal_corrected;
 */
-    double min_distance = m_max_obstacle_distance;
-    double min_angle    = 0.0;
-
-    size_t las_size = laser_data.size();
-    if (las_size == 0)
+    if (load_scan(laser_data) == false)
     {
-        yCError(GOTO_OBSTACLES) << "Internal error, invalid laser data struct!";
         return false;
     }
 
-    for (size_t i = 0; i < las_size; i++)
-    {
-        double curr_d = 0;
-        double curr_angle = 0;
-        laser_data[i].get_polar(curr_d, curr_angle);
-
-        if (curr_angle >= 0 - m_frontal_blind_angle*DEG2RAD &&
-            curr_angle <= 0 + m_frontal_blind_angle*DEG2RAD) continue; //skip frontal obstacles
-
-        if (curr_d < min_distance)
-        {
-            min_distance = curr_d;
-            min_angle    = curr_angle;
-        }
-    }
-
-    m_angle_f = min_angle;
-    m_angle_t = m_angle_f + 90.0;
-    m_w_f = (1 - (min_distance / m_max_obstacle_distance)) / 2;
-    m_w_t = 0;
+    update_obstacle_avoidance();
     return true;
 }
 
-bool obstacles_class::check_obstacles_in_path(std::vector<LaserMeasurementData>& laser_data, double beta)
+bool obstacles_class::check_obstacles_in_path(std::vector<LaserMeasurementData>& laser_data, double beta, bool compute_avoidance)
 {
-    static double last_time_error_message = 0;
-    int laser_obstacles  = 0;
-    double goal_distance = 1000; //TO BE COMPLETED
-
-    //compute the polygon
-    double vx[4];
-    double vy[4];
-    double vertx[4];
-    double verty[4];
-
     //on the left the map reference frame, on the right the robot reference frame.
     //laser data is expressed in the robot reference frame
     //beta is expressed in the robot reference frame
@@ -225,99 +244,60 @@ bool obstacles_class::check_obstacles_in_path(std::vector<LaserMeasurementData>&
     if (detection_distance<m_min_detection_distance)
         detection_distance = m_min_detection_distance;
 
-    //these coordinates are in the robot reference frame
-#if 1
-    vx[0] = 0; vy[0] = +m_robot_radius;
-    vx[1] = 0; vy[1] = -m_robot_radius;
-    vx[2] = detection_distance; vy[2] = -m_robot_radius;
-    vx[3] = detection_distance; vy[3] = +m_robot_radius;
-#else
-    vx[0] = m_robot_radius; vy[0] = +m_robot_radius;
-    vx[1] = m_robot_radius; vy[1] = -m_robot_radius;
-    vx[2] = detection_distance; vy[2] = -m_robot_radius;
-    vx[3] = detection_distance; vy[3] = +m_robot_radius;
-#endif
-
-    //rotate the detection area according to the desired robot trajectory
-    vertx[0] = vx[0] * cbeta + vy[0] * (-sbeta);
-    verty[0] = vx[0] * sbeta + vy[0] * cbeta;
-    vertx[1] = vx[1] * cbeta + vy[1] * (-sbeta);
-    verty[1] = vx[1] * sbeta + vy[1] * cbeta;
-    vertx[2] = vx[2] * cbeta + vy[2] * (-sbeta);
-    verty[2] = vx[2] * sbeta + vy[2] * cbeta;
-    vertx[3] = vx[3] * cbeta + vy[3] * (-sbeta);
-    verty[3] = vx[3] * sbeta + vy[3] * cbeta;
-
-#if 0
-    yCDebug() << beta << "(" << vertx[0] << verty[0] << ")"
-    << "(" << vertx[1] << verty[1] << ")"
-    << "(" << vertx[2] << verty[2] << ")"
-    << "(" << vertx[3] << verty[3] << ")";
-#endif
-
-    size_t las_size = laser_data.size();
-
-    if (las_size == 0)
+    if (load_scan(laser_data) == false)
     {
-        yCError(GOTO_OBSTACLES) << "Internal error, invalid laser data struct!";
         return false;
     }
 
-    /*
-    //this piece of code checks that laser is expressed in the same robot reference frame
-    laser_data.clear();
-    LaserMeasurementData m;
-    m.set_polar(1, 1.5707);
-    double xx, yy;
-    m.get_cartesian(xx, yy); yCDebug() << xx << yy;
-    laser_data.push_back(m);
-    */
-
+    //the detection area is the rectangle [0, detection_distance] x [-robot_radius, +robot_radius], rotated by beta
+    //according to the desired robot trajectory. Instead of rotating the rectangle and testing each point against a
+    //generic polygon, each point is rotated by -beta and tested against the axis-aligned rectangle.
+    //The loop is branch-free and works on contiguous float arrays, so that it is vectorized by the compiler.
+    const float cb = float(cbeta);
+    const float sb = float(sbeta);
+    const float det = float(detection_distance);
+    const float radius = float(m_robot_radius);
+    const float* px = m_scan_x.data();
+    const float* py = m_scan_y.data();
+    const float* pd = m_scan_d.data();
+    const size_t las_size = m_scan_d.size();
+    int platform_obstacles = 0;
+    int path_obstacles = 0;
     for (size_t i = 0; i < las_size; i++)
     {
-        double d = 0;
-        double angle = 0;
-        laser_data[i].get_polar(d, angle);
+        int on_platform = (pd[i] < radius);
+        int in_path = in_detection_area(px[i], py[i], cb, sb, det, radius) & !on_platform;
+        platform_obstacles += on_platform;
+        path_obstacles += in_path;
+    }
 
-        if (d < m_robot_radius)
-        {
-            laser_obstacles++;
-            if (yarp::os::Time::now() - last_time_error_message > 0.3)
-            {
-                yCError(GOTO_OBSTACLES,"obstacles on the platform");
-                last_time_error_message = yarp::os::Time::now();
-            }
-            continue;
-        }
+    //the obstacle avoidance uses the same converted scan. Its search is kept in a separate loop because the search
+    //of the minimum (and of its angle) prevents the vectorization of the previous one.
+    if (compute_avoidance)
+    {
+        update_obstacle_avoidance();
+    }
 
-        double px = 0;
-        double py = 0;
-        //laser scans are in the robot reference frame
-        laser_data[i].get_cartesian(px, py);
-        //vertx and verty  are in the robot reference frame
-        if (pnpoly(4,vertx,verty,px,py)>0)
-        {
-            if (d < goal_distance)
-            {
-                laser_obstacles++;
-                //yCError("obstacles on the path");
-                continue;
-            }
-            else
-            {
-                //yCError("obstacles on the path, but goal is near");
-                continue;
-            }
-        }
+    if (platform_obstacles + path_obstacles == 0)
+    {
+        //no obstacles found
+        return false;
+    }
+
+    double now = yarp::os::Time::now();
+    if (platform_obstacles > 0 && now - m_last_platform_print_time > 0.3)
+    {
+        yCError(GOTO_OBSTACLES,"obstacles on the platform");
+        m_last_platform_print_time = now;
     }
 
     //prevent noise to be detected as an obstacle;
-    if (laser_obstacles>=2)
+    if (platform_obstacles + path_obstacles >= 2)
     {
-        if (yarp::os::Time::now() - m_last_print_time > 1.0)
+        if (now - m_last_print_time > 1.0)
         {
             yCWarning(GOTO_OBSTACLES,"obstacles detected");
-            m_last_print_time = yarp::os::Time::now();
+            m_last_print_time = now;
         }
         return true;
     }
@@ -42,6 +42,7 @@
 #include <string>
 #include <math.h>
 #include <mutex>
+#include <vector>
 #include <yarp/rosmsg/visualization_msgs/MarkerArray.h>
 #include <yarp/rosmsg/geometry_msgs/PoseStamped.h>
 #include <yarp/rosmsg/nav_msgs/Path.h>
@@ -63,6 +64,18 @@ private:
     double m_robot_laser_t;       //deg
 
     double m_last_print_time;
+    double m_last_platform_print_time;
+
+    //the laser scan, converted once per cycle in a structure of arrays (robot reference frame), so that all the checks
+    //are performed on contiguous memory. The trigonometric functions of the beams angles are cached, since they
+    //do not change between two scans of the same laser.
+    std::vector<double> m_scan_angle;
+    std::vector<float>  m_scan_cos;
+    std::vector<float>  m_scan_sin;
+    std::vector<float>  m_scan_t;
+    std::vector<float>  m_scan_d;
+    std::vector<float>  m_scan_x;
+    std::vector<float>  m_scan_y;
 public:
     //obstacles avoidance stop block
     double               m_max_obstacle_distance;
@@ -84,23 +97,41 @@ public:
 
 public:
     obstacles_class(Searchable  &rf);
-    //beta is the direction (in degrees) in which the robot wants to move, in the robot reference frame
-    bool check_obstacles_in_path(std::vector<LaserMeasurementData>& laser_data, double beta);
+    //beta is the direction (in degrees) in which the robot wants to move, in the robot reference frame.
+    //If compute_avoidance is true, the data required by the obstacle avoidance is also computed (see compute_obstacle_avoidance()) on the same converted scan
+    bool check_obstacles_in_path(std::vector<LaserMeasurementData>& laser_data, double beta, bool compute_avoidance = false);
     bool compute_obstacle_avoidance(std::vector<LaserMeasurementData>& laser_data);
     double get_max_time_waiting_for_obstacle_removal();
     void set_safety_coeff(double val);
 
+    /**
+    * Checks if a point is inside the detection area, i.e. the rectangle [0, detection_distance] x [-radius, +radius] rotated by beta.
+    * The point is rotated by -beta and tested against the axis-aligned rectangle. As in the crossing-number test used before,
+    * the edges u=0 and v=-radius belong to the area, while the edges u=detection_distance and v=+radius do not.
+    * @param x x-coordinate of the point, in the robot reference frame
+    * @param y y-coordinate of the point, in the robot reference frame
+    * @param cb cosine of beta
+    * @param sb sine of beta
+    * @return 1 if the point is inside the detection area, 0 otherwise
+    */
+    static inline int in_detection_area(float x, float y, float cb, float sb, float detection_distance, float radius)
+    {
+        float u = x * cb + y * sb;
+        float v = y * cb - x * sb;
+        return (u >= 0) & (u < detection_distance) & (v >= -radius) & (v < radius);
+    }
+
 private:
     /**
-    * Checks if a point is inside a n-sided polygons.
-    * @param testx x-coordinate of the point to be tested
-    * @param testy y-coordinate of the point to be tested
-    * @param nvert the number of vertices of the polygon
-    * @param vertx an array of size nvert containing the x-coordinates of all vertices
-    * @param verty an array of size nvert containing the y-coordinates of all vertices
-    * @return true if the requested point is inside the polygon, false otherwise
+    * Converts the laser scan in the internal structure of arrays.
+    * @return false if the scan is empty
+    */
+    bool load_scan(std::vector<LaserMeasurementData>& laser_data);
+
+    /**
+    * Updates the obstacle avoidance data from the converted scan, searching the nearest obstacle outside the frontal blind angle.
     */
-    int pnpoly(int nvert, double *vertx, double *verty, double testx, double testy);
+    void update_obstacle_avoidance();
 };
 
 #endif
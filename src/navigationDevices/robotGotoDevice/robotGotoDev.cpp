@@ -117,6 +117,35 @@ bool robotGotoDev  ::parse_respond_string(const yarp::os::Bottle& command, yarp:
         reply.addString("approach command received");
     }
 
+    else if (command.get(0).asString() == "waypoint_profile")
+    {
+        //tolerances, speed limits, gains and (optionally) the new target in a single command.
+        //The rpc handler holds the thread mutex, so everything is applied before the next control cycle.
+        if (command.check("linear_tol"))     { gotoThread->m_goal_tolerance_lin = command.find("linear_tol").asDouble(); }
+        if (command.check("angular_tol"))    { gotoThread->m_goal_tolerance_ang = command.find("angular_tol").asDouble(); }
+        if (command.check("max_lin_speed"))  { gotoThread->m_max_lin_speed = command.find("max_lin_speed").asDouble(); }
+        if (command.check("max_ang_speed"))  { gotoThread->m_max_ang_speed = command.find("max_ang_speed").asDouble(); }
+        if (command.check("min_lin_speed"))  { gotoThread->m_min_lin_speed = command.find("min_lin_speed").asDouble(); }
+        if (command.check("min_ang_speed"))  { gotoThread->m_min_ang_speed = command.find("min_ang_speed").asDouble(); }
+        if (command.check("ang_speed_gain")) { gotoThread->m_gain_ang = command.find("ang_speed_gain").asDouble(); }
+        if (command.check("lin_speed_gain")) { gotoThread->m_gain_lin = command.find("lin_speed_gain").asDouble(); }
+        Bottle target_group = command.findGroup("target");
+        if (target_group.size() == 3 || target_group.size() == 4)
+        {
+            yarp::sig::Vector v;
+            for (size_t i = 1; i < target_group.size(); i++)
+            {
+                v.push_back(target_group.get(i).asDouble());
+            }
+            gotoThread->setNewAbsTarget(v);
+        }
+        else if (target_group.isNull() == false)
+        {
+            yCError(GOTO_DEV) << "waypoint_profile: invalid target" << target_group.toString();
+        }
+        reply.addString("waypoint_profile set.");
+    }
+
     else if (command.get(0).asString() == "set")
     {
         if (command.get(1).asString() == "linear_tol")
@@ -314,6 +343,7 @@ bool robotGotoRPCHandler::respond(const yarp::os::Bottle& command, yarp::os::Bot
         reply.addString("set min_ang_speed <deg/s>");
         reply.addString("set obstacle_stop <0/1>");
         reply.addString("set obstacle_avoidance <0/1>");
+        reply.addString("waypoint_profile (linear_tol <m>) (angular_tol <deg>) (max_lin_speed <m/s>) (max_ang_speed <deg/s>) (min_lin_speed <m/s>) (min_ang_speed <deg/s>) (lin_speed_gain <gain>) (ang_speed_gain <gain>) (target <x> <y> [<theta>])");
     }
     else if (command.get(0).isString())
     {
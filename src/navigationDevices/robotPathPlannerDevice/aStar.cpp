@@ -1,4 +1,4 @@
-/* 
+/*
  * Copyright (C)2011  Department of Robotics Brain and Cognitive Sciences - Istituto Italiano di Tecnologia
  * Author: Marco Randazzo
  * email:  marco.randazzo@iit.it
@@ -22,8 +22,13 @@
 #include <yarp/os/Time.h>
 #include <yarp/sig/Vector.h>
 #include <string>
-#include <list>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
 #include <math.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include <yarp/dev/MapGrid2D.h>
 #include "aStar.h"
 
@@ -37,299 +42,686 @@ YARP_LOG_COMPONENT(PATHPLAN_ASTAR, "navigation.devices.robotPathPlanner.aStar")
 
 namespace aStar_algorithm
 {
-    //forward declaration for heuristic_cost_estimate function() 
-    class node_type;
-
     /**
-    * This method returns the cost to transverse a map from start node to goal node.
-    * @param start the start node
-    * @param goal the arrival node
+    * This method returns the cost to transverse a map from start cell to goal cell.
+    * @param sx, sy the start cell
+    * @param gx, gy the arrival cell
     * @return the cost (euclidean distance * 10)
     */
-    double heuristic_cost_estimate (node_type start, node_type goal);
+    inline double heuristic_cost_estimate(int sx, int sy, int gx, int gy);
 
-    //definition of a map node. It stores x,y information associated to a crossing cost
-    class node_type
-    {
-        public:
-        bool empty;
-        int x;
-        int y;
-        double g_score;
-        double f_score;
-        double s_score;
-        XYCell came_from;
-        node_type();
-        friend bool operator<  (const node_type &a, const node_type &b);
-    };
-
-    bool operator < (const node_type &a, const node_type &b);
-
-    //a node_map_type contains a square matrix of w*h cells, each cell is represented by a node_type with its associated cost
-    class node_map_type
+    /**
+    * Returns the cost of a straight move between two cells along one of the 8 directions (10 per straight step, 14 per diagonal step).
+    */
+    inline float octile_cost(int x1, int y1, int x2, int y2);
+
+    /**
+    * Returns true if the straight line that connects two cells does not contain any obstacle (Bresenham algorithm).
+    */
+    bool line_of_sight(const planner_workspace& ws, int x1, int y1, int x2, int y2);
+
+    /**
+    * JPS helpers: moving from (x,y) along direction (dx,dy), searches the next jump point.
+    * @return true if a jump point has been found, stored in (jx,jy)
+    */
+    bool jump_straight(const planner_workspace& ws, int x, int y, int dx, int dy, int gx, int gy, int& jx, int& jy);
+
+    /**
+    * Scans a row (or a column) of a bitmap along direction dir (+1/-1), starting from cell pos, searching for a jump point.
+    * @return true if a jump point has been found (stored in found_pos), false if an obstacle or the border of the map has been reached
+    */
+    bool scan_line(const cell_bitmap_type& bm, size_t line_length, size_t number_of_lines, int line, int pos, int dir, int goal_pos, int& found_pos);
+    inline uint64_t read_line(const cell_bitmap_type& bm, size_t line_start, int pos, size_t count, int dir);
+    inline uint64_t reverse_bits(uint64_t v, size_t count);
+    inline int count_trailing_zeros(uint64_t v);
+    bool jump(const planner_workspace& ws, int x, int y, int dx, int dy, int gx, int gy, int& jx, int& jy);
+};
+
+/////////// cell_bitmap_type
+void aStar_algorithm::cell_bitmap_type::resize(size_t number_of_cells)
+{
+    bits.assign((number_of_cells + 63) / 64, 0);
+}
+
+void aStar_algorithm::cell_bitmap_type::clear()
+{
+    std::fill(bits.begin(), bits.end(), 0);
+}
+
+uint64_t aStar_algorithm::cell_bitmap_type::read(size_t first, size_t count) const
+{
+    if (count == 0) return 0;
+    size_t word = first >> 6;
+    size_t offset = first & 63;
+    uint64_t v = bits[word] >> offset;
+    if (offset != 0 && offset + count > 64)
     {
-        public:
-        node_map_type();
-        node_map_type(yarp::dev::Nav2D::MapGrid2D& map);
-        ~node_map_type();
-
-        public:
-        size_t w;
-        size_t h;
-        node_type** nodes;
-    };
-
-    class ordered_set_type
+        v |= bits[word + 1] << (64 - offset);
+    }
+    if (count < 64) v &= (uint64_t(1) << count) - 1;
+    return v;
+}
+
+/////////// indexed_heap_type
+void aStar_algorithm::indexed_heap_type::resize(size_t number_of_cells)
+{
+    heap.clear();
+    keys.clear();
+    position.assign(number_of_cells, invalid_cell);
+}
+
+void aStar_algorithm::indexed_heap_type::clear()
+{
+    //only the cells still inside the heap have a valid position, so this is O(heap size)
+    for (size_t i = 0; i < heap.size(); i++)
     {
-        std::vector<node_type> set;
+        position[heap[i]] = invalid_cell;
+    }
+    heap.clear();
+    keys.clear();
+}
 
-        public:
-        void insert (const node_type& t);
-        node_type get_smallest();
-        void print();
-        size_t size();
-        bool find(node_type t);
-    };
+void aStar_algorithm::indexed_heap_type::swap_elems(size_t i, size_t j)
+{
+    std::swap(heap[i], heap[j]);
+    std::swap(keys[i], keys[j]);
+    position[heap[i]] = cell_index_type(i);
+    position[heap[j]] = cell_index_type(j);
+}
 
-    class unordered_set_type
+void aStar_algorithm::indexed_heap_type::sift_up(size_t i)
+{
+    while (i > 0)
     {
-        std::vector<node_type> set;
+        size_t parent = (i - 1) / 2;
+        if (keys[parent] <= keys[i]) break;
+        swap_elems(i, parent);
+        i = parent;
+    }
+}
 
-        public:
-        void insert (const node_type& t);
-        bool find(node_type t);
-    };
-};
+void aStar_algorithm::indexed_heap_type::sift_down(size_t i)
+{
+    size_t n = heap.size();
+    while (true)
+    {
+        size_t smallest = i;
+        size_t l = 2 * i + 1;
+        size_t r = 2 * i + 2;
+        if (l < n && keys[l] < keys[smallest]) smallest = l;
+        if (r < n && keys[r] < keys[smallest]) smallest = r;
+        if (smallest == i) break;
+        swap_elems(i, smallest);
+        i = smallest;
+    }
+}
 
-/////// node_type
-aStar_algorithm::node_type::node_type()
+void aStar_algorithm::indexed_heap_type::push_or_decrease(cell_index_type cell, double key)
 {
-    empty=true;
-    x=0; 
-    y=0;
-    s_score=0;
-    g_score=0;
-    f_score=0;
-    came_from.x=-1;
-    came_from.y=-1;
+    cell_index_type i = position[cell];
+    if (i == invalid_cell)
+    {
+        heap.push_back(cell);
+        keys.push_back(key);
+        position[cell] = cell_index_type(heap.size() - 1);
+        sift_up(heap.size() - 1);
+    }
+    else if (key < keys[i])
+    {
+        keys[i] = key;
+        sift_up(i);
+    }
 }
 
-bool aStar_algorithm::operator < (const node_type &a, const node_type &b)
+aStar_algorithm::cell_index_type aStar_algorithm::indexed_heap_type::pop_smallest()
 {
-    return (a.f_score>b.f_score);
+    cell_index_type cell = heap.front();
+    swap_elems(0, heap.size() - 1);
+    heap.pop_back();
+    keys.pop_back();
+    position[cell] = invalid_cell;
+    if (!heap.empty()) sift_down(0);
+    return cell;
 }
 
-/////////// node_map_type
-aStar_algorithm::node_map_type::node_map_type(MapGrid2D& map)
+/////////// planner_workspace
+aStar_algorithm::planner_workspace::planner_workspace()
 {
-    w = map.width();
-    h = map.height();
-    nodes = new node_type* [w];
-    for (int i = 0; i < w; ++i)  nodes[i] = new node_type[h];
+    w = 0;
+    h = 0;
+    generation = 2;
+    map_revision = 0;
+}
 
-    for (int y=0; y<h; y++)
-        for (int x=0; x<w; x++)
+void aStar_algorithm::planner_workspace::build(const MapGrid2D& map)
+{
+    size_t number_of_cells = map.width() * map.height();
+    map_revision++;
+    if (map.width() != w || map.height() != h)
+    {
+        w = map.width();
+        h = map.height();
+        free_cells.resize(number_of_cells);
+        free_cells_transposed.resize(number_of_cells);
+        g_score.assign(number_of_cells, 0);
+        came_from.assign(number_of_cells, invalid_cell);
+        stamp.assign(number_of_cells, 0);
+        open_set.resize(number_of_cells);
+        generation = 2;
+    }
+    else
+    {
+        free_cells.clear();
+        free_cells_transposed.clear();
+    }
+
+    for (size_t y = 0; y < h; y++)
+        for (size_t x = 0; x < w; x++)
+            if (map.isFree(XYCell(x, y)))
             {
-                if (map.isFree(XYCell(x, y)))
-                    nodes [x][y].empty = true;
-                else
-                    nodes [x][y].empty = false;
-                nodes [x][y].x = x;
-                nodes [x][y].y = y;
-                //--- ---
-                //s_score is disabled by default.
-                //it is can be associated to a particular color code, to generate
-                //smooth trajectories,i.e.: keep the robot away from walls, using
-                //map skeletonization. The algorithm performances are still to be checked.
-                //nodes [x][y].s_score = 230-imgMat.at<cv::Vec3b>(y,x)[1];
-                //--- ---
-                nodes [x][y].s_score = 0;
+                free_cells.set(y * w + x);
+                free_cells_transposed.set(x * h + y);
             }
 }
 
-aStar_algorithm::node_map_type::~node_map_type()
+void aStar_algorithm::planner_workspace::set_occupied(XYCell cell)
+{
+    if (cell.x < w && cell.y < h)
+    {
+        free_cells.reset(cell.y * w + cell.x);
+        free_cells_transposed.reset(cell.x * h + cell.y);
+    }
+}
+
+void aStar_algorithm::planner_workspace::new_search()
+{
+    open_set.clear();
+    path_buffer.clear();
+    //stamps of the previous search are now smaller than generation, i.e. not valid anymore
+    generation += 2;
+    if (generation >= std::numeric_limits<uint32_t>::max() - 2)
+    {
+        //very unlikely, it happens once every 2^31 searches
+        std::fill(stamp.begin(), stamp.end(), 0);
+        generation = 2;
+    }
+}
+
+/////////// various
+inline double aStar_algorithm::heuristic_cost_estimate(int sx, int sy, int gx, int gy)
+{
+    //estimate the cost from start to goal
+    double dist = sqrt(double((sx - gx)*(sx - gx) +
+                              (sy - gy)*(sy - gy))) * 10;
+    return dist;
+}
+
+inline float aStar_algorithm::octile_cost(int x1, int y1, int x2, int y2)
+{
+    int dx = abs(x2 - x1);
+    int dy = abs(y2 - y1);
+    return float(14 * std::min(dx, dy) + 10 * (std::max(dx, dy) - std::min(dx, dy)));
+}
+
+bool aStar_algorithm::string_to_algorithm(const std::string& name, search_algorithm_type& algorithm)
+{
+    if      (name == "astar")      { algorithm = search_algorithm_type::astar; }
+    else if (name == "jps")        { algorithm = search_algorithm_type::jps; }
+    else if (name == "theta_star") { algorithm = search_algorithm_type::theta_star; }
+    else if (name == "dstar_lite") { algorithm = search_algorithm_type::dstar_lite; }
+    else if (name == "hpa_star")   { algorithm = search_algorithm_type::hpa_star; }
+    else return false;
+    return true;
+}
+
+std::string aStar_algorithm::algorithm_to_string(search_algorithm_type algorithm)
+{
+    switch (algorithm)
+    {
+        case search_algorithm_type::astar:      return "astar";
+        case search_algorithm_type::jps:        return "jps";
+        case search_algorithm_type::theta_star: return "theta_star";
+        case search_algorithm_type::dstar_lite: return "dstar_lite";
+        case search_algorithm_type::hpa_star:   return "hpa_star";
+    }
+    return "unknown";
+}
+
+bool aStar_algorithm::find_astar_path(MapGrid2D& map, XYCell start, XYCell goal, std::deque<XYCell>& path)
+{
+    planner_workspace workspace;
+    workspace.build(map);
+    return find_astar_path(workspace, start, goal, path);
+}
+
+bool aStar_algorithm::find_astar_path(planner_workspace& ws, XYCell start, XYCell goal, std::deque<XYCell>& path)
 {
-    for (int i = 0; i < w; ++i) delete[] nodes[i];
-    delete[] nodes;
+    //implementation of A* algorithm
+    const int w = (int)ws.width();
+    const int sx = (int)start.x;
+    const int sy = (int)start.y;
+    const int gx = (int)goal.x;
+    const int gy = (int)goal.y;
+
+    //checks that start and goal cells are inside the grid map
+    if (!ws.is_inside(sx, sy) || !ws.is_inside(gx, gy)) return false;
+
+    ws.new_search();
+    const cell_index_type start_idx = ws.index(sx, sy);
+    const cell_index_type goal_idx = ws.index(gx, gy);
+
+    //neighbors offsets and their associated cost (10 for straight moves, 14 for diagonal moves)
+    static const int   nb_dx[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+    static const int   nb_dy[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+    static const float nb_cost[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+
+    ws.set_g(start_idx, 0, invalid_cell);
+    ws.open_set.push_or_decrease(start_idx, heuristic_cost_estimate(sx, sy, gx, gy));
+
+    while (!ws.open_set.empty())
+    {
+        cell_index_type curr = ws.open_set.pop_smallest();
+
+        if (curr == goal_idx)
+        {
+            for (cell_index_type c = goal_idx; c != start_idx; c = ws.get_parent(c))
+            {
+                ws.path_buffer.push_back(XYCell(c % w, c / w));
+            }
+
+            //reverse the path
+            for (auto it = ws.path_buffer.rbegin(); it != ws.path_buffer.rend(); it++)
+            {
+                path.push_back(*it);
+            }
+            return true;
+        }
+
+        ws.close(curr);
+        const int cx = int(curr % w);
+        const int cy = int(curr / w);
+        const float curr_g = ws.get_g(curr);
+
+        //process the list of neighbors
+        for (int n = 0; n < 8; n++)
+        {
+            const int nx = cx + nb_dx[n];
+            const int ny = cy + nb_dy[n];
+            if (!ws.is_free(nx, ny)) continue;
+
+            const cell_index_type neighbor = ws.index(nx, ny);
+            if (ws.is_closed(neighbor)) continue;
+
+            float tentative_g_score = curr_g + nb_cost[n];
+            if (tentative_g_score < ws.get_g(neighbor))
+            {
+                ws.set_g(neighbor, tentative_g_score, curr);
+                ws.open_set.push_or_decrease(neighbor, tentative_g_score + heuristic_cost_estimate(nx, ny, gx, gy));
+            }
+        }
+    }
+
+    //no path found
+    return false;
 }
 
-/////////// ordered_set_type
-void aStar_algorithm::ordered_set_type::insert (const node_type& t)
+bool aStar_algorithm::line_of_sight(const planner_workspace& ws, int x1, int y1, int x2, int y2)
 {
-    set.push_back(t);
-    push_heap (set.begin(),set.end()); 
+    //same Bresenham algorithm used by map_utilites::checkStraightLine()
+    int dx = abs(x2 - x1);
+    int dy = abs(y2 - y1);
+    int err = dx - dy;
+    int sx = (x1 < x2) ? 1 : -1;
+    int sy = (y1 < y2) ? 1 : -1;
+
+    while (1)
+    {
+        if (ws.is_free(x1, y1) == false) return false;
+        if (x1 == x2 && y1 == y2) break;
+        int e2 = err * 2;
+        if (e2 > -dy)
+        {
+            err = err - dy;
+            x1 += sx;
+        }
+        if (e2 < dx)
+        {
+            err = err + dx;
+            y1 += sy;
+        }
+    }
+    return true;
 }
 
-aStar_algorithm::node_type aStar_algorithm::ordered_set_type::get_smallest()
+inline int aStar_algorithm::count_trailing_zeros(uint64_t v)
 {
-    node_type t = set.front();
-    pop_heap (set.begin(),set.end());
-    set.pop_back();
-    return t;
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return int(i);
+#else
+    return __builtin_ctzll(v);
+#endif
 }
-void aStar_algorithm::ordered_set_type::print()
+
+inline uint64_t aStar_algorithm::reverse_bits(uint64_t v, size_t count)
 {
-    yCDebug(PATHPLAN_ASTAR,"front (smallest)%f \n", set.front().f_score);
-    for (unsigned int i=0; i<set.size(); i++)
-        yCDebug(PATHPLAN_ASTAR, "id%d x%d y%d %f\n", i, set[i].x, set[i].y, set[i].f_score);
-    yCDebug(PATHPLAN_ASTAR, "back (biggest) %f \n", set.back().f_score);
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+    v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+    v = (v >> 32) | (v << 32);
+    return v >> (64 - count);
 }
 
-size_t aStar_algorithm::ordered_set_type::size()
+inline uint64_t aStar_algorithm::read_line(const cell_bitmap_type& bm, size_t line_start, int pos, size_t count, int dir)
 {
-    return set.size();
+    if (dir > 0) return bm.read(line_start + pos, count);
+    return reverse_bits(bm.read(line_start + pos - count + 1, count), count);
 }
 
-bool aStar_algorithm::ordered_set_type::find(node_type t)
+bool aStar_algorithm::scan_line(const cell_bitmap_type& bm, size_t line_length, size_t number_of_lines, int line, int pos, int dir, int goal_pos, int& found_pos)
 {
-    for (unsigned int i=0; i<set.size(); i++)
+    //The cells of the line are examined in blocks of 63: bit i of each block refers to the cell pos+dir*i.
+    //The scan stops on the first occupied cell or on the first cell with a forced neighbor, i.e. a cell
+    //for which the adjacent cell on a side line is occupied, while the next one along the direction of motion is free.
+    const size_t line_start = size_t(line) * line_length;
+    const bool has_prev = line > 0;
+    const bool has_next = size_t(line) + 1 < number_of_lines;
+    while (pos >= 0 && size_t(pos) < line_length)
     {
-        if (set[i].x == t.x &&
-            set[i].y == t.y)
+        size_t available = (dir > 0) ? (line_length - pos) : size_t(pos + 1);
+        size_t n = std::min<size_t>(63, available);
+        size_t m = std::min<size_t>(n + 1, available);
+        uint64_t c = read_line(bm, line_start, pos, n, dir);
+        uint64_t a = has_prev ? read_line(bm, line_start - line_length, pos, m, dir) : 0;
+        uint64_t b = has_next ? read_line(bm, line_start + line_length, pos, m, dir) : 0;
+        uint64_t stop = (~c | (~a & (a >> 1)) | (~b & (b >> 1))) & ((uint64_t(1) << n) - 1);
+        if (goal_pos >= 0)
+        {
+            int d = (goal_pos - pos) * dir;
+            if (d >= 0 && size_t(d) < n) stop |= (uint64_t(1) << d);
+        }
+        if (stop != 0)
+        {
+            int i = count_trailing_zeros(stop);
+            if (((c >> i) & 1) == 0) return false;
+            found_pos = pos + dir * i;
             return true;
+        }
+        pos += dir * int(n);
     }
     return false;
 }
 
-/////////// unordered_set_type
-void aStar_algorithm::unordered_set_type::insert (const node_type& t)
+bool aStar_algorithm::jump_straight(const planner_workspace& ws, int x, int y, int dx, int dy, int gx, int gy, int& jx, int& jy)
 {
-    set.push_back(t);
+    //diagonal moves are allowed also between two occupied cells (as in find_astar_path()),
+    //so a cell has a forced neighbor when an obstacle is adjacent to it, orthogonally to the direction of motion.
+    //Horizontal moves scan the rows bitmap, vertical moves scan the columns bitmap.
+    if (!ws.is_inside(x, y)) return false;
+    int found;
+    if (dy == 0)
+    {
+        if (!scan_line(ws.rows(), ws.width(), ws.height(), y, x, dx, (gy == y) ? gx : -1, found)) return false;
+        jx = found;
+        jy = y;
+    }
+    else
+    {
+        if (!scan_line(ws.columns(), ws.height(), ws.width(), x, y, dy, (gx == x) ? gy : -1, found)) return false;
+        jx = x;
+        jy = found;
+    }
+    return true;
 }
-    
-bool aStar_algorithm::unordered_set_type::find(node_type t)
+
+bool aStar_algorithm::jump(const planner_workspace& ws, int x, int y, int dx, int dy, int gx, int gy, int& jx, int& jy)
 {
-    for (unsigned int i=0; i<set.size(); i++)
+    if (dx == 0 || dy == 0) return jump_straight(ws, x, y, dx, dy, gx, gy, jx, jy);
+
+    int tx, ty;
+    while (ws.is_free(x, y))
     {
-        if (set[i].x == t.x &&
-            set[i].y == t.y)
+        if ((x == gx && y == gy) ||
+            (ws.is_free(x - dx, y + dy) && !ws.is_free(x - dx, y)) ||
+            (ws.is_free(x + dx, y - dy) && !ws.is_free(x, y - dy)) ||
+            jump_straight(ws, x + dx, y, dx, 0, gx, gy, tx, ty) ||
+            jump_straight(ws, x, y + dy, 0, dy, gx, gy, tx, ty))
+        {
+            jx = x;
+            jy = y;
             return true;
+        }
+        x += dx;
+        y += dy;
     }
     return false;
 }
 
-/////////// various
-bool aStar_algorithm::find_astar_path(MapGrid2D& map, XYCell start, XYCell goal, std::deque<XYCell>& path)
+bool aStar_algorithm::find_jps_path(planner_workspace& ws, XYCell start, XYCell goal, std::deque<XYCell>& path)
 {
-    //implementation of A* algorithm
-    std::vector<XYCell> inverse_path;
-    node_map_type node_map(map);
-    int sx=start.x;
-    int sy=start.y;
-    int gx=goal.x;
-    int gy=goal.y;
+    //implementation of Jump Point Search (Harabor and Grastien, 2011)
+    const int w = (int)ws.width();
+    const int sx = (int)start.x;
+    const int sy = (int)start.y;
+    const int gx = (int)goal.x;
+    const int gy = (int)goal.y;
 
     //checks that start and goal cells are inside the grid map
-    if (sx>node_map.w || gx>node_map.w) return false;
-    if (sy>node_map.h || gy>node_map.h) return false;
-    if (sx<0  || gx<0) return false;
-    if (sy<0  || gy<0) return false;
+    if (!ws.is_inside(sx, sy) || !ws.is_inside(gx, gy)) return false;
+
+    ws.new_search();
+    const cell_index_type start_idx = ws.index(sx, sy);
+    const cell_index_type goal_idx = ws.index(gx, gy);
 
-    unordered_set_type closed_set;
-    ordered_set_type   open_set;  
+    static const int nb_dx[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+    static const int nb_dy[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
 
-    open_set.insert(node_map.nodes[sx][sy]);
-    
-    node_map.nodes[sx][sy].g_score = 0;
-    node_map.nodes[sx][sy].f_score = node_map.nodes[sx][sy].g_score + heuristic_cost_estimate(node_map.nodes[sx][sy], node_map.nodes[gx][gy]);
+    ws.set_g(start_idx, 0, invalid_cell);
+    ws.open_set.push_or_decrease(start_idx, heuristic_cost_estimate(sx, sy, gx, gy));
 
-    int iterations=0;
-    while (open_set.size()>0)
+    while (!ws.open_set.empty())
     {
-        iterations++;
-        //yCDebug ("%d\n", iterations++);
-        //open_set.print();
-        node_type curr=open_set.get_smallest();
-        
-        if (curr.x==goal.x &&
-            curr.y==goal.y) 
+        cell_index_type curr = ws.open_set.pop_smallest();
+
+        if (curr == goal_idx)
+        {
+            //jump points are connected by straight lines along one of the 8 directions: the intermediate cells are added back
+            for (cell_index_type c = goal_idx; c != start_idx; c = ws.get_parent(c))
             {
-                XYCell c;
-                c.x=goal.x;
-                c.y=goal.y;
-                while (!(c.x==start.x && c.y==start.y))
+                int cx = int(c % w);
+                int cy = int(c / w);
+                cell_index_type p = ws.get_parent(c);
+                int px = int(p % w);
+                int py = int(p / w);
+                int dx = (px > cx) - (px < cx);
+                int dy = (py > cy) - (py < cy);
+                for (; cx != px || cy != py; cx += dx, cy += dy)
                 {
-                    inverse_path.push_back(c);
-                    int old_cx = c.x;
-                    int old_cy = c.y;
-                    c.x = node_map.nodes[old_cx][old_cy].came_from.x;
-                    c.y = node_map.nodes[old_cx][old_cy].came_from.y;
+                    ws.path_buffer.push_back(XYCell(cx, cy));
                 }
+            }
 
-                //reverse the path
-                for (auto it= inverse_path.rbegin(); it!=inverse_path.rend(); it++)
+            //reverse the path
+            for (auto it = ws.path_buffer.rbegin(); it != ws.path_buffer.rend(); it++)
+            {
+                path.push_back(*it);
+            }
+            return true;
+        }
+
+        ws.close(curr);
+        const int cx = int(curr % w);
+        const int cy = int(curr / w);
+        const float curr_g = ws.get_g(curr);
+
+        //computes the list of the pruned neighbors, i.e. the directions to be explored
+        int dirs_x[8];
+        int dirs_y[8];
+        int ndirs = 0;
+        cell_index_type parent = ws.get_parent(curr);
+        if (parent == invalid_cell)
+        {
+            for (int n = 0; n < 8; n++) { dirs_x[ndirs] = nb_dx[n]; dirs_y[ndirs] = nb_dy[n]; ndirs++; }
+        }
+        else
+        {
+            int px = int(parent % w);
+            int py = int(parent / w);
+            int dx = (cx > px) - (cx < px);
+            int dy = (cy > py) - (cy < py);
+            if (dx != 0 && dy != 0)
+            {
+                dirs_x[ndirs] = 0;  dirs_y[ndirs] = dy; ndirs++;
+                dirs_x[ndirs] = dx; dirs_y[ndirs] = 0;  ndirs++;
+                dirs_x[ndirs] = dx; dirs_y[ndirs] = dy; ndirs++;
+                if (!ws.is_free(cx - dx, cy)) { dirs_x[ndirs] = -dx; dirs_y[ndirs] = dy; ndirs++; }
+                if (!ws.is_free(cx, cy - dy)) { dirs_x[ndirs] = dx; dirs_y[ndirs] = -dy; ndirs++; }
+            }
+            else if (dx != 0)
+            {
+                dirs_x[ndirs] = dx; dirs_y[ndirs] = 0; ndirs++;
+                if (!ws.is_free(cx, cy + 1)) { dirs_x[ndirs] = dx; dirs_y[ndirs] = 1; ndirs++; }
+                if (!ws.is_free(cx, cy - 1)) { dirs_x[ndirs] = dx; dirs_y[ndirs] = -1; ndirs++; }
+            }
+            else
+            {
+                dirs_x[ndirs] = 0; dirs_y[ndirs] = dy; ndirs++;
+                if (!ws.is_free(cx + 1, cy)) { dirs_x[ndirs] = 1; dirs_y[ndirs] = dy; ndirs++; }
+                if (!ws.is_free(cx - 1, cy)) { dirs_x[ndirs] = -1; dirs_y[ndirs] = dy; ndirs++; }
+            }
+        }
+
+        //process the successors (i.e. the jump points found along each direction)
+        for (int n = 0; n < ndirs; n++)
+        {
+            int jx, jy;
+            if (!jump(ws, cx + dirs_x[n], cy + dirs_y[n], dirs_x[n], dirs_y[n], gx, gy, jx, jy)) continue;
+
+            const cell_index_type successor = ws.index(jx, jy);
+            if (ws.is_closed(successor)) continue;
+
+            float tentative_g_score = curr_g + octile_cost(cx, cy, jx, jy);
+            if (tentative_g_score < ws.get_g(successor))
+            {
+                ws.set_g(successor, tentative_g_score, curr);
+                ws.open_set.push_or_decrease(successor, tentative_g_score + heuristic_cost_estimate(jx, jy, gx, gy));
+            }
+        }
+    }
+
+    //no path found
+    return false;
+}
+
+bool aStar_algorithm::find_thetastar_path(planner_workspace& ws, XYCell start, XYCell goal, std::deque<XYCell>& path)
+{
+    //implementation of Lazy Theta* (Nash et al., 2010): the line of sight between a cell and the parent of its
+    //predecessor is optimistically assumed when the cell is generated and verified only once, when the cell is expanded.
+    const int w = (int)ws.width();
+    const int sx = (int)start.x;
+    const int sy = (int)start.y;
+    const int gx = (int)goal.x;
+    const int gy = (int)goal.y;
+
+    //checks that start and goal cells are inside the grid map
+    if (!ws.is_inside(sx, sy) || !ws.is_inside(gx, gy)) return false;
+
+    ws.new_search();
+    const cell_index_type start_idx = ws.index(sx, sy);
+    const cell_index_type goal_idx = ws.index(gx, gy);
+
+    static const int   nb_dx[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+    static const int   nb_dy[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+    static const float nb_cost[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+
+    ws.set_g(start_idx, 0, invalid_cell);
+    ws.open_set.push_or_decrease(start_idx, heuristic_cost_estimate(sx, sy, gx, gy));
+
+    while (!ws.open_set.empty())
+    {
+        cell_index_type curr = ws.open_set.pop_smallest();
+        const int cx = int(curr % w);
+        const int cy = int(curr / w);
+
+        //verifies the line of sight with the parent. If it is missing, the best already expanded neighbor is chosen as parent.
+        cell_index_type parent = ws.get_parent(curr);
+        if (parent != invalid_cell && !line_of_sight(ws, int(parent % w), int(parent / w), cx, cy))
+        {
+            float best_g = std::numeric_limits<float>::infinity();
+            cell_index_type best_parent = invalid_cell;
+            for (int n = 0; n < 8; n++)
+            {
+                const int nx = cx + nb_dx[n];
+                const int ny = cy + nb_dy[n];
+                if (!ws.is_inside(nx, ny)) continue;
+                const cell_index_type neighbor = ws.index(nx, ny);
+                if (!ws.is_closed(neighbor)) continue;
+                float g = ws.get_g(neighbor) + nb_cost[n];
+                if (g < best_g)
                 {
-                    path.push_back(*it);
+                    best_g = g;
+                    best_parent = neighbor;
                 }
-                return true;
             }
+            ws.set_g(curr, best_g, best_parent);
+            parent = best_parent;
+        }
 
-        closed_set.insert(curr);
+        if (curr == goal_idx)
+        {
+            for (cell_index_type c = goal_idx; c != start_idx; c = ws.get_parent(c))
+            {
+                ws.path_buffer.push_back(XYCell(c % w, c / w));
+            }
 
-        //computes the list of neighbors of the current node
-        list<node_type> neighbors;
-        //yCDebug ("%d %d \n", curr.x, curr.y);
-        if (node_map.nodes[curr.x][curr.y + 1].empty)   neighbors.push_back(node_map.nodes[curr.x][curr.y + 1]);
-        if (node_map.nodes[curr.x][curr.y - 1].empty)   neighbors.push_back(node_map.nodes[curr.x][curr.y - 1]);
-        if (node_map.nodes[curr.x + 1][curr.y].empty)   neighbors.push_back(node_map.nodes[curr.x + 1][curr.y]);
-        if (node_map.nodes[curr.x - 1][curr.y].empty)   neighbors.push_back(node_map.nodes[curr.x - 1][curr.y]);
-        if (node_map.nodes[curr.x + 1][curr.y + 1].empty) neighbors.push_back(node_map.nodes[curr.x + 1][curr.y + 1]);
-        if (node_map.nodes[curr.x + 1][curr.y - 1].empty) neighbors.push_back(node_map.nodes[curr.x + 1][curr.y - 1]);
-        if (node_map.nodes[curr.x - 1][curr.y + 1].empty) neighbors.push_back(node_map.nodes[curr.x - 1][curr.y + 1]);
-        if (node_map.nodes[curr.x - 1][curr.y - 1].empty) neighbors.push_back(node_map.nodes[curr.x - 1][curr.y - 1]);
+            //reverse the path
+            for (auto it = ws.path_buffer.rbegin(); it != ws.path_buffer.rend(); it++)
+            {
+                path.push_back(*it);
+            }
+            return true;
+        }
 
-        //process the list of neighbors
-        while(neighbors.size()>0)
+        ws.close(curr);
+        const float curr_g = ws.get_g(curr);
+        const int px = (parent != invalid_cell) ? int(parent % w) : cx;
+        const int py = (parent != invalid_cell) ? int(parent / w) : cy;
+        const float parent_g = (parent != invalid_cell) ? ws.get_g(parent) : curr_g;
+
+        for (int n = 0; n < 8; n++)
         {
-            node_type neighbor = neighbors.front();
+            const int nx = cx + nb_dx[n];
+            const int ny = cy + nb_dy[n];
+            if (!ws.is_free(nx, ny)) continue;
+
+            const cell_index_type neighbor = ws.index(nx, ny);
+            if (ws.is_closed(neighbor)) continue;
 
-            if (closed_set.find(neighbor) || !neighbor.empty)
+            //the neighbor is linked directly to the parent of the current cell (the line of sight is checked later)
+            float tentative_g_score;
+            cell_index_type tentative_parent;
+            if (parent != invalid_cell)
             {
-                neighbors.pop_front();
-                continue;
+                tentative_g_score = parent_g + float(heuristic_cost_estimate(px, py, nx, ny));
+                tentative_parent = parent;
             }
-            
-            int nx = neighbor.x;
-            int ny = neighbor.y;
-            double tentative_g_score=0;
-            if (neighbor.empty)
+            else
             {
-                // add the distance between curr and neigh
-                if ( (nx==curr.x+1 && ny==curr.y   ) ||
-                     (nx==curr.x-1 && ny==curr.y   ) ||
-                     (nx==curr.x   && ny==curr.y+1 ) ||
-                     (nx==curr.x   && ny==curr.y-1 ) ) tentative_g_score = curr.g_score + 10 + curr.s_score;
-                else 
-                    tentative_g_score = curr.g_score + 14 + curr.s_score;     
+                tentative_g_score = curr_g + nb_cost[n];
+                tentative_parent = curr;
             }
-            else
-                tentative_g_score = curr.g_score + 1e10 + curr.s_score;
-            
-            bool b = open_set.find(neighbor);
-            if (!b || tentative_g_score < node_map.nodes[nx][ny].g_score)
+
+            if (tentative_g_score < ws.get_g(neighbor))
             {
-                node_map.nodes[nx][ny].came_from.x = curr.x;
-                node_map.nodes[nx][ny].came_from.y = curr.y;
-                node_map.nodes[nx][ny].g_score = tentative_g_score;
-                node_map.nodes[nx][ny].f_score = node_map.nodes[nx][ny].g_score + heuristic_cost_estimate(node_map.nodes[neighbor.x][neighbor.y], node_map.nodes[gx][gy]);
-                if (!b)
-                {
-                    open_set.insert(node_map.nodes[nx][ny]);
-                }
+                ws.set_g(neighbor, tentative_g_score, tentative_parent);
+                ws.open_set.push_or_decrease(neighbor, tentative_g_score + heuristic_cost_estimate(nx, ny, gx, gy));
             }
-            neighbors.pop_front();
         }
-    };
+    }
 
     //no path found
     return false;
 }
-
-double aStar_algorithm::heuristic_cost_estimate (node_type start, node_type goal)
-{
-    //estimate the cost from start to goal
-    double dist = sqrt ( double((start.x-goal.x)*(start.x-goal.x) +
-                                (start.y-goal.y)*(start.y-goal.y)))*10;
-    return dist;
-}
-
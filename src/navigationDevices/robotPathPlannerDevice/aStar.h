@@ -23,12 +23,171 @@
 
 #include <vector>
 #include <queue>
+#include <limits>
+#include <cstdint>
+#include <string>
 
 //! namespace containing a complete implementation of the classic A* algorithm
 namespace aStar_algorithm
 {
+    //the search algorithms available to compute a path
+    enum class search_algorithm_type
+    {
+        astar = 0,       //classic 8-connected A*
+        jps = 1,         //Jump Point Search: same paths of A*, much less expanded nodes on uniform-cost maps
+        theta_star = 2,  //any-angle Theta*: the path contains only its vertices, connected by straight lines
+        dstar_lite = 3,  //incremental D* Lite: the search tree is kept and repaired when new obstacles are added (see dStarLite.h)
+        hpa_star = 4     //hierarchical HPA*: the search is performed on a precomputed graph of clusters, then refined (see hpaStar.h)
+    };
+
+    /**
+    * Converts the name of an algorithm (astar, jps, theta_star, dstar_lite, hpa_star) to the corresponding enum.
+    * @return false if the name is not recognized
+    */
+    bool string_to_algorithm(const std::string& name, search_algorithm_type& algorithm);
+    std::string algorithm_to_string(search_algorithm_type algorithm);
+
+    //index of a cell inside the flat storage of the map, computed as y*width+x
+    typedef uint32_t cell_index_type;
+    const cell_index_type invalid_cell = std::numeric_limits<cell_index_type>::max();
+
+    //packed bitmap, one bit per cell of the map. Used to store the free/occupied status of the cells.
+    class cell_bitmap_type
+    {
+        std::vector<uint64_t> bits;
+
+        public:
+        void resize(size_t number_of_cells);
+        void clear();
+        inline bool test(size_t cell) const { return (bits[cell >> 6] >> (cell & 63)) & 1; }
+        inline void set(size_t cell)         { bits[cell >> 6] |= (uint64_t(1) << (cell & 63)); }
+        inline void reset(size_t cell)       { bits[cell >> 6] &= ~(uint64_t(1) << (cell & 63)); }
+
+        //returns count (<=64) consecutive bits, starting from cell first, which is stored in the least significant bit
+        uint64_t read(size_t first, size_t count) const;
+    };
+
+    //indexed binary min-heap of cells, keyed by their f_score.
+    //Since the position of each cell inside the heap is tracked, the membership test is O(1)
+    //and the f_score of a cell already in the open set can be decreased in O(log n).
+    class indexed_heap_type
+    {
+        std::vector<cell_index_type> heap;
+        std::vector<double>          keys;
+        std::vector<cell_index_type> position;
+
+        void sift_up(size_t i);
+        void sift_down(size_t i);
+        void swap_elems(size_t i, size_t j);
+
+        public:
+        void   resize(size_t number_of_cells);
+        void   clear();
+        bool   empty() const { return heap.empty(); }
+        size_t size() const { return heap.size(); }
+        bool   contains(cell_index_type cell) const { return position[cell] != invalid_cell; }
+        void   push_or_decrease(cell_index_type cell, double key);
+        cell_index_type pop_smallest();
+    };
+
+    /**
+    * Persistent storage used by the search algorithm. It is sized once per map (see build()) and
+    * then reused by all the subsequent searches. The costs and the parents of the cells are stored in
+    * flat arrays (struct-of-arrays layout); they are invalidated at the beginning of each search
+    * by incrementing a generation counter, so that a reset costs O(1) instead of O(map size).
+    */
+    class planner_workspace
+    {
+        public:
+        planner_workspace();
+
+        /**
+        * Reads the free cells of the map. Memory is reallocated only if the size of the map has changed.
+        * @param map the gridmap containing the obstacles
+        */
+        void build(const yarp::dev::Nav2D::MapGrid2D& map);
+
+        /**
+        * Marks a cell as not traversable (e.g. a new obstacle), without rebuilding the whole workspace.
+        * @param cell the cell to be marked
+        */
+        void set_occupied(yarp::dev::Nav2D::XYCell cell);
+
+        /**
+        * Invalidates the costs computed by the previous search.
+        */
+        void new_search();
+
+        inline size_t width() const  { return w; }
+        inline size_t height() const { return h; }
+        inline bool   empty() const  { return w == 0 || h == 0; }
+        //incremented by each build(), used by the incremental planners to detect that the map has been reloaded
+        inline size_t revision() const { return map_revision; }
+        inline bool   is_inside(int x, int y) const { return x >= 0 && y >= 0 && x < int(w) && y < int(h); }
+        inline bool   is_free(int x, int y) const { return is_inside(x, y) && free_cells.test(size_t(y) * w + x); }
+        inline cell_index_type index(int x, int y) const { return cell_index_type(size_t(y) * w + x); }
+
+        //free cells stored by rows (index y*w+x) and by columns (index x*h+y), used by JPS to scan 64 cells at once
+        inline const cell_bitmap_type& rows() const    { return free_cells; }
+        inline const cell_bitmap_type& columns() const { return free_cells_transposed; }
+
+        inline bool   is_closed(cell_index_type c) const { return stamp[c] == generation + 1; }
+        inline float  get_g(cell_index_type c) const { return (stamp[c] >= generation) ? g_score[c] : std::numeric_limits<float>::infinity(); }
+        inline cell_index_type get_parent(cell_index_type c) const { return came_from[c]; }
+        inline void   set_g(cell_index_type c, float g, cell_index_type parent) { if (stamp[c] < generation) stamp[c] = generation; g_score[c] = g; came_from[c] = parent; }
+        inline void   close(cell_index_type c) { stamp[c] = generation + 1; }
+
+        public:
+        indexed_heap_type               open_set;
+        std::vector<yarp::dev::Nav2D::XYCell> path_buffer;
+
+        private:
+        size_t                          w;
+        size_t                          h;
+        cell_bitmap_type                free_cells;
+        cell_bitmap_type                free_cells_transposed;
+        std::vector<float>              g_score;
+        std::vector<cell_index_type>    came_from;
+        std::vector<uint32_t>           stamp;
+        uint32_t                        generation;
+        size_t                          map_revision;
+    };
+
     /**
     * This method computes (if exists) the path required to go from a start cell to a goal cell
+    * @param workspace the workspace containing the obstacles, previously built from a gridmap
+    * @param start the start cell(x,y)
+    * @param goal the arrival cell(x,y)
+    * @param path the computed sequence of cells required to go from  start cell to goal cell
+    * @return true if the path exists, false if no valid path has been found
+    */
+    bool find_astar_path(planner_workspace& workspace, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, std::deque<yarp::dev::Nav2D::XYCell>& path);
+
+    /**
+    * Same as find_astar_path(), but using Jump Point Search. The returned path is the same sequence of adjacent cells
+    * computed by A*, but only the jump points are expanded during the search.
+    * @param workspace the workspace containing the obstacles, previously built from a gridmap
+    * @param start the start cell(x,y)
+    * @param goal the arrival cell(x,y)
+    * @param path the computed sequence of cells required to go from  start cell to goal cell
+    * @return true if the path exists, false if no valid path has been found
+    */
+    bool find_jps_path(planner_workspace& workspace, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, std::deque<yarp::dev::Nav2D::XYCell>& path);
+
+    /**
+    * Computes an any-angle path using Theta*. Differently from find_astar_path(), the returned path contains only
+    * the vertices of the path (each of them is in line of sight with the previous one), so it does not need to be simplified.
+    * @param workspace the workspace containing the obstacles, previously built from a gridmap
+    * @param start the start cell(x,y)
+    * @param goal the arrival cell(x,y)
+    * @param path the computed sequence of vertices required to go from  start cell to goal cell
+    * @return true if the path exists, false if no valid path has been found
+    */
+    bool find_thetastar_path(planner_workspace& workspace, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, std::deque<yarp::dev::Nav2D::XYCell>& path);
+
+    /**
+    * This method computes (if exists) the path required to go from a start cell to a goal cell.
+    * A temporary workspace is built from the map: prefer the previous method when multiple searches are performed on the same map.
     * @param map the gridmap containing the obstacles
     * @param start the start cell(x,y)
     * @param goal the arrival cell(x,y)
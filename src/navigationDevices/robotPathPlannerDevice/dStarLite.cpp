@@ -0,0 +1,425 @@
+/* 
+ * Copyright (C)2017  iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Marco Randazzo
+ * email:  marco.randazzo@iit.it
+ * website: www.robotcub.org
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <limits>
+#include <algorithm>
+#include <cstdlib>
+#include "dStarLite.h"
+
+using namespace std;
+using namespace yarp::dev;
+using namespace yarp::dev::Nav2D;
+using namespace aStar_algorithm;
+using namespace dStarLite_algorithm;
+
+YARP_LOG_COMPONENT(PATHPLAN_DSTAR, "navigation.devices.robotPathPlanner.dStarLite")
+
+namespace
+{
+    const float infinite_cost = std::numeric_limits<float>::infinity();
+
+    //neighbors offsets and their associated cost (10 for straight moves, 14 for diagonal moves), same as find_astar_path()
+    const int   nb_dx[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+    const int   nb_dy[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+    const float nb_cost[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+}
+
+/////////// key_heap_type
+void dStarLite_algorithm::key_heap_type::resize(size_t number_of_cells)
+{
+    heap.clear();
+    keys.clear();
+    position.assign(number_of_cells, invalid_cell);
+}
+
+void dStarLite_algorithm::key_heap_type::clear()
+{
+    for (size_t i = 0; i < heap.size(); i++)
+    {
+        position[heap[i]] = invalid_cell;
+    }
+    heap.clear();
+    keys.clear();
+}
+
+void dStarLite_algorithm::key_heap_type::swap_elems(size_t i, size_t j)
+{
+    std::swap(heap[i], heap[j]);
+    std::swap(keys[i], keys[j]);
+    position[heap[i]] = cell_index_type(i);
+    position[heap[j]] = cell_index_type(j);
+}
+
+void dStarLite_algorithm::key_heap_type::sift_up(size_t i)
+{
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!(keys[i] < keys[parent])) break;
+        swap_elems(i, parent);
+        i = parent;
+    }
+}
+
+void dStarLite_algorithm::key_heap_type::sift_down(size_t i)
+{
+    size_t n = heap.size();
+    while (true)
+    {
+        size_t smallest = i;
+        size_t l = 2 * i + 1;
+        size_t r = 2 * i + 2;
+        if (l < n && keys[l] < keys[smallest]) smallest = l;
+        if (r < n && keys[r] < keys[smallest]) smallest = r;
+        if (smallest == i) break;
+        swap_elems(i, smallest);
+        i = smallest;
+    }
+}
+
+key_type dStarLite_algorithm::key_heap_type::top_key() const
+{
+    if (heap.empty())
+    {
+        key_type k = { infinite_cost, infinite_cost };
+        return k;
+    }
+    return keys.front();
+}
+
+void dStarLite_algorithm::key_heap_type::insert_or_update(cell_index_type cell, key_type key)
+{
+    cell_index_type i = position[cell];
+    if (i == invalid_cell)
+    {
+        heap.push_back(cell);
+        keys.push_back(key);
+        position[cell] = cell_index_type(heap.size() - 1);
+        sift_up(heap.size() - 1);
+    }
+    else
+    {
+        keys[i] = key;
+        sift_up(i);
+        sift_down(position[cell]);
+    }
+}
+
+void dStarLite_algorithm::key_heap_type::remove(cell_index_type cell)
+{
+    cell_index_type i = position[cell];
+    if (i == invalid_cell) return;
+    size_t last = heap.size() - 1;
+    if (i != last) swap_elems(i, last);
+    heap.pop_back();
+    keys.pop_back();
+    position[cell] = invalid_cell;
+    if (i < heap.size())
+    {
+        //the element moved in position i can be either smaller or greater than the removed one
+        cell_index_type moved = heap[i];
+        sift_up(i);
+        sift_down(position[moved]);
+    }
+}
+
+/////////// dstar_lite_planner
+dStarLite_algorithm::dstar_lite_planner::dstar_lite_planner()
+{
+    m_ws = nullptr;
+    m_map_revision = 0;
+    m_w = 0;
+    m_h = 0;
+    m_goal = invalid_cell;
+    m_start = invalid_cell;
+    m_km = 0;
+    m_generation = 1;
+    m_last_expansions = 0;
+}
+
+inline float dStarLite_algorithm::dstar_lite_planner::get_g(cell_index_type c) const
+{
+    return (m_stamp[c] == m_generation) ? m_g[c] : infinite_cost;
+}
+
+inline float dStarLite_algorithm::dstar_lite_planner::get_rhs(cell_index_type c) const
+{
+    return (m_stamp[c] == m_generation) ? m_rhs[c] : infinite_cost;
+}
+
+inline void dStarLite_algorithm::dstar_lite_planner::touch(cell_index_type c)
+{
+    //cells not visited during the current search tree have g=rhs=infinite
+    if (m_stamp[c] != m_generation)
+    {
+        m_stamp[c] = m_generation;
+        m_g[c] = infinite_cost;
+        m_rhs[c] = infinite_cost;
+    }
+}
+
+inline float dStarLite_algorithm::dstar_lite_planner::heuristic(cell_index_type a, cell_index_type b) const
+{
+    //octile distance: consistent with the 10/14 costs of the moves, as required by D* Lite
+    int dx = abs(int(a % m_w) - int(b % m_w));
+    int dy = abs(int(a / m_w) - int(b / m_w));
+    return float(14 * std::min(dx, dy) + 10 * (std::max(dx, dy) - std::min(dx, dy)));
+}
+
+inline key_type dStarLite_algorithm::dstar_lite_planner::calculate_key(cell_index_type c) const
+{
+    float m = std::min(get_g(c), get_rhs(c));
+    key_type k = { m + heuristic(m_start, c) + m_km, m };
+    return k;
+}
+
+float dStarLite_algorithm::dstar_lite_planner::best_successor_cost(cell_index_type c, cell_index_type* best) const
+{
+    //the search is backward, so the successors of c are its free neighbors, i.e. the cells towards which the robot can move
+    const int cx = int(c % m_w);
+    const int cy = int(c / m_w);
+    float best_cost = infinite_cost;
+    for (int n = 0; n < 8; n++)
+    {
+        const int nx = cx + nb_dx[n];
+        const int ny = cy + nb_dy[n];
+        if (!m_ws->is_free(nx, ny)) continue;
+        const cell_index_type s = m_ws->index(nx, ny);
+        float cost = nb_cost[n] + get_g(s);
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            if (best) *best = s;
+        }
+    }
+    return best_cost;
+}
+
+void dStarLite_algorithm::dstar_lite_planner::update_vertex(cell_index_type c)
+{
+    if (get_g(c) != get_rhs(c))
+    {
+        m_queue.insert_or_update(c, calculate_key(c));
+    }
+    else
+    {
+        m_queue.remove(c);
+    }
+}
+
+void dStarLite_algorithm::dstar_lite_planner::update_rhs_and_vertex(cell_index_type c)
+{
+    if (c == m_goal) return;
+    touch(c);
+    m_rhs[c] = best_successor_cost(c);
+    update_vertex(c);
+}
+
+bool dStarLite_algorithm::dstar_lite_planner::is_valid_for(const planner_workspace& workspace, XYCell goal) const
+{
+    return m_ws == &workspace &&
+           m_map_revision == workspace.revision() &&
+           m_w == workspace.width() && m_h == workspace.height() &&
+           m_goal != invalid_cell && m_goal == workspace.index(int(goal.x), int(goal.y));
+}
+
+bool dStarLite_algorithm::dstar_lite_planner::initialize(const planner_workspace& workspace, XYCell goal)
+{
+    m_ws = &workspace;
+    m_map_revision = workspace.revision();
+    m_goal = invalid_cell;
+    m_start = invalid_cell;
+    m_km = 0;
+    if (!workspace.is_inside(int(goal.x), int(goal.y))) return false;
+
+    if (workspace.width() != m_w || workspace.height() != m_h)
+    {
+        m_w = workspace.width();
+        m_h = workspace.height();
+        size_t number_of_cells = m_w * m_h;
+        m_g.assign(number_of_cells, infinite_cost);
+        m_rhs.assign(number_of_cells, infinite_cost);
+        m_stamp.assign(number_of_cells, 0);
+        m_queue.resize(number_of_cells);
+        m_generation = 1;
+    }
+    else
+    {
+        m_queue.clear();
+        //all the values of the previous search tree are invalidated in O(1)
+        m_generation++;
+        if (m_generation == std::numeric_limits<uint32_t>::max())
+        {
+            std::fill(m_stamp.begin(), m_stamp.end(), 0);
+            m_generation = 1;
+        }
+    }
+
+    m_goal = workspace.index(int(goal.x), int(goal.y));
+    touch(m_goal);
+    m_rhs[m_goal] = 0;
+    //the start is not known yet: a null key is a lower bound of the real one, it will be corrected by compute_shortest_path()
+    key_type k = { 0, 0 };
+    m_queue.insert_or_update(m_goal, k);
+    return true;
+}
+
+void dStarLite_algorithm::dstar_lite_planner::update_cells(const std::vector<XYCell>& changed_cells)
+{
+    //nothing has been computed yet, the workspace will be read by the first compute_path()
+    if (m_start == invalid_cell || m_goal == invalid_cell) return;
+
+    for (size_t i = 0; i < changed_cells.size(); i++)
+    {
+        const int cx = int(changed_cells[i].x);
+        const int cy = int(changed_cells[i].y);
+        if (!m_ws->is_inside(cx, cy)) continue;
+
+        //the cost of the edges entering the changed cell is modified, so the rhs of all its neighbors must be recomputed
+        for (int n = 0; n < 8; n++)
+        {
+            const int nx = cx + nb_dx[n];
+            const int ny = cy + nb_dy[n];
+            if (!m_ws->is_inside(nx, ny)) continue;
+            update_rhs_and_vertex(m_ws->index(nx, ny));
+        }
+    }
+}
+
+void dStarLite_algorithm::dstar_lite_planner::compute_shortest_path()
+{
+    while (m_queue.top_key() < calculate_key(m_start) || get_rhs(m_start) != get_g(m_start))
+    {
+        const cell_index_type u = m_queue.top();
+        const key_type k_old = m_queue.top_key();
+        const key_type k_new = calculate_key(u);
+        m_last_expansions++;
+
+        if (k_old < k_new)
+        {
+            //the key is outdated (the robot moved since it was computed)
+            m_queue.insert_or_update(u, k_new);
+            continue;
+        }
+
+        const int ux = int(u % m_w);
+        const int uy = int(u / m_w);
+        //the predecessors of u are its neighbors, but only if u is free (otherwise no one can move into it)
+        const bool u_traversable = m_ws->is_free(ux, uy);
+
+        if (get_g(u) > get_rhs(u))
+        {
+            //overconsistent cell: its cost decreased
+            m_g[u] = m_rhs[u];
+            m_queue.remove(u);
+            if (!u_traversable) continue;
+            for (int n = 0; n < 8; n++)
+            {
+                const int nx = ux + nb_dx[n];
+                const int ny = uy + nb_dy[n];
+                if (!m_ws->is_inside(nx, ny)) continue;
+                const cell_index_type s = m_ws->index(nx, ny);
+                if (s == m_goal) continue;
+                touch(s);
+                float cost = nb_cost[n] + m_g[u];
+                if (cost < m_rhs[s])
+                {
+                    m_rhs[s] = cost;
+                    update_vertex(s);
+                }
+            }
+        }
+        else
+        {
+            //underconsistent cell: its cost increased, all the cells which were relying on it must be recomputed
+            const float g_old = m_g[u];
+            m_g[u] = infinite_cost;
+            if (u_traversable)
+            {
+                for (int n = 0; n < 8; n++)
+                {
+                    const int nx = ux + nb_dx[n];
+                    const int ny = uy + nb_dy[n];
+                    if (!m_ws->is_inside(nx, ny)) continue;
+                    const cell_index_type s = m_ws->index(nx, ny);
+                    if (s == m_goal) continue;
+                    if (get_rhs(s) == nb_cost[n] + g_old)
+                    {
+                        update_rhs_and_vertex(s);
+                    }
+                }
+            }
+            if (u != m_goal && get_rhs(u) == g_old)
+            {
+                update_rhs_and_vertex(u);
+            }
+            else
+            {
+                update_vertex(u);
+            }
+        }
+    }
+}
+
+bool dStarLite_algorithm::dstar_lite_planner::compute_path(XYCell start, std::deque<XYCell>& path)
+{
+    m_last_expansions = 0;
+    if (m_goal == invalid_cell || m_ws == nullptr) return false;
+    if (!m_ws->is_inside(int(start.x), int(start.y))) return false;
+
+    const cell_index_type new_start = m_ws->index(int(start.x), int(start.y));
+    if (m_start != invalid_cell)
+    {
+        //the robot moved: all the keys in the queue are lowered by the same amount, which is added to km instead
+        m_km += heuristic(m_start, new_start);
+    }
+    m_start = new_start;
+    touch(m_start);
+
+    compute_shortest_path();
+
+    if (get_g(m_start) == infinite_cost)
+    {
+        //no path found
+        return false;
+    }
+
+    //the path is obtained by following the cheapest successor of each cell, until the goal is reached
+    std::deque<XYCell> tmp_path;
+    cell_index_type curr = m_start;
+    const size_t max_steps = m_w * m_h;
+    while (curr != m_goal)
+    {
+        cell_index_type next = invalid_cell;
+        if (best_successor_cost(curr, &next) == infinite_cost || next == invalid_cell || tmp_path.size() > max_steps)
+        {
+            yCError(PATHPLAN_DSTAR) << "D* Lite: unable to extract a valid path from the search tree";
+            return false;
+        }
+        tmp_path.push_back(XYCell(next % m_w, next / m_w));
+        curr = next;
+    }
+
+    for (auto it = tmp_path.begin(); it != tmp_path.end(); it++)
+    {
+        path.push_back(*it);
+    }
+    return true;
+}
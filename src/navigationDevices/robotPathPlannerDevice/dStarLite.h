@@ -0,0 +1,134 @@
+/* 
+ * Copyright (C)2017  iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Marco Randazzo
+ * email:  marco.randazzo@iit.it
+ * website: www.robotcub.org
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+#ifndef D_STAR_LITE_H
+#define D_STAR_LITE_H
+
+#include <yarp/dev/MapGrid2D.h>
+
+#include <vector>
+#include <deque>
+#include "aStar.h"
+
+//! namespace containing an implementation of the D* Lite incremental search algorithm (Koenig and Likhachev, 2002)
+namespace dStarLite_algorithm
+{
+    //priority of a cell in the D* Lite queue, compared lexicographically
+    struct key_type
+    {
+        float k1;
+        float k2;
+        bool operator < (const key_type& other) const { return (k1 < other.k1) || (k1 == other.k1 && k2 < other.k2); }
+    };
+
+    //indexed binary min-heap of cells. Differently from aStar_algorithm::indexed_heap_type, the key of an element
+    //can be both increased and decreased, and an element can be removed from the middle of the heap.
+    class key_heap_type
+    {
+        std::vector<aStar_algorithm::cell_index_type> heap;
+        std::vector<key_type>                         keys;
+        std::vector<aStar_algorithm::cell_index_type> position;
+
+        void sift_up(size_t i);
+        void sift_down(size_t i);
+        void swap_elems(size_t i, size_t j);
+
+        public:
+        void     resize(size_t number_of_cells);
+        void     clear();
+        bool     empty() const { return heap.empty(); }
+        bool     contains(aStar_algorithm::cell_index_type cell) const { return position[cell] != aStar_algorithm::invalid_cell; }
+        key_type top_key() const;
+        aStar_algorithm::cell_index_type top() const { return heap.front(); }
+        void     insert_or_update(aStar_algorithm::cell_index_type cell, key_type key);
+        void     remove(aStar_algorithm::cell_index_type cell);
+    };
+
+    /**
+    * D* Lite planner. The search is performed backward, from the goal to the robot, and the search tree is kept between two
+    * calls of compute_path(). When new obstacles are notified through update_cells(), only the part of the tree affected
+    * by the change is repaired, so that a replan costs time proportional to the change instead of to the size of the map.
+    * The obstacles are read from a aStar_algorithm::planner_workspace, which must be kept updated by the caller.
+    */
+    class dstar_lite_planner
+    {
+        public:
+        dstar_lite_planner();
+
+        /**
+        * Checks if the search tree can be reused for a new request.
+        * @return true if the tree was built for the same goal, on the same map (i.e. the workspace has not been rebuilt since)
+        */
+        bool is_valid_for(const aStar_algorithm::planner_workspace& workspace, yarp::dev::Nav2D::XYCell goal) const;
+
+        /**
+        * Discards the previous search tree and starts a new one, towards the given goal.
+        * @param workspace the workspace containing the obstacles. It must stay alive until the next initialize().
+        * @param goal the arrival cell(x,y)
+        * @return false if the goal is outside the map
+        */
+        bool initialize(const aStar_algorithm::planner_workspace& workspace, yarp::dev::Nav2D::XYCell goal);
+
+        /**
+        * Notifies that the traversability of some cells has changed. The workspace must already contain the change.
+        * @param changed_cells the list of the modified cells
+        */
+        void update_cells(const std::vector<yarp::dev::Nav2D::XYCell>& changed_cells);
+
+        /**
+        * Computes (if exists) the path from the start cell to the goal, repairing the search tree if needed.
+        * @param start the start cell(x,y), i.e. the current robot position
+        * @param path the computed sequence of cells required to go from  start cell to goal cell
+        * @return true if the path exists, false if no valid path has been found
+        */
+        bool compute_path(yarp::dev::Nav2D::XYCell start, std::deque<yarp::dev::Nav2D::XYCell>& path);
+
+        /**
+        * Returns the number of cells expanded during the last call of compute_path().
+        */
+        size_t get_last_expansions() const { return m_last_expansions; }
+
+        private:
+        inline float    get_g(aStar_algorithm::cell_index_type c) const;
+        inline float    get_rhs(aStar_algorithm::cell_index_type c) const;
+        inline void     touch(aStar_algorithm::cell_index_type c);
+        inline float    heuristic(aStar_algorithm::cell_index_type a, aStar_algorithm::cell_index_type b) const;
+        inline key_type calculate_key(aStar_algorithm::cell_index_type c) const;
+        float           best_successor_cost(aStar_algorithm::cell_index_type c, aStar_algorithm::cell_index_type* best = nullptr) const;
+        void            update_vertex(aStar_algorithm::cell_index_type c);
+        void            update_rhs_and_vertex(aStar_algorithm::cell_index_type c);
+        void            compute_shortest_path();
+
+        const aStar_algorithm::planner_workspace* m_ws;
+        size_t                                    m_map_revision;
+        size_t                                    m_w;
+        size_t                                    m_h;
+        aStar_algorithm::cell_index_type          m_goal;
+        aStar_algorithm::cell_index_type          m_start;
+        aStar_algorithm::cell_index_type          m_last_start;
+        float                                     m_km;
+        std::vector<float>                        m_g;
+        std::vector<float>                        m_rhs;
+        std::vector<uint32_t>                     m_stamp;
+        uint32_t                                  m_generation;
+        key_heap_type                             m_queue;
+        size_t                                    m_last_expansions;
+    };
+};
+
+#endif
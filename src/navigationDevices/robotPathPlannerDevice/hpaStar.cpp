@@ -0,0 +1,452 @@
+/* 
+ * Copyright (C)2017  iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Marco Randazzo
+ * email:  marco.randazzo@iit.it
+ * website: www.robotcub.org
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <limits>
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdlib>
+#include "hpaStar.h"
+
+using namespace std;
+using namespace yarp::dev;
+using namespace yarp::dev::Nav2D;
+using namespace aStar_algorithm;
+using namespace hpaStar_algorithm;
+
+YARP_LOG_COMPONENT(PATHPLAN_HPA, "navigation.devices.robotPathPlanner.hpaStar")
+
+namespace
+{
+    const float infinite_cost = std::numeric_limits<float>::infinity();
+
+    //entrances wider than this are represented by two portals (one for each end) instead of a single central one
+    const int max_entrance_width = 6;
+
+    //neighbors offsets and their associated cost (10 for straight moves, 14 for diagonal moves), same as find_astar_path()
+    const int   nb_dx[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+    const int   nb_dy[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+    const float nb_cost[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+
+    inline float octile_distance(int x1, int y1, int x2, int y2)
+    {
+        int dx = abs(x2 - x1);
+        int dy = abs(y2 - y1);
+        return float(14 * std::min(dx, dy) + 10 * (std::max(dx, dy) - std::min(dx, dy)));
+    }
+
+    //search bounded to the window [x0,x1]x[y0,y1]. If goal is invalid_cell, all the window reachable from source is explored
+    //(Dijkstra), otherwise the search stops when the goal is found (A*). The results are left in the workspace.
+    bool window_search(planner_workspace& ws, cell_index_type source, cell_index_type goal, int x0, int y0, int x1, int y1)
+    {
+        const int w = int(ws.width());
+        const int gx = (goal == invalid_cell) ? 0 : int(goal % w);
+        const int gy = (goal == invalid_cell) ? 0 : int(goal / w);
+        ws.new_search();
+        ws.set_g(source, 0, invalid_cell);
+        ws.open_set.push_or_decrease(source, 0);
+        while (!ws.open_set.empty())
+        {
+            cell_index_type curr = ws.open_set.pop_smallest();
+            if (curr == goal) return true;
+            ws.close(curr);
+            const int cx = int(curr % w);
+            const int cy = int(curr / w);
+            const float curr_g = ws.get_g(curr);
+            for (int n = 0; n < 8; n++)
+            {
+                const int nx = cx + nb_dx[n];
+                const int ny = cy + nb_dy[n];
+                if (nx < x0 || nx > x1 || ny < y0 || ny > y1) continue;
+                if (!ws.is_free(nx, ny)) continue;
+                const cell_index_type neighbor = ws.index(nx, ny);
+                if (ws.is_closed(neighbor)) continue;
+                float tentative_g_score = curr_g + nb_cost[n];
+                if (tentative_g_score < ws.get_g(neighbor))
+                {
+                    ws.set_g(neighbor, tentative_g_score, curr);
+                    float h = (goal == invalid_cell) ? 0 : octile_distance(nx, ny, gx, gy);
+                    ws.open_set.push_or_decrease(neighbor, tentative_g_score + h);
+                }
+            }
+        }
+        return goal == invalid_cell;
+    }
+}
+
+uint64_t hpaStar_algorithm::compute_signature(const planner_workspace& ws)
+{
+    //FNV-1a hash of the packed free cells bitmap
+    const size_t number_of_cells = ws.width() * ws.height();
+    uint64_t hash = 14695981039346656037ULL;
+    hash = (hash ^ ws.width()) * 1099511628211ULL;
+    hash = (hash ^ ws.height()) * 1099511628211ULL;
+    for (size_t i = 0; i < number_of_cells; i += 64)
+    {
+        hash = (hash ^ ws.rows().read(i, std::min<size_t>(64, number_of_cells - i))) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+hpaStar_algorithm::hpa_graph::hpa_graph()
+{
+    m_cluster_size = 0;
+    m_clusters_x = 0;
+    m_clusters_y = 0;
+    m_w = 0;
+    m_h = 0;
+    m_signature = 0;
+    m_map_revision = 0;
+}
+
+size_t hpaStar_algorithm::hpa_graph::get_number_of_portals() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < m_clusters.size(); i++)
+    {
+        count += m_clusters[i].portals.size();
+    }
+    return count;
+}
+
+void hpaStar_algorithm::hpa_graph::compute_vertical_border(const planner_workspace& ws, size_t cx, size_t cy)
+{
+    entrances_type& entrances = m_vertical_borders[cy * m_clusters_x + cx];
+    entrances.clear();
+    const cluster_type& cluster = m_clusters[cy * m_clusters_x + cx];
+    const int xa = cluster.x1;
+    const int xb = cluster.x1 + 1;
+    int run_start = -1;
+    for (int y = cluster.y0; y <= cluster.y1 + 1; y++)
+    {
+        bool open = (y <= cluster.y1) && ws.is_free(xa, y) && ws.is_free(xb, y);
+        if (open && run_start < 0)
+        {
+            run_start = y;
+        }
+        else if (!open && run_start >= 0)
+        {
+            int run_end = y - 1;
+            if (run_end - run_start + 1 <= max_entrance_width)
+            {
+                int ym = (run_start + run_end) / 2;
+                entrances.push_back(std::make_pair(ws.index(xa, ym), ws.index(xb, ym)));
+            }
+            else
+            {
+                entrances.push_back(std::make_pair(ws.index(xa, run_start), ws.index(xb, run_start)));
+                entrances.push_back(std::make_pair(ws.index(xa, run_end), ws.index(xb, run_end)));
+            }
+            run_start = -1;
+        }
+    }
+}
+
+void hpaStar_algorithm::hpa_graph::compute_horizontal_border(const planner_workspace& ws, size_t cx, size_t cy)
+{
+    entrances_type& entrances = m_horizontal_borders[cy * m_clusters_x + cx];
+    entrances.clear();
+    const cluster_type& cluster = m_clusters[cy * m_clusters_x + cx];
+    const int ya = cluster.y1;
+    const int yb = cluster.y1 + 1;
+    int run_start = -1;
+    for (int x = cluster.x0; x <= cluster.x1 + 1; x++)
+    {
+        bool open = (x <= cluster.x1) && ws.is_free(x, ya) && ws.is_free(x, yb);
+        if (open && run_start < 0)
+        {
+            run_start = x;
+        }
+        else if (!open && run_start >= 0)
+        {
+            int run_end = x - 1;
+            if (run_end - run_start + 1 <= max_entrance_width)
+            {
+                int xm = (run_start + run_end) / 2;
+                entrances.push_back(std::make_pair(ws.index(xm, ya), ws.index(xm, yb)));
+            }
+            else
+            {
+                entrances.push_back(std::make_pair(ws.index(run_start, ya), ws.index(run_start, yb)));
+                entrances.push_back(std::make_pair(ws.index(run_end, ya), ws.index(run_end, yb)));
+            }
+            run_start = -1;
+        }
+    }
+}
+
+void hpaStar_algorithm::hpa_graph::compute_cluster(planner_workspace& ws, size_t cx, size_t cy)
+{
+    cluster_type& cluster = m_clusters[cy * m_clusters_x + cx];
+    cluster.portals.clear();
+
+    //collects the portals from the four borders of the cluster
+    portal_type p;
+    if (cx > 0)
+    {
+        const entrances_type& e = m_vertical_borders[cy * m_clusters_x + cx - 1];
+        for (size_t i = 0; i < e.size(); i++) { p.cell = e[i].second; p.twin = e[i].first; cluster.portals.push_back(p); }
+    }
+    if (cx + 1 < m_clusters_x)
+    {
+        const entrances_type& e = m_vertical_borders[cy * m_clusters_x + cx];
+        for (size_t i = 0; i < e.size(); i++) { p.cell = e[i].first; p.twin = e[i].second; cluster.portals.push_back(p); }
+    }
+    if (cy > 0)
+    {
+        const entrances_type& e = m_horizontal_borders[(cy - 1) * m_clusters_x + cx];
+        for (size_t i = 0; i < e.size(); i++) { p.cell = e[i].second; p.twin = e[i].first; cluster.portals.push_back(p); }
+    }
+    if (cy + 1 < m_clusters_y)
+    {
+        const entrances_type& e = m_horizontal_borders[cy * m_clusters_x + cx];
+        for (size_t i = 0; i < e.size(); i++) { p.cell = e[i].first; p.twin = e[i].second; cluster.portals.push_back(p); }
+    }
+
+    //the costs between the portals are symmetric, so a search is performed from each portal towards the following ones only
+    const size_t k = cluster.portals.size();
+    cluster.distances.assign(k * k, infinite_cost);
+    for (size_t i = 0; i < k; i++)
+    {
+        cluster.distances[i * k + i] = 0;
+        if (i + 1 == k) break;
+        window_search(ws, cluster.portals[i].cell, invalid_cell, cluster.x0, cluster.y0, cluster.x1, cluster.y1);
+        for (size_t j = i + 1; j < k; j++)
+        {
+            float d = ws.get_g(cluster.portals[j].cell);
+            cluster.distances[i * k + j] = d;
+            cluster.distances[j * k + i] = d;
+        }
+    }
+}
+
+void hpaStar_algorithm::hpa_graph::build(planner_workspace& ws, size_t cluster_size)
+{
+    m_cluster_size = std::max<size_t>(cluster_size, 4);
+    m_w = ws.width();
+    m_h = ws.height();
+    m_clusters_x = (m_w + m_cluster_size - 1) / m_cluster_size;
+    m_clusters_y = (m_h + m_cluster_size - 1) / m_cluster_size;
+    m_clusters.assign(m_clusters_x * m_clusters_y, cluster_type());
+    m_vertical_borders.assign(m_clusters.size(), entrances_type());
+    m_horizontal_borders.assign(m_clusters.size(), entrances_type());
+
+    for (size_t cy = 0; cy < m_clusters_y; cy++)
+        for (size_t cx = 0; cx < m_clusters_x; cx++)
+        {
+            cluster_type& cluster = m_clusters[cy * m_clusters_x + cx];
+            cluster.x0 = int(cx * m_cluster_size);
+            cluster.y0 = int(cy * m_cluster_size);
+            cluster.x1 = int(std::min(m_w, (cx + 1) * m_cluster_size) - 1);
+            cluster.y1 = int(std::min(m_h, (cy + 1) * m_cluster_size) - 1);
+        }
+
+    for (size_t cy = 0; cy < m_clusters_y; cy++)
+        for (size_t cx = 0; cx < m_clusters_x; cx++)
+        {
+            if (cx + 1 < m_clusters_x) compute_vertical_border(ws, cx, cy);
+            if (cy + 1 < m_clusters_y) compute_horizontal_border(ws, cx, cy);
+        }
+
+    for (size_t cy = 0; cy < m_clusters_y; cy++)
+        for (size_t cx = 0; cx < m_clusters_x; cx++)
+            compute_cluster(ws, cx, cy);
+
+    m_signature = compute_signature(ws);
+    m_map_revision = ws.revision();
+}
+
+bool hpaStar_algorithm::hpa_graph::attach(const planner_workspace& ws)
+{
+    if (m_clusters.empty() || m_w != ws.width() || m_h != ws.height()) return false;
+    if (m_signature != compute_signature(ws)) return false;
+    m_map_revision = ws.revision();
+    return true;
+}
+
+bool hpaStar_algorithm::hpa_graph::is_valid_for(const planner_workspace& ws) const
+{
+    return !m_clusters.empty() && m_map_revision == ws.revision() && m_w == ws.width() && m_h == ws.height();
+}
+
+void hpaStar_algorithm::hpa_graph::update_cells(planner_workspace& ws, const std::vector<XYCell>& changed_cells)
+{
+    if (m_clusters.empty()) return;
+
+    //a changed cell modifies its own cluster and, if it lies on a border, also the entrances of that border
+    //and the portals of the adjacent cluster
+    const int cs = int(m_cluster_size);
+    std::vector<char> dirty_clusters(m_clusters.size(), 0);
+    std::vector<char> dirty_vertical(m_clusters.size(), 0);
+    std::vector<char> dirty_horizontal(m_clusters.size(), 0);
+    for (size_t i = 0; i < changed_cells.size(); i++)
+    {
+        const int x = int(changed_cells[i].x);
+        const int y = int(changed_cells[i].y);
+        if (!ws.is_inside(x, y)) continue;
+        const size_t cx = size_t(x / cs);
+        const size_t cy = size_t(y / cs);
+        dirty_clusters[cy * m_clusters_x + cx] = 1;
+        if (x % cs == cs - 1 && cx + 1 < m_clusters_x) { dirty_vertical[cy * m_clusters_x + cx] = 1;       dirty_clusters[cy * m_clusters_x + cx + 1] = 1; }
+        if (x % cs == 0 && cx > 0)                     { dirty_vertical[cy * m_clusters_x + cx - 1] = 1;   dirty_clusters[cy * m_clusters_x + cx - 1] = 1; }
+        if (y % cs == cs - 1 && cy + 1 < m_clusters_y) { dirty_horizontal[cy * m_clusters_x + cx] = 1;     dirty_clusters[(cy + 1) * m_clusters_x + cx] = 1; }
+        if (y % cs == 0 && cy > 0)                     { dirty_horizontal[(cy - 1) * m_clusters_x + cx] = 1; dirty_clusters[(cy - 1) * m_clusters_x + cx] = 1; }
+    }
+
+    for (size_t c = 0; c < m_clusters.size(); c++)
+    {
+        if (dirty_vertical[c])   compute_vertical_border(ws, c % m_clusters_x, c / m_clusters_x);
+        if (dirty_horizontal[c]) compute_horizontal_border(ws, c % m_clusters_x, c / m_clusters_x);
+    }
+    for (size_t c = 0; c < m_clusters.size(); c++)
+    {
+        if (dirty_clusters[c]) compute_cluster(ws, c % m_clusters_x, c / m_clusters_x);
+    }
+    m_signature = compute_signature(ws);
+}
+
+bool hpaStar_algorithm::hpa_graph::find_path(planner_workspace& ws, XYCell start, XYCell goal, std::deque<XYCell>& path)
+{
+    const int w = int(ws.width());
+    const int sx = int(start.x);
+    const int sy = int(start.y);
+    const int gx = int(goal.x);
+    const int gy = int(goal.y);
+    if (!ws.is_inside(sx, sy) || !ws.is_inside(gx, gy)) return false;
+    if (sx == gx && sy == gy) return true;
+    if (!ws.is_free(gx, gy)) return false;
+    if (m_clusters.empty() || m_w != ws.width() || m_h != ws.height())
+    {
+        return find_astar_path(ws, start, goal, path);
+    }
+
+    const cell_index_type start_idx = ws.index(sx, sy);
+    const cell_index_type goal_idx = ws.index(gx, gy);
+    const size_t start_cluster = cluster_of(sx, sy);
+    const size_t goal_cluster = cluster_of(gx, gy);
+
+    //start and goal are temporarily connected to the portals of their clusters
+    const cluster_type& sc = m_clusters[start_cluster];
+    const cluster_type& gc = m_clusters[goal_cluster];
+    std::vector<float> start_costs(sc.portals.size());
+    std::vector<float> goal_costs(gc.portals.size());
+    float direct_cost = infinite_cost;
+    window_search(ws, start_idx, invalid_cell, sc.x0, sc.y0, sc.x1, sc.y1);
+    for (size_t j = 0; j < sc.portals.size(); j++) start_costs[j] = ws.get_g(sc.portals[j].cell);
+    if (start_cluster == goal_cluster) direct_cost = ws.get_g(goal_idx);
+    window_search(ws, goal_idx, invalid_cell, gc.x0, gc.y0, gc.x1, gc.y1);
+    for (size_t j = 0; j < gc.portals.size(); j++) goal_costs[j] = ws.get_g(gc.portals[j].cell);
+
+    //A* on the abstract graph
+    typedef std::pair<float, cell_index_type> queue_elem;
+    std::priority_queue<queue_elem, std::vector<queue_elem>, std::greater<queue_elem>> open_set;
+    std::unordered_map<cell_index_type, float> g_score;
+    std::unordered_map<cell_index_type, cell_index_type> came_from;
+    std::unordered_set<cell_index_type> closed_set;
+    auto relax = [&](cell_index_type from, cell_index_type to, float cost)
+    {
+        if (cost == infinite_cost || closed_set.count(to)) return;
+        float tentative_g_score = g_score[from] + cost;
+        auto it = g_score.find(to);
+        if (it == g_score.end() || tentative_g_score < it->second)
+        {
+            g_score[to] = tentative_g_score;
+            came_from[to] = from;
+            open_set.push(queue_elem(tentative_g_score + octile_distance(int(to % w), int(to / w), gx, gy), to));
+        }
+    };
+
+    g_score[start_idx] = 0;
+    open_set.push(queue_elem(octile_distance(sx, sy, gx, gy), start_idx));
+    bool found = false;
+    while (!open_set.empty())
+    {
+        cell_index_type curr = open_set.top().second;
+        open_set.pop();
+        if (closed_set.count(curr)) continue;
+        closed_set.insert(curr);
+        if (curr == goal_idx) { found = true; break; }
+
+        if (curr == start_idx)
+        {
+            for (size_t j = 0; j < sc.portals.size(); j++) relax(curr, sc.portals[j].cell, start_costs[j]);
+            relax(curr, goal_idx, direct_cost);
+        }
+        const size_t curr_cluster = cluster_of(int(curr % w), int(curr / w));
+        const cluster_type& cc = m_clusters[curr_cluster];
+        const size_t k = cc.portals.size();
+        for (size_t i = 0; i < k; i++)
+        {
+            if (cc.portals[i].cell != curr) continue;
+            relax(curr, cc.portals[i].twin, 10);
+            for (size_t j = 0; j < k; j++)
+            {
+                if (j != i) relax(curr, cc.portals[j].cell, cc.distances[i * k + j]);
+            }
+            if (curr_cluster == goal_cluster) relax(curr, goal_idx, goal_costs[i]);
+        }
+    }
+
+    if (!found)
+    {
+        //the abstract graph does not capture the passages which can be crossed only diagonally
+        yCDebug(PATHPLAN_HPA) << "abstract path not found, falling back to A*";
+        return find_astar_path(ws, start, goal, path);
+    }
+
+    std::vector<cell_index_type> abstract_path;
+    for (cell_index_type c = goal_idx; c != start_idx; c = came_from[c]) abstract_path.push_back(c);
+    abstract_path.push_back(start_idx);
+    std::reverse(abstract_path.begin(), abstract_path.end());
+
+    //refinement: each abstract edge is either a move across a border, or a path inside a single cluster
+    std::deque<XYCell> refined_path;
+    std::vector<cell_index_type> segment;
+    for (size_t i = 0; i + 1 < abstract_path.size(); i++)
+    {
+        const cell_index_type a = abstract_path[i];
+        const cell_index_type b = abstract_path[i + 1];
+        if (a == b) continue;
+        const int ax = int(a % w), ay = int(a / w);
+        const int bx = int(b % w), by = int(b / w);
+        if (abs(ax - bx) <= 1 && abs(ay - by) <= 1)
+        {
+            refined_path.push_back(XYCell(bx, by));
+            continue;
+        }
+        const cluster_type& cluster = m_clusters[cluster_of(ax, ay)];
+        if (cluster_of(ax, ay) != cluster_of(bx, by) ||
+            !window_search(ws, a, b, cluster.x0, cluster.y0, cluster.x1, cluster.y1))
+        {
+            yCError(PATHPLAN_HPA) << "unable to refine the abstract path, falling back to A*";
+            return find_astar_path(ws, start, goal, path);
+        }
+        segment.clear();
+        for (cell_index_type c = b; c != a; c = ws.get_parent(c)) segment.push_back(c);
+        for (auto it = segment.rbegin(); it != segment.rend(); it++) refined_path.push_back(XYCell(*it % w, *it / w));
+    }
+
+    for (auto it = refined_path.begin(); it != refined_path.end(); it++)
+    {
+        path.push_back(*it);
+    }
+    return true;
+}
@@ -0,0 +1,129 @@
+/* 
+ * Copyright (C)2017  iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Marco Randazzo
+ * email:  marco.randazzo@iit.it
+ * website: www.robotcub.org
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+#ifndef HPA_STAR_H
+#define HPA_STAR_H
+
+#include <yarp/dev/MapGrid2D.h>
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include "aStar.h"
+
+//! namespace containing an implementation of the hierarchical path-finding algorithm HPA* (Botea, Muller and Schaeffer, 2004)
+namespace hpaStar_algorithm
+{
+    //side of the clusters (in cells) used when not specified by the user
+    const size_t default_cluster_size = 32;
+
+    /**
+    * Abstract graph used by HPA*. The map is divided in square clusters; the free passages across the border of two
+    * adjacent clusters (entrances) are represented by pairs of portal cells, and the portals of the same cluster are
+    * connected by the cost of the shortest path between them inside the cluster.
+    * A search is first performed on this (small) graph, then each abstract edge is refined with a search bounded to a
+    * single cluster, so the number of visited cells is proportional to the corridor crossed by the path, instead of to
+    * the size of the map. The path is slightly longer than the optimal one computed by A*, but it is going to be
+    * simplified anyway.
+    */
+    class hpa_graph
+    {
+        public:
+        hpa_graph();
+
+        /**
+        * Builds the abstract graph from the obstacles contained in the workspace. This is the expensive part, which is
+        * supposed to be performed once when a map is loaded.
+        * @param workspace the workspace containing the obstacles
+        * @param cluster_size the side of the clusters, expressed in cells
+        */
+        void build(aStar_algorithm::planner_workspace& workspace, size_t cluster_size);
+
+        /**
+        * Checks if the graph has been built from a map identical to the one contained in the workspace (e.g. the same map,
+        * reloaded from the map server). If so, the graph is associated to the workspace and it can be used without rebuilding it.
+        */
+        bool attach(const aStar_algorithm::planner_workspace& workspace);
+
+        /**
+        * @return true if the graph is synchronized with the current content of the workspace
+        */
+        bool is_valid_for(const aStar_algorithm::planner_workspace& workspace) const;
+
+        /**
+        * Updates the clusters containing the given cells, after their traversability has changed.
+        * The workspace must already contain the change.
+        */
+        void update_cells(aStar_algorithm::planner_workspace& workspace, const std::vector<yarp::dev::Nav2D::XYCell>& changed_cells);
+
+        /**
+        * Computes (if exists) a path from start to goal. If the abstract graph does not find a solution (e.g. the only
+        * passage between two clusters is a diagonal move) the search falls back to a plain A* on the whole map.
+        * @param workspace the workspace containing the obstacles, the same used to build the graph
+        * @param start the start cell(x,y)
+        * @param goal the arrival cell(x,y)
+        * @param path the computed sequence of cells required to go from  start cell to goal cell
+        * @return true if the path exists, false if no valid path has been found
+        */
+        bool find_path(aStar_algorithm::planner_workspace& workspace, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, std::deque<yarp::dev::Nav2D::XYCell>& path);
+
+        size_t get_cluster_size() const { return m_cluster_size; }
+        size_t get_number_of_clusters() const { return m_clusters.size(); }
+        size_t get_number_of_portals() const;
+
+        private:
+        struct portal_type
+        {
+            aStar_algorithm::cell_index_type cell;  //the portal cell, inside the cluster
+            aStar_algorithm::cell_index_type twin;  //the adjacent cell, on the other side of the border
+        };
+
+        struct cluster_type
+        {
+            int x0, y0, x1, y1;                //bounds of the cluster (inclusive)
+            std::vector<portal_type> portals;
+            std::vector<float>       distances; //portals.size()^2 matrix of the costs between the portals (infinite if not connected)
+        };
+
+        //each entrance is a pair of cells: the first one belongs to the left (top) cluster, the second to the right (bottom) one
+        typedef std::vector<std::pair<aStar_algorithm::cell_index_type, aStar_algorithm::cell_index_type>> entrances_type;
+
+        size_t cluster_of(int x, int y) const { return size_t(y / int(m_cluster_size)) * m_clusters_x + size_t(x / int(m_cluster_size)); }
+        void   compute_vertical_border(const aStar_algorithm::planner_workspace& ws, size_t cx, size_t cy);
+        void   compute_horizontal_border(const aStar_algorithm::planner_workspace& ws, size_t cx, size_t cy);
+        void   compute_cluster(aStar_algorithm::planner_workspace& ws, size_t cx, size_t cy);
+
+        size_t                      m_cluster_size;
+        size_t                      m_clusters_x;
+        size_t                      m_clusters_y;
+        size_t                      m_w;
+        size_t                      m_h;
+        uint64_t                    m_signature;
+        size_t                      m_map_revision;
+        std::vector<cluster_type>   m_clusters;
+        std::vector<entrances_type> m_vertical_borders;   //border between cluster (cx,cy) and (cx+1,cy)
+        std::vector<entrances_type> m_horizontal_borders; //border between cluster (cx,cy) and (cx,cy+1)
+    };
+
+    /**
+    * Computes a hash of the obstacles contained in the workspace, used to check if a cached graph matches a map.
+    */
+    uint64_t compute_signature(const aStar_algorithm::planner_workspace& workspace);
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include <yarp/dev/Map2DLocation.h>
 #include <string>
 #include <math.h>
+#include <algorithm>
 
 #include "map.h"
 #include "aStar.h"
@@ -87,7 +88,7 @@ bool map_utilites::simplifyPath(MapGrid2D& map, Map2DPath input_path, Map2DPath&
     return true;
 };
 
-void map_utilites::update_obstacles_map(MapGrid2D& map_to_be_updated, const MapGrid2D& obstacles_map)
+void map_utilites::update_obstacles_map(MapGrid2D& map_to_be_updated, const MapGrid2D& obstacles_map, std::vector<XYCell>* changed_cells)
 {
     //copies obstacles (and only them) from a source map to a destination map
     if (map_to_be_updated.width() != obstacles_map.width() ||
@@ -108,16 +109,54 @@ void map_utilites::update_obstacles_map(MapGrid2D& map_to_be_updated, const MapG
                 if      (flag_src==MapGrid2D::MAP_CELL_TEMPORARY_OBSTACLE)
                 { 
                     map_to_be_updated.setMapFlag(XYCell(x, y),MapGrid2D::MAP_CELL_KEEP_OUT);
+                    if (changed_cells) changed_cells->push_back(XYCell(x, y));
                 }
                 else if (flag_src==MapGrid2D::MAP_CELL_ENLARGED_OBSTACLE)
                 {
                     map_to_be_updated.setMapFlag(XYCell(x, y), MapGrid2D::MAP_CELL_KEEP_OUT);
+                    if (changed_cells) changed_cells->push_back(XYCell(x, y));
                 }
             }
         }
 }
 
-bool map_utilites::checkStraightLine(MapGrid2D& map, XYCell src, XYCell dst)
+void map_utilites::enlarge_obstacles_around(MapGrid2D& map, std::vector<XYCell>& obstacle_cells, double size)
+{
+    double resolution = 0;
+    map.getResolution(resolution);
+    if (size <= 0 || resolution <= 0) return;
+
+    //MapGrid2D::enlargeObstacles() grows the obstacles by one cell (4-neighborhood) for each multiple of the map resolution,
+    //so the enlarged area around each obstacle cell is a diamond of radius n (city-block distance)
+    const int n = (int)(ceil(size / resolution));
+    const int w = (int)map.width();
+    const int h = (int)map.height();
+    const size_t number_of_seeds = obstacle_cells.size();
+    for (size_t i = 0; i < number_of_seeds; i++)
+    {
+        const int cx = (int)obstacle_cells[i].x;
+        const int cy = (int)obstacle_cells[i].y;
+        for (int dy = -n; dy <= n; dy++)
+        {
+            const int y = cy + dy;
+            if (y < 0 || y >= h) continue;
+            const int span = n - abs(dy);
+            for (int x = std::max(0, cx - span); x <= std::min(w - 1, cx + span); x++)
+            {
+                XYCell cell(x, y);
+                MapGrid2D::map_flags flag;
+                map.getMapFlag(cell, flag);
+                if (flag == MapGrid2D::MAP_CELL_FREE)
+                {
+                    map.setMapFlag(cell, MapGrid2D::MAP_CELL_ENLARGED_OBSTACLE);
+                    obstacle_cells.push_back(cell);
+                }
+            }
+        }
+    }
+}
+
+bool map_utilites::checkStraightLine(const MapGrid2D& map, XYCell src, XYCell dst)
 {
     //here using the fast Bresenham algorithm to check if cells belonging to a straight line (from src to dst)
     //are free or occupied by an obstacle
@@ -165,3 +204,91 @@ bool map_utilites::findPath(MapGrid2D& map, XYCell start, XYCell goal, Map2DPath
     }
     return false;
 }
+
+bool map_utilites::findPath(aStar_algorithm::planner_workspace& workspace, const MapGrid2D& map, XYCell start, XYCell goal, Map2DPath& path, aStar_algorithm::search_algorithm_type algorithm)
+{
+    //computes path from start to goal, reusing the memory of the workspace
+    std::deque<XYCell> cell_path;
+    bool b = false;
+    switch (algorithm)
+    {
+        case aStar_algorithm::search_algorithm_type::jps:
+            b = aStar_algorithm::find_jps_path(workspace, start, goal, cell_path);
+        break;
+        case aStar_algorithm::search_algorithm_type::theta_star:
+            b = aStar_algorithm::find_thetastar_path(workspace, start, goal, cell_path);
+        break;
+        case aStar_algorithm::search_algorithm_type::dstar_lite:
+        {
+            //one-shot search: without a persistent planner, D* Lite has no previous search tree to reuse
+            dStarLite_algorithm::dstar_lite_planner planner;
+            b = planner.initialize(workspace, goal) && planner.compute_path(start, cell_path);
+        }
+        break;
+        case aStar_algorithm::search_algorithm_type::hpa_star:
+        {
+            //one-shot search: the abstract graph is built for this request only
+            hpaStar_algorithm::hpa_graph graph;
+            graph.build(workspace, hpaStar_algorithm::default_cluster_size);
+            b = graph.find_path(workspace, start, goal, cell_path);
+        }
+        break;
+        case aStar_algorithm::search_algorithm_type::astar:
+        default:
+            b = aStar_algorithm::find_astar_path(workspace, start, goal, cell_path);
+        break;
+    }
+    if (b)
+    {
+        for (auto it = cell_path.begin(); it != cell_path.end(); it++)
+        {
+            Map2DLocation tmploc = map.toLocation(*it);
+            path.push_back(tmploc);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool map_utilites::findPath(dStarLite_algorithm::dstar_lite_planner& planner, aStar_algorithm::planner_workspace& workspace, const MapGrid2D& map, XYCell start, XYCell goal, Map2DPath& path)
+{
+    //the search tree is discarded only if the goal has changed or the map has been reloaded
+    if (planner.is_valid_for(workspace, goal) == false)
+    {
+        if (planner.initialize(workspace, goal) == false) return false;
+    }
+    std::deque<XYCell> cell_path;
+    bool b = planner.compute_path(start, cell_path);
+    if (b)
+    {
+        for (auto it = cell_path.begin(); it != cell_path.end(); it++)
+        {
+            Map2DLocation tmploc = map.toLocation(*it);
+            path.push_back(tmploc);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool map_utilites::findPath(hpaStar_algorithm::hpa_graph& graph, aStar_algorithm::planner_workspace& workspace, const MapGrid2D& map, XYCell start, XYCell goal, Map2DPath& path)
+{
+    //the abstract graph is normally built when the map is loaded, this is just a safety check
+    if (graph.is_valid_for(workspace) == false)
+    {
+        yCWarning(PATHPLAN_MAP) << "HPA* graph not valid for the current map, rebuilding it";
+        graph.build(workspace, graph.get_cluster_size() > 0 ? graph.get_cluster_size() : hpaStar_algorithm::default_cluster_size);
+    }
+    std::deque<XYCell> cell_path;
+    bool b = graph.find_path(workspace, start, goal, cell_path);
+    if (b)
+    {
+        for (auto it = cell_path.begin(); it != cell_path.end(); it++)
+        {
+            Map2DLocation tmploc = map.toLocation(*it);
+            path.push_back(tmploc);
+        }
+        return true;
+    }
+    return false;
+}
@@ -26,8 +26,13 @@
 #include <yarp/sig/Image.h>
 #include <yarp/sig/ImageDraw.h>
 #include <yarp/dev/MapGrid2D.h>
+#include <yarp/dev/Map2DPath.h>
 #include <string>
 #include <queue>
+#include <vector>
+#include "aStar.h"
+#include "dStarLite.h"
+#include "hpaStar.h"
 
 using namespace std;
 using namespace yarp::os;
@@ -40,7 +45,7 @@ using namespace yarp::os;
 namespace map_utilites
 {
     //return true if the straight line that connects src with dst does not contain any obstacles
-    bool checkStraightLine(yarp::dev::Nav2D::MapGrid2D& map, yarp::dev::Nav2D::XYCell src, yarp::dev::Nav2D::XYCell dst);
+    bool checkStraightLine(const yarp::dev::Nav2D::MapGrid2D& map, yarp::dev::Nav2D::XYCell src, yarp::dev::Nav2D::XYCell dst);
 
     //simplify the path
     bool simplifyPath(yarp::dev::Nav2D::MapGrid2D& map, yarp::dev::Nav2D::Map2DPath input_path, yarp::dev::Nav2D::Map2DPath& output_path);
@@ -48,8 +53,25 @@ namespace map_utilites
     //compute a path, given a start cell, a goal cell and a map grid.
     bool findPath(yarp::dev::Nav2D::MapGrid2D& map, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, yarp::dev::Nav2D::Map2DPath& path);
 
-    // register new obstacles into a map
-    void update_obstacles_map(yarp::dev::Nav2D::MapGrid2D& map_to_be_updated, const yarp::dev::Nav2D::MapGrid2D& obstacles_map);
+    //compute a path, given a start cell, a goal cell and a workspace previously built from the map grid, using the specified algorithm.
+    bool findPath(aStar_algorithm::planner_workspace& workspace, const yarp::dev::Nav2D::MapGrid2D& map, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, yarp::dev::Nav2D::Map2DPath& path,
+                  aStar_algorithm::search_algorithm_type algorithm = aStar_algorithm::search_algorithm_type::astar);
+
+    //compute a path using the D* Lite incremental planner. The search tree of the previous call is reused if it was computed
+    //for the same goal on the same workspace, so that only the changes notified to the planner are re-evaluated.
+    bool findPath(dStarLite_algorithm::dstar_lite_planner& planner, aStar_algorithm::planner_workspace& workspace, const yarp::dev::Nav2D::MapGrid2D& map,
+                  yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, yarp::dev::Nav2D::Map2DPath& path);
+
+    //compute a path using the HPA* hierarchical planner. The abstract graph is rebuilt only if it was not computed on the current workspace.
+    bool findPath(hpaStar_algorithm::hpa_graph& graph, aStar_algorithm::planner_workspace& workspace, const yarp::dev::Nav2D::MapGrid2D& map,
+                  yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, yarp::dev::Nav2D::Map2DPath& path);
+
+    // register new obstacles into a map. If changed_cells is not null, the cells turned into obstacles are appended to it.
+    void update_obstacles_map(yarp::dev::Nav2D::MapGrid2D& map_to_be_updated, const yarp::dev::Nav2D::MapGrid2D& obstacles_map, std::vector<yarp::dev::Nav2D::XYCell>* changed_cells = nullptr);
+
+    // enlarge the obstacles contained in a list of cells, with the same result of MapGrid2D::enlargeObstacles(), but visiting only the
+    // neighborhood of the listed cells instead of the whole map. The free cells turned into MAP_CELL_ENLARGED_OBSTACLE are appended to the list.
+    void enlarge_obstacles_around(yarp::dev::Nav2D::MapGrid2D& map, std::vector<yarp::dev::Nav2D::XYCell>& obstacle_cells, double size);
 };
 
 #endif
@@ -0,0 +1,133 @@
+/* 
+ * Copyright (C)2017  iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Marco Randazzo
+ * email:  marco.randazzo@iit.it
+ * website: www.robotcub.org
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <cmath>
+#include "pathCache.h"
+#include "map.h"
+
+using namespace std;
+using namespace yarp::dev;
+using namespace yarp::dev::Nav2D;
+using namespace pathCache;
+
+YARP_LOG_COMPONENT(PATHPLAN_CACHE, "navigation.devices.robotPathPlanner.pathCache")
+
+bool path_key_type::operator < (const path_key_type& other) const
+{
+    if (map_id != other.map_id) return map_id < other.map_id;
+    if (start_bucket_x != other.start_bucket_x) return start_bucket_x < other.start_bucket_x;
+    if (start_bucket_y != other.start_bucket_y) return start_bucket_y < other.start_bucket_y;
+    if (goal_x != other.goal_x) return goal_x < other.goal_x;
+    if (goal_y != other.goal_y) return goal_y < other.goal_y;
+    return robot_radius_mm < other.robot_radius_mm;
+}
+
+path_cache::path_cache()
+{
+    m_bucket_size = 10;
+    m_max_entries = 10000;
+    m_hits = 0;
+    m_misses = 0;
+}
+
+void path_cache::set_bucket_size(size_t bucket_size)
+{
+    //the stored keys depend on the bucket size
+    m_bucket_size = (bucket_size > 0) ? bucket_size : 1;
+    m_paths.clear();
+}
+
+void path_cache::set_max_entries(size_t max_entries)
+{
+    m_max_entries = max_entries;
+}
+
+path_key_type path_cache::make_key(const std::string& map_id, XYCell start, XYCell goal, double robot_radius) const
+{
+    path_key_type key;
+    key.map_id = map_id;
+    key.start_bucket_x = start.x / m_bucket_size;
+    key.start_bucket_y = start.y / m_bucket_size;
+    key.goal_x = goal.x;
+    key.goal_y = goal.y;
+    key.robot_radius_mm = int(std::round(robot_radius * 1000.0));
+    return key;
+}
+
+bool path_cache::find(const std::string& map_id, XYCell start, XYCell goal, double robot_radius,
+                      const MapGrid2D& map, const MapGrid2D* obstacles_map, Map2DPath& path)
+{
+    auto it = m_paths.find(make_key(map_id, start, goal, robot_radius));
+    if (it == m_paths.end())
+    {
+        m_misses++;
+        return false;
+    }
+
+    //the obstacles map may have not been resized yet, if the map has just been reloaded
+    if (obstacles_map && (obstacles_map->width() != map.width() || obstacles_map->height() != map.height()))
+    {
+        obstacles_map = nullptr;
+    }
+
+    const Map2DPath& cached_path = it->second;
+    XYCell src = start;
+    for (auto wp = cached_path.cbegin(); wp != cached_path.cend(); wp++)
+    {
+        XYCell dst = map.toXYCell(*wp);
+        if (map_utilites::checkStraightLine(map, src, dst) == false ||
+            (obstacles_map && map_utilites::checkStraightLine(*obstacles_map, src, dst) == false))
+        {
+            yCDebug(PATHPLAN_CACHE) << "cached path is obstructed, removed";
+            m_paths.erase(it);
+            m_misses++;
+            return false;
+        }
+        src = dst;
+    }
+    path = cached_path;
+    m_hits++;
+    return true;
+}
+
+void path_cache::insert(const std::string& map_id, XYCell start, XYCell goal, double robot_radius, const Map2DPath& path)
+{
+    if (path.size() == 0) return;
+    if (m_paths.size() >= m_max_entries)
+    {
+        yCWarning(PATHPLAN_CACHE) << "path cache full (" << m_paths.size() << "entries ), cleared";
+        m_paths.clear();
+    }
+    m_paths[make_key(map_id, start, goal, robot_radius)] = path;
+}
+
+void path_cache::invalidate(const std::string& map_id)
+{
+    for (auto it = m_paths.begin(); it != m_paths.end(); )
+    {
+        if (it->first.map_id == map_id) it = m_paths.erase(it);
+        else it++;
+    }
+}
+
+void path_cache::clear()
+{
+    m_paths.clear();
+}
@@ -0,0 +1,102 @@
+/* 
+ * Copyright (C)2017  iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Marco Randazzo
+ * email:  marco.randazzo@iit.it
+ * website: www.robotcub.org
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <yarp/dev/MapGrid2D.h>
+#include <yarp/dev/Map2DPath.h>
+
+#include <string>
+#include <map>
+
+//! namespace containing a cache of the paths computed by the planner
+namespace pathCache
+{
+    //the key of a cached path. The start cell is quantized in buckets, so that the same path can be reused by a robot
+    //which is leaving from (almost) the same place, i.e. a named location, the goal cell is instead exact.
+    struct path_key_type
+    {
+        std::string map_id;
+        size_t      start_bucket_x;
+        size_t      start_bucket_y;
+        size_t      goal_x;
+        size_t      goal_y;
+        int         robot_radius_mm;
+        bool operator < (const path_key_type& other) const;
+    };
+
+    /**
+    * Cache of simplified paths. Since the map can change (new obstacles found during the navigation, detected by the laser),
+    * an entry is returned only after checking that all the segments of the path (plus the segment which connects the actual
+    * start cell to the first waypoint) are still free. This costs only the cells crossed by the path, instead of a new search.
+    */
+    class path_cache
+    {
+        public:
+        path_cache();
+
+        /**
+        * Sets the side of the buckets in which the start cell is quantized.
+        * @param bucket_size the side of the bucket, expressed in cells. The cache is cleared.
+        */
+        void   set_bucket_size(size_t bucket_size);
+
+        /**
+        * Sets the maximum number of stored paths. When the cache is full, it is cleared.
+        */
+        void   set_max_entries(size_t max_entries);
+
+        /**
+        * Searches a valid path. An entry which is found not valid anymore is removed.
+        * @param map the map used for the planning, i.e. the static map plus the obstacles already registered
+        * @param obstacles_map the map containing the temporary obstacles detected by the laser (can be null)
+        * @param path the found path
+        * @return true if a valid path has been found
+        */
+        bool   find(const std::string& map_id, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, double robot_radius,
+                    const yarp::dev::Nav2D::MapGrid2D& map, const yarp::dev::Nav2D::MapGrid2D* obstacles_map, yarp::dev::Nav2D::Map2DPath& path);
+
+        /**
+        * Stores a path. Empty paths are not stored.
+        */
+        void   insert(const std::string& map_id, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, double robot_radius,
+                      const yarp::dev::Nav2D::Map2DPath& path);
+
+        /**
+        * Removes all the paths computed on the given map.
+        */
+        void   invalidate(const std::string& map_id);
+
+        void   clear();
+        size_t size() const { return m_paths.size(); }
+        size_t get_hits() const { return m_hits; }
+        size_t get_misses() const { return m_misses; }
+
+        private:
+        path_key_type make_key(const std::string& map_id, yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, double robot_radius) const;
+
+        size_t                                                m_bucket_size;
+        size_t                                                m_max_entries;
+        size_t                                                m_hits;
+        size_t                                                m_misses;
+        std::map<path_key_type, yarp::dev::Nav2D::Map2DPath> m_paths;
+    };
+};
+
+#endif
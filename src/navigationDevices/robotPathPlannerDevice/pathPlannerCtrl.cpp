@@ -30,6 +30,8 @@
 #include <yarp/dev/IRangefinder2D.h>
 #include <yarp/dev/INavigation2D.h>
 #include <string>
+#include <memory>
+#include <atomic>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -89,6 +91,8 @@ bool  PlannerThread::setRobotRadius(double size)
 {
     m_robot_radius = size;
     m_force_map_reload = true;
+    m_path_cache.clear();
+    m_path_cache_signatures.clear();
     return true;
 }
 
@@ -150,27 +154,62 @@ void  PlannerThread::readLaserData()
         m_laser_timeout_counter++;
     }
 
-    //transform the laser measurement in a temporary map
-    //the purpose of the following copy of m_temporary_obstacles_map in temp_map is to minimize the duration of the critical section
-    //protected by the mutex. Indeed enlargeObstacles() can take some time and should be outside the mutex.
-    m_temporary_obstacles_map_mutex.lock();
-    MapGrid2D temp_map = m_temporary_obstacles_map;
-    m_temporary_obstacles_map_mutex.unlock();
-    //here I am cleaning temp map from everything.
-    for (size_t y=0; y< temp_map.height(); y++)
-       for (size_t x=0; x< temp_map.width(); x++)
-            temp_map.setMapFlag(XYCell(x,y),MapGrid2D::MAP_CELL_FREE);
+    //transform the laser measurement in a temporary map.
+    //Only the cells marked during the previous use of the back buffer are cleaned and the enlargement is performed only
+    //around the laser cells, so that the cost of this function scales with the size of the scan instead of the size of the map.
+    MapGrid2D& temp_map = getTemporaryObstaclesBackBuffer();
+    std::vector<XYCell>& temp_cells = m_temporary_obstacles_cells[1 - m_temporary_obstacles_front];
+    for (size_t i=0; i< temp_cells.size(); i++)
+        temp_map.setMapFlag(temp_cells[i],MapGrid2D::MAP_CELL_FREE);
+    temp_cells.clear();
     //Fill the temp map with laser scans
     for (size_t i=0; i< m_laser_map_cells.size(); i++)
     {
-        temp_map.setMapFlag(m_laser_map_cells[i],MapGrid2D::MAP_CELL_TEMPORARY_OBSTACLE);
+        MapGrid2D::map_flags flag;
+        if (temp_map.getMapFlag(m_laser_map_cells[i], flag) && flag != MapGrid2D::MAP_CELL_TEMPORARY_OBSTACLE)
+        {
+            temp_map.setMapFlag(m_laser_map_cells[i],MapGrid2D::MAP_CELL_TEMPORARY_OBSTACLE);
+            temp_cells.push_back(m_laser_map_cells[i]);
+        }
     }
     //enlarge the laser scans
-    temp_map.enlargeObstacles(m_robot_radius);
-    //m_temporary_obstacles_map is now filled only with MAP_CELL_FREE,MAP_CELL_TEMPORARY_OBSTACLE and MAP_CELL_ENLARGED_OBSTACLE
-    m_temporary_obstacles_map_mutex.lock();
-    m_temporary_obstacles_map = temp_map;
-    m_temporary_obstacles_map_mutex.unlock();
+    map_utilites::enlarge_obstacles_around(temp_map, temp_cells, m_robot_radius);
+    //the temp map is now filled only with MAP_CELL_FREE,MAP_CELL_TEMPORARY_OBSTACLE and MAP_CELL_ENLARGED_OBSTACLE
+    publishTemporaryObstaclesBackBuffer();
+}
+
+MapGrid2D& PlannerThread::getTemporaryObstaclesBackBuffer()
+{
+    size_t back = 1 - m_temporary_obstacles_front;
+    //the back buffer is not the published snapshot, so it can be referenced only by a reader which took it before the last swap
+    //and it is still using it. In this case the reader keeps its (immutable) copy and the buffer is replaced by a new one.
+    if (m_temporary_obstacles_buffers[back].use_count() > 1)
+    {
+        m_temporary_obstacles_buffers[back] = std::make_shared<MapGrid2D>(*m_temporary_obstacles_buffers[back]);
+    }
+    //pairs with the release performed by the reader when it drops its reference
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    MapGrid2D& buffer = *m_temporary_obstacles_buffers[back];
+    if (m_temporary_obstacles_revision[back] != m_planner_workspace.revision())
+    {
+        //the map has been reloaded: the buffer takes the size of the new map and it is cleaned from everything
+        buffer = m_current_map;
+        for (size_t y=0; y< buffer.height(); y++)
+           for (size_t x=0; x< buffer.width(); x++)
+                buffer.setMapFlag(XYCell(x,y),MapGrid2D::MAP_CELL_FREE);
+        m_temporary_obstacles_cells[back].clear();
+        m_temporary_obstacles_revision[back] = m_planner_workspace.revision();
+    }
+    return buffer;
+}
+
+void PlannerThread::publishTemporaryObstaclesBackBuffer()
+{
+    size_t back = 1 - m_temporary_obstacles_front;
+    std::lock_guard<std::mutex> lock(m_temporary_obstacles_map_mutex);
+    m_temporary_obstacles_front = back;
+    m_temporary_obstacles_map = m_temporary_obstacles_buffers[back];
 }
 
 bool prepare_image(IplImage* & image_to_be_prepared, const IplImage* template_image)
@@ -262,63 +301,6 @@ void PlannerThread::run()
 
                     //send the final waypoint
                     yCInfo(PATHPLAN_CTRL, "sending the last waypoint (final goal)");
-                    {
-                        //send the tolerance to the inner controller
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("linear_tol");
-                        cmd.addDouble(m_goal_tolerance_lin);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd2, ans2;
-                        cmd2.addString("set");
-                        cmd2.addString("angular_tol");
-                        cmd2.addDouble(m_goal_tolerance_ang);
-                        m_port_commands_output.write(cmd2, ans2);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("min_lin_speed");
-                        cmd.addDouble(m_goal_min_lin_speed);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("max_lin_speed");
-                        cmd.addDouble(m_goal_max_lin_speed);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("min_ang_speed");
-                        cmd.addDouble(m_goal_min_ang_speed);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("max_ang_speed");
-                        cmd.addDouble(m_goal_max_ang_speed);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("ang_speed_gain");
-                        cmd.addDouble(m_goal_ang_gain);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("lin_speed_gain");
-                        cmd.addDouble(m_goal_lin_gain);
-                        m_port_commands_output.write(cmd, ans);
-                    }
                     sendFinalGoal();
                 }
                 else
@@ -330,48 +312,6 @@ void PlannerThread::run()
 
                     //send the next waypoint
                     yCInfo(PATHPLAN_CTRL, "sending the next waypoint");
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("min_lin_speed");
-                        cmd.addDouble(m_waypoint_min_lin_speed);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("max_lin_speed");
-                        cmd.addDouble(m_waypoint_max_lin_speed);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("min_ang_speed");
-                        cmd.addDouble(m_waypoint_min_ang_speed);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("max_ang_speed");
-                        cmd.addDouble(m_waypoint_max_ang_speed);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("ang_speed_gain");
-                        cmd.addDouble(m_waypoint_ang_gain);
-                        m_port_commands_output.write(cmd, ans);
-                    }
-                    {
-                        Bottle cmd, ans;
-                        cmd.addString("set");
-                        cmd.addString("lin_speed_gain");
-                        cmd.addDouble(m_waypoint_lin_gain);
-                        m_port_commands_output.write(cmd, ans);
-                    }
                     sendWaypoint();
                 }
             }
@@ -403,9 +343,29 @@ void PlannerThread::run()
                         m_port_commands_output.write(cmd, ans);
 
                         //update the map with the new obstacles
-                        map_utilites::update_obstacles_map(m_current_map, m_temporary_obstacles_map);
+                        m_new_obstacle_cells.clear();
+                        map_utilites::update_obstacles_map(m_current_map, *m_temporary_obstacles_buffers[m_temporary_obstacles_front], &m_new_obstacle_cells);
+                        for (size_t i = 0; i < m_new_obstacle_cells.size(); i++)
+                        {
+                            m_planner_workspace.set_occupied(m_new_obstacle_cells[i]);
+                        }
+                        //the incremental planner repairs only the part of its search tree affected by the new obstacles
+                        m_dstar_planner.update_cells(m_new_obstacle_cells);
+                        if (m_planner_algorithm == aStar_algorithm::search_algorithm_type::hpa_star)
+                        {
+                            m_hpa_graph.update_cells(m_planner_workspace, m_new_obstacle_cells);
+                        }
                         //the following enlargement is done in order to take away the robot from the obstacles where it is stuck
-                        m_temporary_obstacles_map.enlargeObstacles(0.1);
+                        //(the published map cannot be modified, so the enlarged obstacles are written on a copy of it)
+                        {
+                            size_t front = m_temporary_obstacles_front;
+                            MapGrid2D& enlarged_map = getTemporaryObstaclesBackBuffer();
+                            enlarged_map = *m_temporary_obstacles_buffers[front];
+                            m_temporary_obstacles_cells[1 - front] = m_temporary_obstacles_cells[front];
+                            m_temporary_obstacles_revision[1 - front] = m_temporary_obstacles_revision[front];
+                            map_utilites::enlarge_obstacles_around(enlarged_map, m_temporary_obstacles_cells[1 - front], 0.1);
+                            publishTemporaryObstaclesBackBuffer();
+                        }
                         //search for a new path
                         if (!recomputePath())
                         {
@@ -443,64 +403,6 @@ void PlannerThread::run()
                 //send the first waypoint
                 m_current_path_iterator = m_current_path->begin();
                 yCInfo(PATHPLAN_CTRL, "sending the first waypoint");
-
-                //send the tolerance to the inner controller
-                {
-                    Bottle cmd1, ans1;
-                    cmd1.addString("set");
-                    cmd1.addString("linear_tol");
-                    cmd1.addDouble(m_waypoint_tolerance_lin);
-                    m_port_commands_output.write(cmd1, ans1);
-                }
-                {
-                    Bottle cmd, ans;
-                    cmd.addString("set");
-                    cmd.addString("angular_tol");
-                    cmd.addDouble(m_waypoint_tolerance_ang);
-                    m_port_commands_output.write(cmd, ans);
-                }
-                {
-                    Bottle cmd, ans;
-                    cmd.addString("set");
-                    cmd.addString("max_lin_speed");
-                    cmd.addDouble(m_waypoint_max_lin_speed);
-                    m_port_commands_output.write(cmd, ans);
-                }
-                {
-                    Bottle cmd, ans;
-                    cmd.addString("set");
-                    cmd.addString("max_ang_speed");
-                    cmd.addDouble(m_waypoint_max_ang_speed);
-                    m_port_commands_output.write(cmd, ans);
-                }
-                {
-                    Bottle cmd, ans;
-                    cmd.addString("set");
-                    cmd.addString("min_lin_speed");
-                    cmd.addDouble(m_waypoint_min_lin_speed);
-                    m_port_commands_output.write(cmd, ans);
-                }
-                {
-                    Bottle cmd, ans;
-                    cmd.addString("set");
-                    cmd.addString("min_ang_speed");
-                    cmd.addDouble(m_waypoint_min_ang_speed);
-                    m_port_commands_output.write(cmd, ans);
-                }
-                {
-                    Bottle cmd, ans;
-                    cmd.addString("set");
-                    cmd.addString("ang_speed_gain");
-                    cmd.addDouble(m_waypoint_ang_gain);
-                    m_port_commands_output.write(cmd, ans);
-                }
-                {
-                    Bottle cmd, ans;
-                    cmd.addString("set");
-                    cmd.addString("lin_speed_gain");
-                    cmd.addDouble(m_waypoint_lin_gain);
-                    m_port_commands_output.write(cmd, ans);
-                }
                 sendWaypoint();
             }
             else
@@ -623,13 +525,31 @@ bool PlannerThread::reloadCurrentMap()
     bool map_get_succesfull = this->m_iMap->get_map(m_localization_data.map_id, m_current_map);
     if (map_get_succesfull)
     {
-        m_temporary_obstacles_map_mutex.lock();
-        m_temporary_obstacles_map = m_current_map;
-        m_temporary_obstacles_map_mutex.unlock();
         yCInfo(PATHPLAN_CTRL) << "Map '" << m_localization_data.map_id << "' successfully obtained from server";
         m_current_map.enlargeObstacles(m_robot_radius);
         m_augmented_map = m_current_map;
         yCDebug(PATHPLAN_CTRL, ) << "Obstacles enlargement performed (" << m_robot_radius << "m)";
+        m_planner_workspace.build(m_current_map);
+        if (m_planner_algorithm == aStar_algorithm::search_algorithm_type::hpa_star)
+        {
+            prepareHpaGraph();
+        }
+        //the map is reloaded by every goto request: the cached paths are discarded (and the warm-up repeated)
+        //only if the obstacles have changed since they were computed
+        if (m_use_path_cache)
+        {
+            uint64_t signature = hpaStar_algorithm::compute_signature(m_planner_workspace);
+            auto it = m_path_cache_signatures.find(m_current_map.getMapName());
+            if (it == m_path_cache_signatures.end() || it->second != signature)
+            {
+                m_path_cache.invalidate(m_current_map.getMapName());
+                m_path_cache_signatures[m_current_map.getMapName()] = signature;
+                if (m_path_cache_warmup)
+                {
+                    warmUpPathCache();
+                }
+            }
+        }
         return true;
     }
     else
@@ -648,6 +568,28 @@ bool PlannerThread::reloadCurrentMap()
     return true;
 }
 
+void PlannerThread::prepareHpaGraph()
+{
+    //the cached graph is reused only if it has been built from the same obstacles (the map on the server may have been changed)
+    std::string map_name = m_current_map.getMapName();
+    auto it = m_hpa_graph_cache.find(map_name);
+    if (it != m_hpa_graph_cache.end() && it->second->get_cluster_size() == m_hpa_cluster_size)
+    {
+        m_hpa_graph = *(it->second);
+        if (m_hpa_graph.attach(m_planner_workspace))
+        {
+            yCDebug(PATHPLAN_CTRL) << "HPA* graph of map '" << map_name << "' reused from cache";
+            return;
+        }
+    }
+    double t1 = yarp::os::Time::now();
+    m_hpa_graph.build(m_planner_workspace, m_hpa_cluster_size);
+    double t2 = yarp::os::Time::now();
+    yCInfo(PATHPLAN_CTRL) << "HPA* graph of map '" << map_name << "' built in" << t2 - t1 << "s:"
+                          << m_hpa_graph.get_number_of_clusters() << "clusters," << m_hpa_graph.get_number_of_portals() << "portals";
+    m_hpa_graph_cache[map_name] = std::make_shared<const hpaStar_algorithm::hpa_graph>(m_hpa_graph);
+}
+
 bool  PlannerThread::getCurrentPath(yarp::dev::Nav2D::Map2DPath& current_path) const
 {
     if (m_current_path != nullptr)
@@ -674,12 +616,18 @@ bool  PlannerThread::getCurrentPath(yarp::dev::Nav2D::Map2DPath& current_path) c
 
 bool PlannerThread::getOstaclesMap(MapGrid2D& obstacles_map) 
 {
-    m_temporary_obstacles_map_mutex.lock();
-    obstacles_map = m_temporary_obstacles_map;
-    m_temporary_obstacles_map_mutex.unlock();
+    //the copy is performed outside the mutex, on the snapshot, which is never modified by the planner thread
+    std::shared_ptr<const MapGrid2D> snapshot = getOstaclesMapSnapshot();
+    obstacles_map = *snapshot;
     return true;
 }
 
+std::shared_ptr<const MapGrid2D> PlannerThread::getOstaclesMapSnapshot()
+{
+    std::lock_guard<std::mutex> lock(m_temporary_obstacles_map_mutex);
+    return m_temporary_obstacles_map;
+}
+
 void PlannerThread::sendWaypoint()
 {
     size_t path_size = m_current_path->size();
@@ -710,23 +658,74 @@ void PlannerThread::sendWaypoint()
         loc.theta = m_final_goal.theta;
     }
     yCDebug(PATHPLAN_CTRL, "sending command: %s", loc.toString().c_str());
-    m_iInnerNav_target->gotoTargetByAbsoluteLocation(loc);
-
-    //get inner navigation status
-    NavigationStatusEnum inner_status;
-    m_iInnerNav_ctrl->getNavigationStatus(inner_status);
-    m_inner_status = inner_status;
+    sendTargetToInnerController(loc, false);
 }
 
 void PlannerThread::sendFinalGoal()
 {
-    if (std::isnan(m_final_goal.theta) == false)
+    yCDebug(PATHPLAN_CTRL, "sending command: %s", m_final_goal.toString().c_str());
+    sendTargetToInnerController(m_final_goal, true);
+}
+
+void PlannerThread::sendTargetToInnerController(const Map2DLocation& loc, bool final_goal)
+{
+    //the inner controller uses different tolerances, speed limits and gains for the intermediate waypoints and for the final goal
+    const double linear_tol    = final_goal ? m_goal_tolerance_lin : m_waypoint_tolerance_lin;
+    const double angular_tol   = final_goal ? m_goal_tolerance_ang : m_waypoint_tolerance_ang;
+    const double max_lin_speed = final_goal ? m_goal_max_lin_speed : m_waypoint_max_lin_speed;
+    const double max_ang_speed = final_goal ? m_goal_max_ang_speed : m_waypoint_max_ang_speed;
+    const double min_lin_speed = final_goal ? m_goal_min_lin_speed : m_waypoint_min_lin_speed;
+    const double min_ang_speed = final_goal ? m_goal_min_ang_speed : m_waypoint_min_ang_speed;
+    const double ang_gain      = final_goal ? m_goal_ang_gain : m_waypoint_ang_gain;
+    const double lin_gain      = final_goal ? m_goal_lin_gain : m_waypoint_lin_gain;
+
+    if (m_use_waypoint_profile_cmd)
+    {
+        //all the parameters and the target are sent with a single rpc, so that they are applied at once by the inner controller
+        Bottle cmd, ans;
+        cmd.addString("waypoint_profile");
+        { Bottle& b = cmd.addList(); b.addString("linear_tol");     b.addDouble(linear_tol); }
+        { Bottle& b = cmd.addList(); b.addString("angular_tol");    b.addDouble(angular_tol); }
+        { Bottle& b = cmd.addList(); b.addString("max_lin_speed");  b.addDouble(max_lin_speed); }
+        { Bottle& b = cmd.addList(); b.addString("max_ang_speed");  b.addDouble(max_ang_speed); }
+        { Bottle& b = cmd.addList(); b.addString("min_lin_speed");  b.addDouble(min_lin_speed); }
+        { Bottle& b = cmd.addList(); b.addString("min_ang_speed");  b.addDouble(min_ang_speed); }
+        { Bottle& b = cmd.addList(); b.addString("ang_speed_gain"); b.addDouble(ang_gain); }
+        { Bottle& b = cmd.addList(); b.addString("lin_speed_gain"); b.addDouble(lin_gain); }
+        {
+            Bottle& b = cmd.addList();
+            b.addString("target");
+            b.addDouble(loc.x);
+            b.addDouble(loc.y);
+            if (std::isnan(loc.theta) == false)
+            {
+                b.addDouble(loc.theta);
+            }
+        }
+        m_port_commands_output.write(cmd, ans);
+        if (ans.get(0).asString() != "waypoint_profile set.")
+        {
+            //the inner controller is an older version which does not support the command. Nothing has been applied, so fall back
+            //to the separate commands, from now on.
+            yCWarning(PATHPLAN_CTRL) << "The inner controller does not support the waypoint_profile command, using separate set commands";
+            m_use_waypoint_profile_cmd = false;
+        }
+    }
+
+    if (m_use_waypoint_profile_cmd == false)
     {
-        //add the orientation to the last waypoint
-        yCDebug(PATHPLAN_CTRL, );
+        const char* names[8] = { "linear_tol", "angular_tol", "max_lin_speed", "max_ang_speed", "min_lin_speed", "min_ang_speed", "ang_speed_gain", "lin_speed_gain" };
+        const double values[8] = { linear_tol, angular_tol, max_lin_speed, max_ang_speed, min_lin_speed, min_ang_speed, ang_gain, lin_gain };
+        for (size_t i = 0; i < 8; i++)
+        {
+            Bottle cmd, ans;
+            cmd.addString("set");
+            cmd.addString(names[i]);
+            cmd.addDouble(values[i]);
+            m_port_commands_output.write(cmd, ans);
+        }
+        m_iInnerNav_target->gotoTargetByAbsoluteLocation(loc);
     }
-    yCDebug(PATHPLAN_CTRL, "sending command: %s", m_final_goal.toString().c_str());
-    m_iInnerNav_target->gotoTargetByAbsoluteLocation(m_final_goal);
 
     //get inner navigation status
     NavigationStatusEnum inner_status;
@@ -734,6 +733,80 @@ void PlannerThread::sendFinalGoal()
     m_inner_status = inner_status;
 }
 
+bool PlannerThread::computePath(XYCell start, XYCell goal, Map2DPath& computed_path, Map2DPath& simplified_path)
+{
+    bool b = false;
+    if (m_planner_algorithm == aStar_algorithm::search_algorithm_type::dstar_lite)
+    {
+        b = map_utilites::findPath(m_dstar_planner, m_planner_workspace, m_current_map, start, goal, computed_path);
+    }
+    else if (m_planner_algorithm == aStar_algorithm::search_algorithm_type::hpa_star)
+    {
+        b = map_utilites::findPath(m_hpa_graph, m_planner_workspace, m_current_map, start, goal, computed_path);
+    }
+    else
+    {
+        b = map_utilites::findPath(m_planner_workspace, m_current_map, start, goal, computed_path, m_planner_algorithm);
+    }
+    if (!b)
+    {
+        return false;
+    }
+
+    //search for an simpler path (waypoint optimization).
+    //Theta* paths are already composed by straight segments, so they do not need to be simplified.
+    if (m_planner_algorithm == aStar_algorithm::search_algorithm_type::theta_star)
+    {
+        simplified_path = computed_path;
+    }
+    else
+    {
+        map_utilites::simplifyPath(m_current_map, computed_path, simplified_path);
+    }
+    return true;
+}
+
+void PlannerThread::warmUpPathCache()
+{
+    //precomputes the paths between all the pairs of locations of the current map stored in the map server.
+    //N locations require N*(N-1) path searches, which are performed synchronously by the caller of reloadCurrentMap(),
+    //i.e. the planner thread or the device thread serving a goto request, both holding m_mutex: the planner loop
+    //is suspended until the warm-up is completed.
+    std::vector<std::string> location_names;
+    if (m_iMap->getLocationsList(location_names) == false)
+    {
+        yCError(PATHPLAN_CTRL) << "warmUpPathCache(): unable to get the list of locations from the map server";
+        return;
+    }
+    std::vector<XYCell> cells;
+    for (auto it = location_names.begin(); it != location_names.end(); it++)
+    {
+        Map2DLocation loc;
+        if (m_iMap->getLocation(*it, loc) && loc.map_id == m_current_map.getMapName())
+        {
+            XYCell c = m_current_map.toXYCell(loc);
+            if (m_current_map.isInsideMap(c)) cells.push_back(c);
+        }
+    }
+
+    double t1 = yarp::os::Time::now();
+    size_t computed = 0;
+    for (size_t i = 0; i < cells.size(); i++)
+        for (size_t j = 0; j < cells.size(); j++)
+        {
+            if (i == j) continue;
+            Map2DPath computed_path;
+            Map2DPath simplified_path;
+            if (computePath(cells[i], cells[j], computed_path, simplified_path))
+            {
+                m_path_cache.insert(m_current_map.getMapName(), cells[i], cells[j], m_robot_radius, simplified_path);
+                computed++;
+            }
+        }
+    double t2 = yarp::os::Time::now();
+    yCInfo(PATHPLAN_CTRL) << "Path cache warm-up:" << computed << "paths between" << cells.size() << "locations computed in" << t2 - t1 << "s";
+}
+
 bool PlannerThread::startPath()
 {
     yarp::math::Vec2D<double> start_vec;
@@ -764,8 +837,29 @@ bool PlannerThread::startPath()
     m_computed_simplified_path.clear();
     m_planner_status = navigation_status_thinking;
 
-    //search for a path
-    bool b = map_utilites::findPath(m_current_map, start, goal, m_computed_path);
+    //search for a path. The path cache is used only when the simplified path is requested, because it does not store the full path
+    bool b = false;
+    bool cached = false;
+    if (m_use_path_cache && m_use_optimized_path)
+    {
+        std::shared_ptr<const MapGrid2D> obstacles_map = getOstaclesMapSnapshot();
+        cached = m_path_cache.find(m_current_map.getMapName(), start, goal, m_robot_radius, m_current_map, obstacles_map.get(), m_computed_simplified_path);
+    }
+    if (cached)
+    {
+        //the full path is not stored in the cache, the simplified one is used in its place
+        //(so the size of the full path reported below is the one of the simplified path)
+        m_computed_path = m_computed_simplified_path;
+        b = true;
+    }
+    else
+    {
+        b = computePath(start, goal, m_computed_path, m_computed_simplified_path);
+        if (b && m_use_path_cache)
+        {
+            m_path_cache.insert(m_current_map.getMapName(), start, goal, m_robot_radius, m_computed_simplified_path);
+        }
+    }
     if (!b)
     {
         yCError (PATHPLAN_CTRL, "path not found");
@@ -773,10 +867,7 @@ bool PlannerThread::startPath()
         return false;
     }
     double t2 = yarp::os::Time::now();
-
-    //search for an simpler path (waypoint optimization)
-    map_utilites::simplifyPath(m_current_map, m_computed_path, m_computed_simplified_path);
-    yCInfo(PATHPLAN_CTRL, "path size:%d simplified path size:%d time: %.2f", (int)m_computed_path.size(), (int)m_computed_simplified_path.size(), t2 - t1);
+    yCInfo(PATHPLAN_CTRL, "path size:%d simplified path size:%d time: %.2f%s", (int)m_computed_path.size(), (int)m_computed_simplified_path.size(), t2 - t1, cached ? " (cached)" : "");
 
     //choose the path to use
     if (m_use_optimized_path)
@@ -43,10 +43,13 @@
 #include <yarp/dev/ILocalization2D.h>
 #include <yarp/dev/INavigation2D.h>
 #include <string>
+#include <memory>
+#include <map>
 #include <yarp/rosmsg/visualization_msgs/MarkerArray.h>
 #include <yarp/dev/Map2DPath.h>
 #include <yarp/dev/Map2DLocation.h>
 #include "map.h"
+#include "pathCache.h"
 
 using namespace std;
 
@@ -92,6 +95,7 @@ class PlannerThread: public yarp::os::PeriodicThread
     double    m_robot_laser_y;       //m
     double    m_robot_laser_t;       //deg
     bool      m_use_optimized_path;
+    aStar_algorithm::search_algorithm_type m_planner_algorithm;
     double    m_min_laser_angle;
     double    m_max_laser_angle;
     double    m_laser_angle_of_view;
@@ -100,16 +104,40 @@ class PlannerThread: public yarp::os::PeriodicThread
 
     //recovery
     bool      m_enable_try_recovery;
+    bool      m_use_waypoint_profile_cmd;  //if true, the target and its parameters are sent to the inner controller with a single rpc
     size_t    m_recovery_attempt=0;
     size_t    m_max_recovery_attempts=5;
 
     //storage for the environment map
     yarp::dev::Nav2D::MapGrid2D m_current_map;
-    yarp::dev::Nav2D::MapGrid2D m_temporary_obstacles_map;
+    //double buffer of the map containing the obstacles detected by the laser: readLaserData() fills the back buffer,
+    //then publishes it as an immutable snapshot with a pointer swap. The readers take a reference to the snapshot,
+    //so they never copy the map inside the mutex. A buffer still referenced by a reader is never modified.
+    std::shared_ptr<yarp::dev::Nav2D::MapGrid2D>       m_temporary_obstacles_buffers[2];
+    std::shared_ptr<const yarp::dev::Nav2D::MapGrid2D> m_temporary_obstacles_map;       //the published snapshot
+    std::vector<yarp::dev::Nav2D::XYCell> m_temporary_obstacles_cells[2];    //the non-free cells of each buffer
+    size_t                                m_temporary_obstacles_revision[2]; //the map revision each buffer has been sized for
+    size_t                                m_temporary_obstacles_front;
     std::mutex m_temporary_obstacles_map_mutex;
     yarp::dev::Nav2D::MapGrid2D m_augmented_map;
     bool      m_force_map_reload;
 
+    //search memory, sized once per map and reused by all the path computations
+    aStar_algorithm::planner_workspace      m_planner_workspace;
+    std::vector<yarp::dev::Nav2D::XYCell>   m_new_obstacle_cells;
+    dStarLite_algorithm::dstar_lite_planner m_dstar_planner;
+    //abstract graph used by HPA*. Building it is expensive, so a pristine copy for each loaded map is kept in the cache,
+    //while m_hpa_graph is the working copy, which is also updated with the obstacles found during the recovery.
+    hpaStar_algorithm::hpa_graph            m_hpa_graph;
+    size_t                                  m_hpa_cluster_size;
+    std::map<std::string, std::shared_ptr<const hpaStar_algorithm::hpa_graph>> m_hpa_graph_cache;
+    //simplified paths already computed, reused when the robot is sent again between the same locations (disabled by default).
+    //Only the simplified path is stored: on a hit it is also used in place of the full path.
+    pathCache::path_cache                   m_path_cache;
+    bool                                    m_use_path_cache;
+    bool                                    m_path_cache_warmup; //if true, the paths between all the locations of a map are computed when the map changes
+    std::map<std::string, uint64_t>         m_path_cache_signatures; //obstacles of each map at the time its paths were cached
+
     //yarp device drivers and interfaces
     yarp::dev::PolyDriver                                  m_ptf;
     yarp::dev::PolyDriver                                  m_pLoc;
@@ -272,21 +300,29 @@ class PlannerThread: public yarp::os::PeriodicThread
     */
     void          getTimeouts(int& localiz, int& laser, int& inner_status);
 
+    //rebuilds the search structures and the path cache (including the warm-up): to be called holding m_mutex
     bool          reloadCurrentMap();
     bool          getCurrentWaypoint(yarp::dev::Nav2D::Map2DLocation &loc) const;
     bool          getCurrentMap(yarp::dev::Nav2D::MapGrid2D& current_map) const;
     bool          getCurrentPath(yarp::dev::Nav2D::Map2DPath& current_path) const;
     bool          getOstaclesMap(yarp::dev::Nav2D::MapGrid2D& obstacles_map);
+    std::shared_ptr<const yarp::dev::Nav2D::MapGrid2D> getOstaclesMapSnapshot();
     bool          setRobotRadius(double size);
     bool          getRobotRadius(double& size);
     void          resetAttemptCounter();
 
     private:
     bool          startPath();
+    bool          computePath(yarp::dev::Nav2D::XYCell start, yarp::dev::Nav2D::XYCell goal, yarp::dev::Nav2D::Map2DPath& computed_path, yarp::dev::Nav2D::Map2DPath& simplified_path);
+    void          warmUpPathCache();
     void          sendWaypoint();
     void          sendFinalGoal();
+    void          sendTargetToInnerController(const yarp::dev::Nav2D::Map2DLocation& loc, bool final_goal);
     bool          readLocalizationData();
     void          readLaserData();
+    yarp::dev::Nav2D::MapGrid2D& getTemporaryObstaclesBackBuffer();
+    void          publishTemporaryObstaclesBackBuffer();
+    void          prepareHpaGraph();
     bool          readInnerNavigationStatus();
     bool          getCurrentWaypoint(yarp::dev::Nav2D::XYCell &c) const;
     void          abortNavigation();
@@ -46,6 +46,8 @@ PlannerThread::PlannerThread(double _period, Searchable &_cfg) :
     m_waypoint_min_lin_speed = 0.0;
     m_waypoint_min_ang_speed = 0.0;
     m_use_optimized_path = true;
+    m_planner_algorithm = aStar_algorithm::search_algorithm_type::astar;
+    m_hpa_cluster_size = hpaStar_algorithm::default_cluster_size;
     m_current_path = &m_computed_simplified_path;
     m_min_waypoint_distance = 0;
     m_iLaser = 0;
@@ -57,11 +59,20 @@ PlannerThread::PlannerThread(double _period, Searchable &_cfg) :
     m_robot_laser_y = 0;
     m_robot_laser_t = 0;
     m_enable_try_recovery=false;
+    m_use_waypoint_profile_cmd = true;
+    m_use_path_cache = false;
+    m_path_cache_warmup = false;
     m_stats_time_curr = yarp::os::Time::now();
     m_stats_time_last = yarp::os::Time::now();
     m_iInnerNav_ctrl = 0;
     m_iInnerNav_target = 0;
     m_force_map_reload = false;
+    m_temporary_obstacles_buffers[0] = std::make_shared<MapGrid2D>();
+    m_temporary_obstacles_buffers[1] = std::make_shared<MapGrid2D>();
+    m_temporary_obstacles_map = m_temporary_obstacles_buffers[0];
+    m_temporary_obstacles_front = 0;
+    m_temporary_obstacles_revision[0] = 0;
+    m_temporary_obstacles_revision[1] = 0;
     m_navigation_started_at_timeX = 0;
     m_final_goal_reached_at_timeX = 0;
 }
@@ -119,6 +130,7 @@ bool PlannerThread::threadInit()
     else { yCError(PATHPLAN_INIT) << "Missing min_waypoint_distance parameter"; return false; }
     if (navigation_group.check("enable_try_recovery")) { m_enable_try_recovery = (navigation_group.find("enable_try_recovery").asInt() == 1); }
     else { yCError(PATHPLAN_INIT) << "Missing enable_try_recovery parameter"; return false; }
+    if (navigation_group.check("use_waypoint_profile_cmd")) { m_use_waypoint_profile_cmd = (navigation_group.find("use_waypoint_profile_cmd").asInt() == 1); }
 
     Bottle general_group = m_cfg.findGroup("PATHPLANNER_GENERAL");
     if (general_group.isNull())
@@ -145,6 +157,49 @@ bool PlannerThread::threadInit()
     if (localization_group.check("localizationServer_name")) localizationServer_name = localization_group.find("localizationServer_name").asString();
     if (localization_group.check("mapServer_name")) mapServer_name = localization_group.find("mapServer_name").asString();
     if (general_group.check("name")) localName = general_group.find("name").asString();
+    if (general_group.check("planner_algorithm"))
+    {
+        std::string algorithm_name = general_group.find("planner_algorithm").asString();
+        if (aStar_algorithm::string_to_algorithm(algorithm_name, m_planner_algorithm) == false)
+        {
+            yCError(PATHPLAN_INIT) << "Invalid planner_algorithm parameter:" << algorithm_name << "(valid values: astar, jps, theta_star, dstar_lite, hpa_star)";
+            return false;
+        }
+    }
+    yCInfo(PATHPLAN_INIT) << "Using planner algorithm:" << aStar_algorithm::algorithm_to_string(m_planner_algorithm);
+    if (general_group.check("hpa_cluster_size"))
+    {
+        int cluster_size = general_group.find("hpa_cluster_size").asInt();
+        if (cluster_size < 4)
+        {
+            yCError(PATHPLAN_INIT) << "Invalid hpa_cluster_size parameter:" << cluster_size << "(minimum value: 4)";
+            return false;
+        }
+        m_hpa_cluster_size = size_t(cluster_size);
+    }
+    if (general_group.check("use_path_cache")) { m_use_path_cache = (general_group.find("use_path_cache").asInt() == 1); }
+    if (general_group.check("path_cache_warmup")) { m_path_cache_warmup = (general_group.find("path_cache_warmup").asInt() == 1); }
+    if (general_group.check("path_cache_bucket_size"))
+    {
+        int bucket_size = general_group.find("path_cache_bucket_size").asInt();
+        if (bucket_size < 1)
+        {
+            yCError(PATHPLAN_INIT) << "Invalid path_cache_bucket_size parameter:" << bucket_size << "(minimum value: 1)";
+            return false;
+        }
+        m_path_cache.set_bucket_size(size_t(bucket_size));
+    }
+    if (general_group.check("path_cache_max_size"))
+    {
+        int max_size = general_group.find("path_cache_max_size").asInt();
+        if (max_size < 1)
+        {
+            yCError(PATHPLAN_INIT) << "Invalid path_cache_max_size parameter:" << max_size << "(minimum value: 1)";
+            return false;
+        }
+        m_path_cache.set_max_entries(size_t(max_size));
+    }
+    yCInfo(PATHPLAN_INIT) << "Path cache:" << (m_use_path_cache ? "enabled" : "disabled") << (m_path_cache_warmup ? "(with warm-up)" : "");
     
     bool ff = geometry_group.check("robot_radius");
     ff &= geometry_group.check("laser_pos_x");
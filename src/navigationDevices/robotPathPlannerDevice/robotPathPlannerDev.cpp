@@ -135,10 +135,13 @@ bool robotPathPlannerDev::read(yarp::os::ConnectionReader& connection)
 
 bool robotPathPlannerDev::gotoTargetByAbsoluteLocation(Map2DLocation loc)
 {
+    //the map and the search structures are shared with PlannerThread::run()
+    m_plannerThread->m_mutex.wait();
     bool b = true;
     b &= m_plannerThread->reloadCurrentMap();
     b &= m_plannerThread->setNewAbsTarget(loc);
     m_plannerThread->resetAttemptCounter();
+    m_plannerThread->m_mutex.post();
     return b;
 }
 
@@ -148,16 +151,20 @@ bool robotPathPlannerDev::gotoTargetByRelativeLocation(double x, double y, doubl
     v.push_back(x);
     v.push_back(y);
     v.push_back(theta);
+    m_plannerThread->m_mutex.wait();
     bool b = true;
     b &= m_plannerThread->reloadCurrentMap();
     b &= m_plannerThread->setNewRelTarget(v);
     m_plannerThread->resetAttemptCounter();
+    m_plannerThread->m_mutex.post();
     return b;
 }
 
 bool robotPathPlannerDev::recomputeCurrentNavigationPath()
 {
+    m_plannerThread->m_mutex.wait();
     bool b= m_plannerThread->recomputePath();
+    m_plannerThread->m_mutex.post();
     if (b==false)
     {
         yCError(PATHPLAN_DEV) << "robotPathPlannerDev::recomputeCurrentNavigationPath(). An error occurred while performing the requested operation.";
@@ -171,10 +178,12 @@ bool robotPathPlannerDev::gotoTargetByRelativeLocation(double x, double y)
     yarp::sig::Vector v;
     v.push_back(x);
     v.push_back(y);
+    m_plannerThread->m_mutex.wait();
     bool b = true;
     b &= m_plannerThread->reloadCurrentMap();
     b &= m_plannerThread->setNewRelTarget(v);
     m_plannerThread->resetAttemptCounter();
+    m_plannerThread->m_mutex.post();
     return b;
 }
 
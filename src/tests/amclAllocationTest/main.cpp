@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2006-2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+/**
+ * Checks that an update of the amcl particle filter does not allocate memory once the filter is warmed up.
+ * A robot with two lasers moves in a synthetic map. At each tick the scans are written in the measurement buffers
+ * of the lasers, as done by the localizer when it reads them, then update_filter() runs the same steps of
+ * amclLocalizerThread::updateFilter(): odometry action, conversion of the scan of each laser (compensation of the
+ * motion since the scan, thresholds and bearings) and fusion in the weights, resampling, hypotheses of the clusters
+ * and compute governor, which changes the number of beams and the particle limit.
+ * The calls to operator new and (on glibc) to malloc made by update_filter() are counted during the ticks which
+ * follow the warm-up, for each laser model and for a single thread and a pool of threads.
+ * The program returns a nonzero value if any allocation is detected.
+ */
+
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/dev/IRangefinder2D.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "amcl/pf/pf.h"
+#include "amcl/map/map.h"
+#include "amcl/sensors/amcl_laser.h"
+#include "amcl/sensors/amcl_odom.h"
+#include "amcl/sensors/amcl_worker_pool.h"
+
+using namespace yarp::os;
+using namespace amcl;
+using namespace std;
+
+YARP_LOG_COMPONENT(ALLOCATION_TEST, "navigation.amclAllocationTest")
+
+//the allocations are counted only while counting_enabled is set, i.e. during the measured ticks
+static std::atomic<bool> counting_enabled(false);
+static std::atomic<long> allocation_count(0);
+
+static inline void count_allocation()
+{
+    if (counting_enabled.load(std::memory_order_relaxed))
+    {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    count_allocation();
+    void* p = std::malloc(size ? size : 1);
+    if (!p) { throw std::bad_alloc(); }
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    count_allocation();
+    void* p = std::malloc(size ? size : 1);
+    if (!p) { throw std::bad_alloc(); }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GLIBC__)
+//the C part of amcl allocates with malloc(): glibc allows to replace it and to forward to its own implementation.
+//The operator new above goes through these functions too, so with glibc each allocation made with new is counted twice.
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+extern "C" void __libc_free(void* p);
+
+extern "C" void* malloc(size_t size)
+{
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    count_allocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* p, size_t size)
+{
+    count_allocation();
+    return __libc_realloc(p, size);
+}
+
+extern "C" void free(void* p)
+{
+    __libc_free(p);
+}
+#endif
+
+//the fields of amclLocalizerThread::laser_device_t used by the update
+struct laser_type
+{
+    std::vector<yarp::dev::LaserMeasurementData> measurement_data;
+    pf_vector_t measurement_odom;   //odometry when the scan was received
+    double min_laser_angle;         //deg
+    double horizontal_resolution;   //deg
+    double min_laser_distance;
+    double max_laser_distance;
+    pf_vector_t mounting_pose;      //pose in the robot frame
+    AMCLLaser* model;
+    AMCLLaserData data;
+};
+
+//the fields of amcl_hyp_t
+struct hyp_type
+{
+    double weight;
+    pf_vector_t pf_pose_mean;
+    pf_matrix_t pf_pose_cov;
+};
+
+static const int    map_cells = 200;
+static const double map_resolution = 0.05;
+static const int    laser_readings = 360;
+static const double laser_max_range = 8.0;
+static const double laser_min_range = 0.1;
+static const int    laser_max_beams = 30;
+
+//a room with a wall in the middle and a few square obstacles
+static map_t* create_map()
+{
+    map_t* map = map_alloc();
+    map->size_x = map_cells;
+    map->size_y = map_cells;
+    map->scale = map_resolution;
+    map->origin_x = 0;
+    map->origin_y = 0;
+    map->occ_state = (int8_t*)malloc(sizeof(int8_t) * map->size_x * map->size_y);
+    for (int y = 0; y < map->size_y; y++)
+    {
+        for (int x = 0; x < map->size_x; x++)
+        {
+            bool border = x < 2 || y < 2 || x >= map->size_x - 2 || y >= map->size_y - 2;
+            bool wall = x == map->size_x / 2 && y > map->size_y / 3;
+            bool obstacle = (x / 20) % 3 == 1 && (y / 20) % 3 == 1 && x % 20 < 6 && y % 20 < 6;
+            map->occ_state[MAP_INDEX(map, x, y)] = (border || wall || obstacle) ? +1 : -1;
+        }
+    }
+    return map;
+}
+
+static pf_vector_t uniform_pose(void* arg, pf_rng_t* rng)
+{
+    map_t* map = (map_t*)arg;
+    double half_size = map->size_x * map->scale / 2;
+    pf_vector_t p;
+    p.v[0] = map->origin_x + (pf_rng_uniform(rng) - 0.5) * 2 * half_size;
+    p.v[1] = map->origin_y + (pf_rng_uniform(rng) - 0.5) * 2 * half_size;
+    p.v[2] = pf_rng_uniform(rng) * 2 * M_PI - M_PI;
+    return p;
+}
+
+//pose of the robot, which moves along a circle, at the given tick
+static pf_vector_t robot_pose(int tick)
+{
+    double a = tick * 0.05;
+    pf_vector_t p;
+    p.v[0] = -2.0 + 1.5 * cos(a);
+    p.v[1] = 1.5 * sin(a);
+    p.v[2] = a + M_PI / 2;
+    return p;
+}
+
+//ray-casts the scan seen from the true pose of the robot into the measurement buffer of the laser, which has
+//laser_readings elements, as the localizer does when it receives a scan
+static void simulate_scan(map_t* map, const pf_vector_t& robot, laser_type& laser)
+{
+    pf_vector_t laser_world = pf_vector_coord_add(laser.mounting_pose, robot);
+    for (int i = 0; i < laser_readings; i++)
+    {
+        double bearing = (laser.min_laser_angle + i * laser.horizontal_resolution) * M_PI / 180.0;
+        double range = map_calc_range(map, laser_world.v[0], laser_world.v[1], laser_world.v[2] + bearing, laser_max_range);
+        laser.measurement_data[i].set_polar(range, bearing);
+    }
+    laser.measurement_odom = robot;
+}
+
+//the same steps of amclLocalizerThread::integrateLaser()
+static void integrate_laser(pf_t* pf, laser_type& laser, const pf_vector_t& pose)
+{
+    pf_vector_t scan_base_pose = pf_vector_coord_sub(laser.measurement_odom, pose);
+    pf_vector_t laser_pose = pf_vector_coord_add(laser.mounting_pose, scan_base_pose);
+    laser.model->SetLaserPose(laser_pose);
+
+    AMCLLaserData& ldata = laser.data;
+    ldata.sensor = laser.model;
+    ldata.Resize(laser.measurement_data.size());
+    double angle_min = laser.min_laser_angle * M_PI / 180.0;
+    double angle_increment = laser.horizontal_resolution * M_PI / 180.0;
+    angle_increment = fmod(angle_increment + 5 * M_PI, 2 * M_PI) - M_PI;
+    ldata.range_max = std::min(laser.max_laser_distance, laser_max_range);
+    double range_min = std::max(laser.min_laser_distance, laser_min_range);
+    for (int i = 0; i < ldata.range_count; i++)
+    {
+        double rho = 0;
+        double theta = 0;
+        laser.measurement_data[i].get_polar(rho, theta);
+        ldata.ranges[i][0] = (rho <= range_min) ? ldata.range_max : rho;
+        ldata.ranges[i][1] = angle_min + (i * angle_increment);
+    }
+    laser.model->WeightSensor(pf, (AMCLSensorData*)&ldata);
+}
+
+//the same steps of amclLocalizerThread::updateFilter(), for an update requested by the motion of the robot.
+//Returns the CPU time of the update, as measured by the compute governor
+static double update_filter(pf_t* pf, AMCLOdom& odom, vector<laser_type>& lasers, AMCLWorkerPool& pool,
+                          vector<hyp_type>& hyps, int max_particles, int tick)
+{
+    double cpu_start = AMCLWorkerPool::ThreadCpuTime();
+    pool.TakeWorkerCpuTime();
+
+    pf_vector_t previous = robot_pose(tick - 1);
+    pf_vector_t pose = robot_pose(tick);
+
+    AMCLOdomData odata;
+    odata.pose = pose;
+    odata.delta.v[0] = pose.v[0] - previous.v[0];
+    odata.delta.v[1] = pose.v[1] - previous.v[1];
+    odata.delta.v[2] = pose.v[2] - previous.v[2];
+    odom.UpdateAction(pf, (AMCLSensorData*)&odata);
+
+    pf_sensor_begin(pf);
+    for (auto& laser : lasers)
+    {
+        integrate_laser(pf, laser, pose);
+    }
+    pf_sensor_finish(pf);
+
+    pf_update_resample(pf);
+
+    pf_sample_set_t* set = pf->sets + pf->current_set;
+    hyps.resize(set->cluster_count);
+    for (int i = 0; i < set->cluster_count; i++)
+    {
+        pf_get_cluster_stats(pf, i, &hyps[i].weight, &hyps[i].pf_pose_mean, &hyps[i].pf_pose_cov);
+    }
+
+    //the compute governor alternates between the full and the half budget
+    double cpu_time = AMCLWorkerPool::ThreadCpuTime() - cpu_start + pool.TakeWorkerCpuTime();
+    double scale = (tick % 2 == 0) ? 1.0 : 0.5;
+    for (auto& laser : lasers)
+    {
+        laser.model->SetMaxBeams(std::max(2, (int)(laser_max_beams * scale + 0.5)));
+    }
+    pf_set_sample_limit(pf, (int)(max_particles * scale + 0.5));
+    return cpu_time;
+}
+
+//returns the number of allocations made by the updates after the warm-up, and their average CPU time
+static long run_scenario(laser_model_t model_type, int threads, int particles, int warmup_ticks, int measured_ticks, int seed, double& cpu_time)
+{
+    map_t* map = create_map();
+
+    pf_t* pf = pf_alloc(particles / 10, particles, 0.001, 0.1, uniform_pose, map);
+    pf_seed(pf, seed);
+    pf_vector_t mean = robot_pose(0);
+    pf_matrix_t cov = pf_matrix_zero();
+    cov.m[0][0] = 0.25;
+    cov.m[1][1] = 0.25;
+    cov.m[2][2] = 0.07;
+    pf_init(pf, mean, cov);
+
+    AMCLOdom odom;
+    odom.SetModel(ODOM_MODEL_DIFF, 0.2, 0.2, 0.2, 0.2);
+
+    std::shared_ptr<AMCLWorkerPool> pool = std::make_shared<AMCLWorkerPool>(threads);
+    vector<hyp_type> hyps;
+    hyps.reserve(pf->sets[0].cluster_max_count);
+    vector<laser_type> lasers(2);
+    lasers[0].mounting_pose = pf_vector_zero();
+    lasers[0].mounting_pose.v[0] = 0.3;
+    lasers[1].mounting_pose = pf_vector_zero();
+    lasers[1].mounting_pose.v[0] = -0.3;
+    lasers[1].mounting_pose.v[2] = M_PI;
+    for (auto& laser : lasers)
+    {
+        laser.measurement_data.resize(laser_readings);
+        laser.measurement_odom = pf_vector_zero();
+        laser.min_laser_angle = -180.0;
+        laser.horizontal_resolution = 360.0 / laser_readings;
+        laser.min_laser_distance = 0.0;
+        laser.max_laser_distance = laser_max_range;
+        laser.model = new AMCLLaser(laser_max_beams, map);
+        switch (model_type)
+        {
+        case LASER_MODEL_BEAM:
+            laser.model->SetModelBeam(0.95, 0.1, 0.05, 0.05, 0.2, 0.1, 0.0);
+            break;
+        case LASER_MODEL_LIKELIHOOD_FIELD:
+            laser.model->SetModelLikelihoodField(0.95, 0.05, 0.2, 2.0);
+            break;
+        case LASER_MODEL_LIKELIHOOD_FIELD_PROB:
+            laser.model->SetModelLikelihoodFieldProb(0.95, 0.05, 0.2, 2.0, true, 0.5, 0.3, 0.9);
+            break;
+        }
+        laser.model->SetWorkerPool(pool);
+    }
+
+    int tick = 1;
+    for (; tick <= warmup_ticks; tick++)
+    {
+        for (auto& laser : lasers)
+        {
+            simulate_scan(map, robot_pose(tick), laser);
+        }
+        update_filter(pf, odom, lasers, *pool, hyps, particles, tick);
+    }
+
+    allocation_count = 0;
+    cpu_time = 0;
+    for (; tick <= warmup_ticks + measured_ticks; tick++)
+    {
+        for (auto& laser : lasers)
+        {
+            simulate_scan(map, robot_pose(tick), laser);
+        }
+        counting_enabled = true;
+        cpu_time += update_filter(pf, odom, lasers, *pool, hyps, particles, tick);
+        counting_enabled = false;
+    }
+    long count = allocation_count;
+    cpu_time /= std::max(1, measured_ticks);
+
+    for (auto& laser : lasers)
+    {
+        delete laser.model;
+    }
+    pool.reset();
+    pf_free(pf);
+    map_free(map);
+    return count;
+}
+
+int main(int argc, char* argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+
+    if (rf.check("help"))
+    {
+        yCInfo(ALLOCATION_TEST) << "Options:";
+        yCInfo(ALLOCATION_TEST) << "--particles <n>      maximum number of particles (default 2000)";
+        yCInfo(ALLOCATION_TEST) << "--threads <n>        size of the worker pool of the multithreaded runs (default 4)";
+        yCInfo(ALLOCATION_TEST) << "--warmup_ticks <n>   filter updates before the measure (default 10)";
+        yCInfo(ALLOCATION_TEST) << "--measured_ticks <n> filter updates during which the allocations are counted (default 30)";
+        yCInfo(ALLOCATION_TEST) << "--seed <n>           random seed (default 0)";
+        return 0;
+    }
+
+    int particles = rf.check("particles", Value(2000)).asInt();
+    int threads = rf.check("threads", Value(4)).asInt();
+    int warmup_ticks = rf.check("warmup_ticks", Value(10)).asInt();
+    int measured_ticks = rf.check("measured_ticks", Value(30)).asInt();
+    int seed = rf.check("seed", Value(0)).asInt();
+
+    vector<pair<string, laser_model_t>> models = { { "beam", LASER_MODEL_BEAM },
+                                                   { "likelihood_field", LASER_MODEL_LIKELIHOOD_FIELD },
+                                                   { "likelihood_field_prob", LASER_MODEL_LIKELIHOOD_FIELD_PROB } };
+
+    bool failed = false;
+    yCInfo(ALLOCATION_TEST, "%22s %8s %12s %12s", "model", "threads", "allocations", "cpu [ms]");
+    for (auto& model : models)
+    {
+        for (int t : { 1, threads })
+        {
+            double cpu_time = 0;
+            long count = run_scenario(model.second, t, particles, warmup_ticks, measured_ticks, seed, cpu_time);
+            yCInfo(ALLOCATION_TEST, "%22s %8d %12ld %12.2f", model.first.c_str(), t, count, cpu_time * 1000.0);
+            if (count != 0)
+            {
+                failed = true;
+            }
+        }
+    }
+
+    if (failed)
+    {
+        yCError(ALLOCATION_TEST) << "The filter allocates memory after the warm-up";
+        return 1;
+    }
+    yCInfo(ALLOCATION_TEST) << "No allocations after the warm-up";
+    return 0;
+}
@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2006-2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+/**
+ * Checks the distance transform computed by map_update_cspace() of amcl (exact EDT of Meijster et al.).
+ * On a set of maps (random, empty, fully occupied, single obstacle, obstacles on the border, no cells) the distances
+ * are compared with a brute-force search of the nearest obstacle, which must match on every cell, and with
+ * the brushfire over a priority queue used by the previous implementation, copied below, which may only
+ * overestimate them. The time needed by the two implementations to build the distances of a large random
+ * map is then measured.
+ * The program returns a nonzero value if a check fails.
+ */
+
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Time.h>
+
+#include <queue>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "amcl/map/map.h"
+
+using namespace yarp::os;
+using namespace std;
+
+YARP_LOG_COMPONENT(CSPACE_TEST, "navigation.amclCspaceTest")
+
+// The previous implementation of map_update_cspace(): brushfire from the obstacles,
+// in order of distance, propagating the nearest obstacle to the 4-connected neighbours.
+namespace brushfire
+{
+
+class CellData
+{
+  public:
+    map_t* map_;
+    unsigned int i_, j_;
+    unsigned int src_i_, src_j_;
+    double dist_;
+};
+
+class CachedDistanceMap
+{
+  public:
+    CachedDistanceMap(double scale, double max_dist) :
+      distances_(NULL), scale_(scale), max_dist_(max_dist)
+    {
+      cell_radius_ = max_dist / scale;
+      distances_ = new double *[cell_radius_+2];
+      for(int i=0; i<=cell_radius_+1; i++)
+      {
+        distances_[i] = new double[cell_radius_+2];
+        for(int j=0; j<=cell_radius_+1; j++)
+        {
+          distances_[i][j] = sqrt(i*i + j*j);
+        }
+      }
+    }
+    ~CachedDistanceMap()
+    {
+      if(distances_)
+      {
+        for(int i=0; i<=cell_radius_+1; i++)
+          delete[] distances_[i];
+        delete[] distances_;
+      }
+    }
+    double** distances_;
+    double scale_;
+    double max_dist_;
+    int cell_radius_;
+};
+
+bool operator<(const CellData& a, const CellData& b)
+{
+  return a.dist_ > b.dist_;
+}
+
+CachedDistanceMap*
+get_distance_map(double scale, double max_dist)
+{
+  static CachedDistanceMap* cdm = NULL;
+
+  if(!cdm || (cdm->scale_ != scale) || (cdm->max_dist_ != max_dist))
+  {
+    if(cdm)
+      delete cdm;
+    cdm = new CachedDistanceMap(scale, max_dist);
+  }
+
+  return cdm;
+}
+
+inline uint16_t map_quantize_occ_dist(map_t* map, double distance)
+{
+  double q = floor(distance / map->max_occ_dist * MAP_OCC_DIST_LEVELS + 0.5);
+  return (uint16_t) (q < MAP_OCC_DIST_LEVELS ? q : MAP_OCC_DIST_LEVELS);
+}
+
+void enqueue(map_t* map, int i, int j,
+             int src_i, int src_j,
+             std::priority_queue<CellData>& Q,
+             CachedDistanceMap* cdm,
+             unsigned char* marked)
+{
+  if(marked[MAP_INDEX(map, i, j)])
+    return;
+
+  int di = abs(i - src_i);
+  int dj = abs(j - src_j);
+  double distance = cdm->distances_[di][dj];
+
+  if(distance > cdm->cell_radius_)
+    return;
+
+  map->occ_dist[MAP_INDEX(map, i, j)] = map_quantize_occ_dist(map, distance * map->scale);
+
+  CellData cell;
+  cell.map_ = map;
+  cell.i_ = i;
+  cell.j_ = j;
+  cell.src_i_ = src_i;
+  cell.src_j_ = src_j;
+  cell.dist_ = distance;
+
+  Q.push(cell);
+
+  marked[MAP_INDEX(map, i, j)] = 1;
+}
+
+void map_update_cspace(map_t *map, double max_occ_dist)
+{
+  unsigned char* marked;
+  std::priority_queue<CellData> Q;
+
+  marked = new unsigned char[map->size_x*map->size_y];
+  memset(marked, 0, sizeof(unsigned char) * map->size_x*map->size_y);
+
+  map->max_occ_dist = max_occ_dist;
+
+  // one more entry for the off-map positions
+  free(map->occ_dist);
+  map->occ_dist = (uint16_t*) malloc(sizeof(uint16_t) * (map->size_x * map->size_y + 1));
+  map->occ_dist[map->size_x * map->size_y] = MAP_OCC_DIST_LEVELS;
+
+  CachedDistanceMap* cdm = get_distance_map(map->scale, map->max_occ_dist);
+
+  // Enqueue all the obstacle cells
+  CellData cell;
+  cell.map_ = map;
+  cell.dist_ = 0.0;
+  for(int i=0; i<map->size_x; i++)
+  {
+    cell.src_i_ = cell.i_ = i;
+    for(int j=0; j<map->size_y; j++)
+    {
+      if(map->occ_state[MAP_INDEX(map, i, j)] == +1)
+      {
+        map->occ_dist[MAP_INDEX(map, i, j)] = 0;
+        cell.src_j_ = cell.j_ = j;
+        marked[MAP_INDEX(map, i, j)] = 1;
+        Q.push(cell);
+      }
+      else
+        map->occ_dist[MAP_INDEX(map, i, j)] = MAP_OCC_DIST_LEVELS;
+    }
+  }
+
+  while(!Q.empty())
+  {
+    CellData current_cell = Q.top();
+    if(current_cell.i_ > 0)
+      enqueue(map, current_cell.i_-1, current_cell.j_,
+              current_cell.src_i_, current_cell.src_j_,
+              Q, cdm, marked);
+    if(current_cell.j_ > 0)
+      enqueue(map, current_cell.i_, current_cell.j_-1,
+              current_cell.src_i_, current_cell.src_j_,
+              Q, cdm, marked);
+    if((int)current_cell.i_ < map->size_x - 1)
+      enqueue(map, current_cell.i_+1, current_cell.j_,
+              current_cell.src_i_, current_cell.src_j_,
+              Q, cdm, marked);
+    if((int)current_cell.j_ < map->size_y - 1)
+      enqueue(map, current_cell.i_, current_cell.j_+1,
+              current_cell.src_i_, current_cell.src_j_,
+              Q, cdm, marked);
+
+    Q.pop();
+  }
+
+  delete[] marked;
+}
+
+}
+
+// Distances of all the cells (and of the off-map entry) by checking every obstacle within max_occ_dist
+static vector<uint16_t> brute_force_cspace(map_t* map, double max_occ_dist)
+{
+    const int cell_radius = max_occ_dist / map->scale;
+    const long long radius_sq = (long long)cell_radius * cell_radius;
+    vector<uint16_t> dist(map->size_x * map->size_y + 1, MAP_OCC_DIST_LEVELS);
+    for (int y = 0; y < map->size_y; y++)
+    {
+        for (int x = 0; x < map->size_x; x++)
+        {
+            long long best = radius_sq + 1;
+            for (int j = max(0, y - cell_radius); j <= min(map->size_y - 1, y + cell_radius); j++)
+            {
+                for (int i = max(0, x - cell_radius); i <= min(map->size_x - 1, x + cell_radius); i++)
+                {
+                    if (map->occ_state[MAP_INDEX(map, i, j)] == +1)
+                    {
+                        long long d_sq = (long long)(i - x) * (i - x) + (long long)(j - y) * (j - y);
+                        best = min(best, d_sq);
+                    }
+                }
+            }
+            if (best <= radius_sq)
+            {
+                double q = floor(sqrt((double)best) * map->scale / max_occ_dist * MAP_OCC_DIST_LEVELS + 0.5);
+                dist[MAP_INDEX(map, x, y)] = (uint16_t)(q < MAP_OCC_DIST_LEVELS ? q : MAP_OCC_DIST_LEVELS);
+            }
+        }
+    }
+    return dist;
+}
+
+static map_t* create_map(int size_x, int size_y, double resolution)
+{
+    map_t* map = map_alloc();
+    map->size_x = size_x;
+    map->size_y = size_y;
+    map->scale = resolution;
+    map->occ_state = (int8_t*)malloc(sizeof(int8_t) * size_x * size_y);
+    memset(map->occ_state, -1, sizeof(int8_t) * size_x * size_y);
+    return map;
+}
+
+//each cell is occupied with the given probability, the others are free or unknown
+static void fill_random(map_t* map, double occupied, std::mt19937& gen)
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int i = 0; i < map->size_x * map->size_y; i++)
+    {
+        double r = uniform(gen);
+        map->occ_state[i] = r < occupied ? +1 : (r < occupied + 0.1 ? 0 : -1);
+    }
+}
+
+struct test_case_type
+{
+    string name;
+    map_t* map;
+};
+
+static vector<test_case_type> create_test_cases(int seed)
+{
+    std::mt19937 gen(seed);
+    const double resolution = 0.05;
+    vector<test_case_type> cases;
+
+    map_t* map = create_map(157, 121, resolution);
+    fill_random(map, 0.002, gen);
+    cases.push_back({ "random sparse", map });
+
+    map = create_map(157, 121, resolution);
+    fill_random(map, 0.05, gen);
+    cases.push_back({ "random dense", map });
+
+    cases.push_back({ "empty", create_map(157, 121, resolution) });
+
+    map = create_map(157, 121, resolution);
+    memset(map->occ_state, +1, sizeof(int8_t) * map->size_x * map->size_y);
+    cases.push_back({ "all occupied", map });
+
+    map = create_map(157, 121, resolution);
+    map->occ_state[MAP_INDEX(map, 80, 50)] = +1;
+    cases.push_back({ "single obstacle", map });
+
+    map = create_map(157, 121, resolution);
+    for (int x = 0; x < map->size_x; x += 7)
+    {
+        map->occ_state[MAP_INDEX(map, x, 0)] = +1;
+        map->occ_state[MAP_INDEX(map, x, map->size_y - 1)] = +1;
+    }
+    for (int y = 0; y < map->size_y; y += 5)
+    {
+        map->occ_state[MAP_INDEX(map, 0, y)] = +1;
+        map->occ_state[MAP_INDEX(map, map->size_x - 1, y)] = +1;
+    }
+    cases.push_back({ "border obstacles", map });
+
+    map = create_map(1, 97, resolution);
+    map->occ_state[MAP_INDEX(map, 0, 40)] = +1;
+    cases.push_back({ "single column", map });
+
+    map = create_map(97, 1, resolution);
+    map->occ_state[MAP_INDEX(map, 40, 0)] = +1;
+    cases.push_back({ "single row", map });
+
+    //only the off-map entry is written
+    cases.push_back({ "no cells", create_map(0, 0, resolution) });
+    cases.push_back({ "no columns", create_map(0, 97, resolution) });
+    cases.push_back({ "no rows", create_map(97, 0, resolution) });
+
+    return cases;
+}
+
+//compares the distances of map_update_cspace() with the brute force and with the brushfire.
+//Returns false if they differ from the brute force, or if they are larger than the brushfire ones.
+static bool check_map(const test_case_type& test, double max_occ_dist)
+{
+    map_t* map = test.map;
+    const int cells = map->size_x * map->size_y;
+
+    vector<uint16_t> expected = brute_force_cspace(map, max_occ_dist);
+    brushfire::map_update_cspace(map, max_occ_dist);
+    vector<uint16_t> old_dist(map->occ_dist, map->occ_dist + cells + 1);
+    map_update_cspace(map, max_occ_dist);
+
+    int wrong = 0;
+    int above_old = 0;
+    int below_old = 0;
+    double max_improvement = 0;
+    for (int i = 0; i <= cells; i++)
+    {
+        if (map->occ_dist[i] != expected[i])
+        {
+            wrong++;
+        }
+        if (map->occ_dist[i] > old_dist[i])
+        {
+            above_old++;
+        }
+        else if (map->occ_dist[i] < old_dist[i])
+        {
+            below_old++;
+            max_improvement = max(max_improvement, MAP_OCC_DIST(map, old_dist[i] - map->occ_dist[i]) / map->scale);
+        }
+    }
+    bool ok = wrong == 0 && above_old == 0;
+    yCInfo(CSPACE_TEST, "%18s %5dx%-5d %10d %10d %10d %12.2f %6s", test.name.c_str(), map->size_x, map->size_y,
+           wrong, above_old, below_old, max_improvement, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+
+    if (rf.check("help"))
+    {
+        yCInfo(CSPACE_TEST) << "Options:";
+        yCInfo(CSPACE_TEST) << "--max_occ_dist <d>   maximum obstacle distance [m] (default 2.0)";
+        yCInfo(CSPACE_TEST) << "--size <n>           side of the map used to measure the build time [cells] (default 2000)";
+        yCInfo(CSPACE_TEST) << "--density <p>        fraction of occupied cells of that map (default 0.01)";
+        yCInfo(CSPACE_TEST) << "--repetitions <n>    number of builds for each measure (default 3)";
+        yCInfo(CSPACE_TEST) << "--seed <n>           random seed (default 0)";
+        return 0;
+    }
+
+    double max_occ_dist = rf.check("max_occ_dist", Value(2.0)).asDouble();
+    int size = rf.check("size", Value(2000)).asInt();
+    double density = rf.check("density", Value(0.01)).asDouble();
+    int repetitions = rf.check("repetitions", Value(3)).asInt();
+    int seed = rf.check("seed", Value(0)).asInt();
+
+    bool failed = false;
+    yCInfo(CSPACE_TEST, "%18s %11s %10s %10s %10s %12s %6s", "map", "size", "wrong", "above old", "below old", "max gain [c]", "");
+    vector<test_case_type> cases = create_test_cases(seed);
+    for (auto& test : cases)
+    {
+        if (!check_map(test, max_occ_dist))
+        {
+            failed = true;
+        }
+        map_free(test.map);
+    }
+
+    std::mt19937 gen(seed);
+    map_t* map = create_map(size, size, 0.05);
+    fill_random(map, density, gen);
+    double old_time = 0;
+    double new_time = 0;
+    for (int r = 0; r < repetitions; r++)
+    {
+        double t0 = yarp::os::Time::now();
+        brushfire::map_update_cspace(map, max_occ_dist);
+        double t1 = yarp::os::Time::now();
+        map_update_cspace(map, max_occ_dist);
+        double t2 = yarp::os::Time::now();
+        old_time += t1 - t0;
+        new_time += t2 - t1;
+    }
+    old_time /= repetitions;
+    new_time /= repetitions;
+    yCInfo(CSPACE_TEST, "Build time of a %dx%d map: brushfire %.3f s, exact EDT %.3f s, ratio %.1f",
+           size, size, old_time, new_time, new_time > 0 ? old_time / new_time : 0.0);
+    map_free(map);
+
+    if (failed)
+    {
+        yCError(CSPACE_TEST) << "The distances computed by map_update_cspace() are wrong";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2006-2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+/**
+ * Measures the time spent by pf_update_resample() of the amcl particle filter with each resampling algorithm
+ * (multinomial, alias, systematic) for an increasing number of particles.
+ * Two scenarios are simulated: a converged filter, whose particles are concentrated around a few hypotheses
+ * (KLD sampling shrinks the new set), and a kidnapped robot, whose particles are spread over the whole map
+ * (KLD sampling asks for the maximum number of particles).
+ */
+
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Time.h>
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "amcl/pf/pf.h"
+
+using namespace yarp::os;
+using namespace std;
+
+YARP_LOG_COMPONENT(RESAMPLE_BENCHMARK, "navigation.amclResampleBenchmark")
+
+struct scenario_type
+{
+    string name;
+    double spread;   //standard deviation of the particles around the hypotheses [m]
+};
+
+static pf_vector_t uniform_pose(void* arg, pf_rng_t* rng)
+{
+    double size = *(double*)arg;
+    pf_vector_t p;
+    p.v[0] = pf_rng_uniform(rng) * size;
+    p.v[1] = pf_rng_uniform(rng) * size;
+    p.v[2] = pf_rng_uniform(rng) * 2 * M_PI - M_PI;
+    return p;
+}
+
+//places the particles around three hypotheses and weights them with their distance from the first one
+static void fill_set(pf_t* pf, double spread, double map_size)
+{
+    pf_sample_set_t* set = pf->sets + pf->current_set;
+    pf_rng_t* rng = &pf->rng;
+    set->sample_count = pf->max_samples;
+    double total = 0;
+    for (int i = 0; i < set->sample_count; i++)
+    {
+        pf_sample_t* sample = set->samples + i;
+        if (spread > 0)
+        {
+            double cx = map_size * (1 + i % 3) / 4;
+            sample->pose.v[0] = cx + spread * (pf_rng_uniform(rng) - 0.5);
+            sample->pose.v[1] = map_size / 2 + spread * (pf_rng_uniform(rng) - 0.5);
+        }
+        else
+        {
+            sample->pose.v[0] = pf_rng_uniform(rng) * map_size;
+            sample->pose.v[1] = pf_rng_uniform(rng) * map_size;
+        }
+        sample->pose.v[2] = pf_rng_uniform(rng) * 2 * M_PI - M_PI;
+        double dx = sample->pose.v[0] - map_size / 4;
+        double dy = sample->pose.v[1] - map_size / 2;
+        sample->weight = exp(-(dx * dx + dy * dy) / 2.0) + 1e-3;
+        total += sample->weight;
+    }
+    for (int i = 0; i < set->sample_count; i++)
+    {
+        set->samples[i].weight /= total;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+
+    if (rf.check("help"))
+    {
+        yCInfo(RESAMPLE_BENCHMARK) << "Options:";
+        yCInfo(RESAMPLE_BENCHMARK) << "--min_particles <n>  smallest filter size (default 1000)";
+        yCInfo(RESAMPLE_BENCHMARK) << "--max_particles <n>  largest filter size (default 50000)";
+        yCInfo(RESAMPLE_BENCHMARK) << "--repetitions <n>    number of resamplings for each measure (default 20)";
+        yCInfo(RESAMPLE_BENCHMARK) << "--seed <n>           random seed (default 0)";
+        return 0;
+    }
+
+    int min_particles = rf.check("min_particles", Value(1000)).asInt();
+    int max_particles = rf.check("max_particles", Value(50000)).asInt();
+    int repetitions = rf.check("repetitions", Value(20)).asInt();
+    int seed = rf.check("seed", Value(0)).asInt();
+    double map_size = 50.0;
+
+    vector<scenario_type> scenarios = { { "converged", 2.0 }, { "kidnapped", 0.0 } };
+    vector<pair<string, pf_resample_model_t>> models = { { "multinomial", PF_RESAMPLE_MULTINOMIAL },
+                                                         { "alias", PF_RESAMPLE_ALIAS },
+                                                         { "systematic", PF_RESAMPLE_SYSTEMATIC } };
+
+    for (auto& scenario : scenarios)
+    {
+        yCInfo(RESAMPLE_BENCHMARK, "scenario: %s", scenario.name.c_str());
+        yCInfo(RESAMPLE_BENCHMARK, "%10s %12s %12s %12s", "particles", "model", "time [ms]", "new size");
+        for (int n = min_particles; n <= max_particles; n *= 2)
+        {
+            for (auto& model : models)
+            {
+                pf_t* pf = pf_alloc(100, n, 0.001, 0.1, uniform_pose, &map_size);
+                pf->resample_model = model.second;
+                pf_seed(pf, seed);
+                double elapsed = 0;
+                double new_size = 0;
+                for (int r = 0; r < repetitions; r++)
+                {
+                    fill_set(pf, scenario.spread, map_size);
+                    double t0 = yarp::os::Time::now();
+                    pf_update_resample(pf);
+                    elapsed += yarp::os::Time::now() - t0;
+                    new_size += pf->sets[pf->current_set].sample_count;
+                }
+                yCInfo(RESAMPLE_BENCHMARK, "%10d %12s %12.3f %12.0f", n, model.first.c_str(),
+                       elapsed / repetitions * 1000.0, new_size / repetitions);
+                pf_free(pf);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2006-2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+/**
+ * Checks obstacles_class::in_detection_area() of robotGotoDevice against the point-in-polygon test (pnpoly) used
+ * before, copied below, on the detection area rotated by beta.
+ * - Random points and areas: the two checks must agree, except for the points so close to an edge that
+ *   the float rounding of the new check may put them on the other side.
+ * - Vertices and points on the edges of an area which is not rotated (beta=0): the rotation is exact, so the two
+ *   checks must agree on the edges too.
+ * - Vertices and points on the edges of rotated areas, moved slightly inwards or outwards: both checks must
+ *   classify them as inside or outside respectively.
+ * The program returns a nonzero value if a check fails.
+ */
+
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "obstacles.h"
+
+using namespace yarp::os;
+using namespace std;
+
+YARP_LOG_COMPONENT(DETECTION_AREA_TEST, "navigation.obstaclesDetectionAreaTest")
+
+//the previous implementation: checks if a point is inside a n-sided polygon
+static int pnpoly(int nvert, double *vertx, double *verty, double testx, double testy)
+{
+  int i, j, c = 0;
+  for (i = 0, j = nvert-1; i < nvert; j = i++)
+  {
+    if (( (verty[i]>testy) != (verty[j]>testy) ) &&
+          (testx < (vertx[j]-vertx[i]) * (testy-verty[i]) / (verty[j]-verty[i]) + vertx[i]) )
+    {
+       c = !c;
+    }
+  }
+  return c;
+}
+
+struct area_type
+{
+    double beta;                //deg
+    double detection_distance;  //m
+    double radius;              //m
+    double cbeta;
+    double sbeta;
+};
+
+static area_type make_area(double beta, float detection_distance, float radius)
+{
+    area_type area;
+    area.beta = beta;
+    area.detection_distance = detection_distance;
+    area.radius = radius;
+    area.cbeta = cos(beta * M_PI / 180.0);
+    area.sbeta = sin(beta * M_PI / 180.0);
+    return area;
+}
+
+//the polygon built by the previous implementation of obstacles_class::check_obstacles_in_path()
+static int old_check(const area_type& area, float x, float y)
+{
+    double vx[4];
+    double vy[4];
+    double vertx[4];
+    double verty[4];
+    vx[0] = 0; vy[0] = +area.radius;
+    vx[1] = 0; vy[1] = -area.radius;
+    vx[2] = area.detection_distance; vy[2] = -area.radius;
+    vx[3] = area.detection_distance; vy[3] = +area.radius;
+    for (int k = 0; k < 4; k++)
+    {
+        vertx[k] = vx[k] * area.cbeta + vy[k] * (-area.sbeta);
+        verty[k] = vx[k] * area.sbeta + vy[k] * area.cbeta;
+    }
+    return pnpoly(4, vertx, verty, x, y);
+}
+
+static int new_check(const area_type& area, float x, float y)
+{
+    return obstacles_class::in_detection_area(x, y, float(area.cbeta), float(area.sbeta), float(area.detection_distance), float(area.radius));
+}
+
+//point of the area frame (u along the direction of motion, v on its left) in the robot reference frame
+static void area_to_robot(const area_type& area, double u, double v, float& x, float& y)
+{
+    x = float(u * area.cbeta - v * area.sbeta);
+    y = float(u * area.sbeta + v * area.cbeta);
+}
+
+//distance of a point from the border of the area
+static double distance_from_border(const area_type& area, float x, float y)
+{
+    double u = x * area.cbeta + y * area.sbeta;
+    double v = y * area.cbeta - x * area.sbeta;
+    double du = min(fabs(u), fabs(u - area.detection_distance));
+    double dv = min(fabs(v + area.radius), fabs(v - area.radius));
+    bool inside_u = u >= 0 && u <= area.detection_distance;
+    bool inside_v = v >= -area.radius && v <= area.radius;
+    if (inside_u && inside_v) { return min(du, dv); }
+    if (inside_u) { return dv; }
+    if (inside_v) { return du; }
+    return sqrt(du * du + dv * dv);
+}
+
+int main(int argc, char* argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+
+    if (rf.check("help"))
+    {
+        yCInfo(DETECTION_AREA_TEST) << "Options:";
+        yCInfo(DETECTION_AREA_TEST) << "--areas <n>       number of random detection areas (default 1000)";
+        yCInfo(DETECTION_AREA_TEST) << "--points <n>      number of random points per area (default 1000)";
+        yCInfo(DETECTION_AREA_TEST) << "--seed <n>        random seed (default 0)";
+        return 0;
+    }
+
+    int areas = rf.check("areas", Value(1000)).asInt();
+    int points = rf.check("points", Value(1000)).asInt();
+    int seed = rf.check("seed", Value(0)).asInt();
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> beta_dist(-180.0, 180.0);
+    std::uniform_real_distribution<float> detection_dist(0.4f, 1.5f);
+    std::uniform_real_distribution<float> radius_dist(0.2f, 0.6f);
+    std::uniform_real_distribution<float> point_dist(-2.0f, 2.0f);
+    std::uniform_real_distribution<double> unit_dist(0.0, 1.0);
+
+    //the float rounding of the new check may move a point by a few ulps
+    const double border_tolerance = 1e-5;
+    //the offset of the points moved from the edges of the rotated areas
+    const double border_offset = 1e-3;
+
+    long mismatches = 0;
+    long border_mismatches = 0;
+    long near_border = 0;
+    long compared = 0;
+
+    //random points on random areas
+    for (int a = 0; a < areas; a++)
+    {
+        area_type area = make_area(beta_dist(gen), detection_dist(gen), radius_dist(gen));
+        for (int p = 0; p < points; p++)
+        {
+            float x = point_dist(gen);
+            float y = point_dist(gen);
+            compared++;
+            if (old_check(area, x, y) == new_check(area, x, y)) { continue; }
+            if (distance_from_border(area, x, y) < border_tolerance) { near_border++; continue; }
+            mismatches++;
+            if (mismatches <= 10)
+            {
+                yCError(DETECTION_AREA_TEST, "Mismatch: beta %f detection_distance %f radius %f point (%f %f) pnpoly %d new %d", area.beta, area.detection_distance, area.radius, x, y, old_check(area, x, y), new_check(area, x, y));
+            }
+        }
+    }
+
+    //vertices and points on the edges of areas which are not rotated
+    for (int a = 0; a < areas; a++)
+    {
+        area_type area = make_area(0.0, detection_dist(gen), radius_dist(gen));
+        float d = float(area.detection_distance);
+        float r = float(area.radius);
+        float u = float(unit_dist(gen) * area.detection_distance);
+        float v = float((unit_dist(gen) * 2 - 1) * area.radius);
+        const float border_points[][2] = { { 0, r }, { 0, -r }, { d, -r }, { d, r },  //vertices
+                                           { 0, v }, { d, v }, { u, -r }, { u, r },   //edges
+                                           { 0, 0 } };                                //the center of the robot
+        for (auto& pt : border_points)
+        {
+            compared++;
+            if (old_check(area, pt[0], pt[1]) != new_check(area, pt[0], pt[1]))
+            {
+                border_mismatches++;
+                yCError(DETECTION_AREA_TEST, "Mismatch on the border: detection_distance %f radius %f point (%f %f) pnpoly %d new %d", d, r, pt[0], pt[1], old_check(area, pt[0], pt[1]), new_check(area, pt[0], pt[1]));
+            }
+        }
+    }
+
+    //vertices and points on the edges of rotated areas, moved inwards and outwards
+    for (int a = 0; a < areas; a++)
+    {
+        area_type area = make_area(beta_dist(gen), detection_dist(gen), radius_dist(gen));
+        double d = area.detection_distance;
+        double r = area.radius;
+        double u = border_offset + unit_dist(gen) * (d - 2 * border_offset);
+        double v = (unit_dist(gen) * 2 - 1) * (r - border_offset);
+        const double border_points[][2] = { { 0, r }, { 0, -r }, { d, -r }, { d, r },
+                                            { 0, v }, { d, v }, { u, -r }, { u, r } };
+        for (auto& pt : border_points)
+        {
+            //the direction towards the inside of the area
+            double du = (pt[0] < d / 2) ? +1 : -1;
+            double dv = (pt[1] <= -r) ? +1 : (pt[1] >= r) ? -1 : 0;
+            if (pt[0] > 0 && pt[0] < d) { du = 0; }
+            for (int inwards = 0; inwards < 2; inwards++)
+            {
+                double s = inwards ? border_offset : -border_offset;
+                float x, y;
+                area_to_robot(area, pt[0] + du * s, pt[1] + dv * s, x, y);
+                int old_result = old_check(area, x, y);
+                int new_result = new_check(area, x, y);
+                compared++;
+                if (old_result != inwards || new_result != inwards)
+                {
+                    border_mismatches++;
+                    yCError(DETECTION_AREA_TEST, "Wrong classification near the border: beta %f detection_distance %f radius %f point (%f %f) expected %d pnpoly %d new %d", area.beta, d, r, x, y, inwards, old_result, new_result);
+                }
+            }
+        }
+    }
+
+    yCInfo(DETECTION_AREA_TEST, "%ld points compared, %ld random points within %g m of the border classified differently", compared, near_border, border_tolerance);
+
+    if (mismatches != 0 || border_mismatches != 0)
+    {
+        yCError(DETECTION_AREA_TEST, "%ld mismatches on random points, %ld on the border", mismatches, border_mismatches);
+        return 1;
+    }
+    yCInfo(DETECTION_AREA_TEST) << "The detection area matches pnpoly";
+    return 0;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2006-2020 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+/**
+ * Measures the planning latency of the robotPathPlanner search algorithms (astar, jps, theta_star, dstar_lite, hpa_star).
+ * The map can be loaded from file (--map_file, e.g. app/mapsExample/map_isaac.map) or generated synthetically (--width, --height),
+ * then the same set of random start/goal pairs is planned with each algorithm and the timing statistics are printed.
+ * Finally, the recovery scenario is simulated: an obstacle is dropped on each path and the replanning time of a full A*
+ * search is compared with the incremental D* Lite repair.
+ */
+
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Time.h>
+#include <yarp/dev/MapGrid2D.h>
+#include <yarp/dev/Map2DPath.h>
+
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "aStar.h"
+#include "dStarLite.h"
+#include "hpaStar.h"
+#include "map.h"
+
+using namespace yarp::os;
+using namespace yarp::dev;
+using namespace yarp::dev::Nav2D;
+using namespace std;
+
+YARP_LOG_COMPONENT(PATHPLAN_BENCHMARK, "navigation.pathPlannerBenchmark")
+
+bool build_synthetic_map(MapGrid2D& map, size_t w, size_t h, std::mt19937& rng)
+{
+    //an empty floor surrounded by walls and cluttered with random rectangular obstacles (shelves)
+    map.setMapName("synthetic");
+    map.setResolution(0.05);
+    map.setOrigin(0, 0, 0);
+    if (map.setSize_in_cells(w, h) == false) return false;
+    for (size_t y = 0; y < h; y++)
+        for (size_t x = 0; x < w; x++)
+        {
+            bool border = (x == 0 || y == 0 || x == w - 1 || y == h - 1);
+            map.setMapFlag(XYCell(x, y), border ? MapGrid2D::MAP_CELL_WALL : MapGrid2D::MAP_CELL_FREE);
+        }
+    size_t shelves = (w * h) / 4000;
+    for (size_t i = 0; i < shelves; i++)
+    {
+        size_t sx = rng() % w;
+        size_t sy = rng() % h;
+        size_t sw = 2 + rng() % 40;
+        size_t sh = 2 + rng() % 6;
+        if (rng() % 2) std::swap(sw, sh);
+        for (size_t y = sy; y < std::min(h, sy + sh); y++)
+            for (size_t x = sx; x < std::min(w, sx + sw); x++)
+                map.setMapFlag(XYCell(x, y), MapGrid2D::MAP_CELL_WALL);
+    }
+    return true;
+}
+
+XYCell random_free_cell(const MapGrid2D& map, std::mt19937& rng)
+{
+    while (true)
+    {
+        XYCell c(rng() % map.width(), rng() % map.height());
+        if (map.isFree(c)) return c;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    ResourceFinder rf;
+    rf.configure(argc, argv);
+
+    if (rf.check("help"))
+    {
+        yCInfo(PATHPLAN_BENCHMARK) << "Options:";
+        yCInfo(PATHPLAN_BENCHMARK) << "--map_file <file>     the map to be loaded (if omitted, a synthetic map is generated)";
+        yCInfo(PATHPLAN_BENCHMARK) << "--width <cells>       width of the synthetic map (default 1000)";
+        yCInfo(PATHPLAN_BENCHMARK) << "--height <cells>      height of the synthetic map (default 1000)";
+        yCInfo(PATHPLAN_BENCHMARK) << "--robot_radius <m>    obstacles enlargement (default 0.3)";
+        yCInfo(PATHPLAN_BENCHMARK) << "--iterations <n>      number of random start/goal pairs (default 20)";
+        yCInfo(PATHPLAN_BENCHMARK) << "--seed <n>            seed of the random generator (default 0)";
+        yCInfo(PATHPLAN_BENCHMARK) << "--algorithm <name>    astar, jps, theta_star, dstar_lite or hpa_star (default: all of them are compared)";
+        return 0;
+    }
+
+    size_t width = rf.check("width") ? rf.find("width").asInt32() : 1000;
+    size_t height = rf.check("height") ? rf.find("height").asInt32() : 1000;
+    double robot_radius = rf.check("robot_radius") ? rf.find("robot_radius").asFloat64() : 0.3;
+    int iterations = rf.check("iterations") ? rf.find("iterations").asInt32() : 20;
+    if (iterations <= 0) iterations = 1;
+    unsigned int seed = rf.check("seed") ? rf.find("seed").asInt32() : 0;
+    std::mt19937 rng(seed);
+
+    MapGrid2D map;
+    if (rf.check("map_file"))
+    {
+        std::string map_file = rf.find("map_file").asString();
+        if (map.loadFromFile(map_file) == false)
+        {
+            yCError(PATHPLAN_BENCHMARK) << "Unable to load map" << map_file;
+            return -1;
+        }
+    }
+    else if (build_synthetic_map(map, width, height, rng) == false)
+    {
+        yCError(PATHPLAN_BENCHMARK) << "Unable to build the synthetic map";
+        return -1;
+    }
+    map.enlargeObstacles(robot_radius);
+    yCInfo(PATHPLAN_BENCHMARK) << "Map" << map.getMapName() << "size:" << map.width() << "x" << map.height();
+
+    aStar_algorithm::planner_workspace workspace;
+    double tb1 = yarp::os::Time::now();
+    workspace.build(map);
+    double tb2 = yarp::os::Time::now();
+    yCInfo(PATHPLAN_BENCHMARK, "workspace built in %.3fms", (tb2 - tb1) * 1000.0);
+
+    std::vector<std::pair<XYCell, XYCell>> queries;
+    for (int i = 0; i < iterations; i++)
+    {
+        XYCell start = random_free_cell(map, rng);
+        XYCell goal = random_free_cell(map, rng);
+        queries.push_back(std::make_pair(start, goal));
+    }
+
+    //all the algorithms are run on the same set of queries
+    std::vector<aStar_algorithm::search_algorithm_type> algorithms;
+    if (rf.check("algorithm"))
+    {
+        aStar_algorithm::search_algorithm_type algorithm;
+        if (aStar_algorithm::string_to_algorithm(rf.find("algorithm").asString(), algorithm) == false)
+        {
+            yCError(PATHPLAN_BENCHMARK) << "Invalid algorithm" << rf.find("algorithm").asString();
+            return -1;
+        }
+        algorithms.push_back(algorithm);
+    }
+    else
+    {
+        algorithms.push_back(aStar_algorithm::search_algorithm_type::astar);
+        algorithms.push_back(aStar_algorithm::search_algorithm_type::jps);
+        algorithms.push_back(aStar_algorithm::search_algorithm_type::theta_star);
+        algorithms.push_back(aStar_algorithm::search_algorithm_type::dstar_lite);
+        algorithms.push_back(aStar_algorithm::search_algorithm_type::hpa_star);
+    }
+
+    //the HPA* abstract graph is built once per map by the planner, so its cost is measured separately from the searches
+    hpaStar_algorithm::hpa_graph hpa_graph;
+    if (std::find(algorithms.begin(), algorithms.end(), aStar_algorithm::search_algorithm_type::hpa_star) != algorithms.end())
+    {
+        double t1 = yarp::os::Time::now();
+        hpa_graph.build(workspace, hpaStar_algorithm::default_cluster_size);
+        double t2 = yarp::os::Time::now();
+        yCInfo(PATHPLAN_BENCHMARK, "hpa_star: graph built in %.3fms (%d clusters, %d portals)",
+                                   (t2 - t1) * 1000.0, (int)hpa_graph.get_number_of_clusters(), (int)hpa_graph.get_number_of_portals());
+    }
+
+    for (auto algorithm : algorithms)
+    {
+        std::string name = aStar_algorithm::algorithm_to_string(algorithm);
+        std::vector<double> timings;
+        double total_search = 0;
+        double total_simplify = 0;
+        size_t failures = 0;
+        size_t waypoints = 0;
+        for (auto q = queries.begin(); q != queries.end(); q++)
+        {
+            Map2DPath path;
+            Map2DPath simplified_path;
+            double t1 = yarp::os::Time::now();
+            bool b = false;
+            if (algorithm == aStar_algorithm::search_algorithm_type::hpa_star)
+            {
+                b = map_utilites::findPath(hpa_graph, workspace, map, q->first, q->second, path);
+            }
+            else
+            {
+                b = map_utilites::findPath(workspace, map, q->first, q->second, path, algorithm);
+            }
+            double t2 = yarp::os::Time::now();
+            if (b && algorithm != aStar_algorithm::search_algorithm_type::theta_star)
+            {
+                map_utilites::simplifyPath(map, path, simplified_path);
+            }
+            else
+            {
+                simplified_path = path;
+            }
+            double t3 = yarp::os::Time::now();
+            timings.push_back(t3 - t1);
+            total_search += t2 - t1;
+            total_simplify += t3 - t2;
+            if (b) waypoints += simplified_path.size();
+            else failures++;
+        }
+
+        std::sort(timings.begin(), timings.end());
+        size_t n = timings.size();
+        yCInfo(PATHPLAN_BENCHMARK, "%s: %d plans, %d not found, avg %.1f waypoints",
+                                   name.c_str(), (int)n, (int)failures, double(waypoints) / std::max<size_t>(1, n - failures));
+        yCInfo(PATHPLAN_BENCHMARK, "%s: search mean %.3fms, simplification mean %.3fms, total median %.3fms max %.3fms",
+                                   name.c_str(), total_search / n * 1000.0, total_simplify / n * 1000.0, timings[n / 2] * 1000.0, timings.back() * 1000.0);
+    }
+
+    //recovery scenario: the robot is halfway along its path when a new obstacle is found in front of it
+    dStarLite_algorithm::dstar_lite_planner dstar_planner;
+    double total_astar_replan = 0;
+    double total_dstar_replan = 0;
+    size_t replans = 0;
+    for (auto q = queries.begin(); q != queries.end(); q++)
+    {
+        MapGrid2D recovery_map = map;
+        workspace.build(recovery_map);
+        Map2DPath path;
+        if (map_utilites::findPath(dstar_planner, workspace, recovery_map, q->first, q->second, path) == false || path.size() < 20) continue;
+
+        XYCell robot = recovery_map.toXYCell(path[path.size() / 2 - 5]);
+        XYCell blocked = recovery_map.toXYCell(path[path.size() / 2]);
+        std::vector<XYCell> new_obstacles;
+        for (int dy = -3; dy <= 3; dy++)
+            for (int dx = -3; dx <= 3; dx++)
+            {
+                XYCell c(blocked.x + dx, blocked.y + dy);
+                if (c.x >= recovery_map.width() || c.y >= recovery_map.height() || c == q->second) continue;
+                if (recovery_map.isFree(c) == false) continue;
+                recovery_map.setMapFlag(c, MapGrid2D::MAP_CELL_KEEP_OUT);
+                workspace.set_occupied(c);
+                new_obstacles.push_back(c);
+            }
+
+        Map2DPath astar_path;
+        Map2DPath dstar_path;
+        double t1 = yarp::os::Time::now();
+        map_utilites::findPath(workspace, recovery_map, robot, q->second, astar_path, aStar_algorithm::search_algorithm_type::astar);
+        double t2 = yarp::os::Time::now();
+        dstar_planner.update_cells(new_obstacles);
+        map_utilites::findPath(dstar_planner, workspace, recovery_map, robot, q->second, dstar_path);
+        double t3 = yarp::os::Time::now();
+        total_astar_replan += t2 - t1;
+        total_dstar_replan += t3 - t2;
+        if (astar_path.size() != dstar_path.size())
+        {
+            yCWarning(PATHPLAN_BENCHMARK) << "replanning: astar and dstar_lite paths have different length" << astar_path.size() << dstar_path.size();
+        }
+        replans++;
+    }
+    if (replans > 0)
+    {
+        yCInfo(PATHPLAN_BENCHMARK, "replanning after new obstacles (%d plans): astar mean %.3fms, dstar_lite mean %.3fms",
+                                   (int)replans, total_astar_replan / replans * 1000.0, total_dstar_replan / replans * 1000.0);
+    }
+    return 0;
+}